@@ -7,21 +7,73 @@
 #include <stdint.h>
 #include <stddef.h>
 
+// CPU features relevant for AES kernels
+#define AES_FEATURE_AES     (1u << 0)   // AES-NI with SSSE3 or Armv8 AES
+#define AES_FEATURE_PMULL   (1u << 1)   // Armv8 polynomial multiply
+#define AES_FEATURE_SVEAES  (1u << 2)   // SVE2 AES
+#define AES_FEATURE_AVX2    (1u << 3)
+#define AES_FEATURE_VAES    (1u << 4)
+#define AES_FEATURE_AVX512  (1u << 5)   // AVX-512 Foundation and Byte/Word
+#define AES_FEATURE_VPCLMUL (1u << 6)   // Wide carry-less multiply
+
+// Kernels of a pinned backend are inlined into the generate path
+//  once the library is linked with LTO into a caller built for the
+//  same instruction set, see SECURE_RNG_BACKEND
+#ifdef STATIC_BACKEND
+#define AES_KERNEL inline __attribute__ ((always_inline))
+#else
+#define AES_KERNEL
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// CTR mode kernels encrypt consecutive big-endian counter blocks starting with
+//  the provided one. Counter carries are only propagated within its lowest 32 bits,
+//  so callers must split requests where these bits wrap around. XOR variants
+//  combine the keystream with the output buffer contents instead of storing it.
+typedef void (*aesctr256_fn)(uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+
 #ifdef SOFTWARE_FALLBACK
 void aesctr256_software (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+void aesctr256_xor_software (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
 void aesctr256_zeroiv_software (uint8_t *out, const uint8_t *sk, int bytes);
 #endif
 
 #ifdef HARDWARE_SUPPORT
 void aesctr256_hardware (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+void aesctr256_xor_hardware (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
 void aesctr256_zeroiv_hardware (uint8_t *out, const uint8_t *sk, int bytes);
+unsigned aes_cpu_features();
 int aes_hardware_supported();
 #endif
 
+#ifdef HARDWARE_VAES
+void aes256_expand_hardware (void *rkeys, const uint8_t *sk);
+void aesctr256_vaes256 (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+void aesctr256_vaes512 (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+void aesctr256_xor_vaes256 (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+void aesctr256_xor_vaes512 (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+#endif
+
+#ifndef STATIC_BACKEND
+// Follows the autotuner's plan, dispatching by request size
+void aesctr256_tuned (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+void aesctr256_xor_tuned (uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+
+// Kernel which follows the plan or NULL if the autotuner didn't run yet
+aesctr256_fn aes_tuned_function(void);
+#endif
+
+// Returns kernel of the backend or NULL if it isn't supported,
+//  the best supported kernel is only chosen once per process
+aesctr256_fn aes_backend_function(int backend);
+int aes_backend_id(aesctr256_fn function);
+
+// Returns XOR variant of the kernel
+aesctr256_fn aes_backend_xor_function(aesctr256_fn function);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,18 @@
+#ifndef BITS_H
+#define BITS_H
+
+#include "secure-rng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Wipe reservoir bits, keystream of the previous
+//  state must not be served after a reseed
+void rng_bits_discard(struct secure_rng_ctx *ctx);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef FORK_H
+#define FORK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Process generation marker, it is reset to zero in
+//  child processes and is only valid after the first
+//  rng_fork_generation() invocation
+extern uint64_t *rng_fork_marker;
+
+// Returns non-zero generation of the current process
+uint64_t rng_fork_generation(void);
+
+// Check whether a context with the given generation has been
+//  inherited through fork, zero means fork detection is off
+inline static int rng_forked(uint64_t generation) {
+    return generation != 0 && generation != *rng_fork_marker;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
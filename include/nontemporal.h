@@ -0,0 +1,19 @@
+#ifndef NONTEMPORAL_H
+#define NONTEMPORAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Copy bypassing the cache where the target supports streaming stores,
+//  unaligned head and tail of the destination are copied regularly
+void rng_copy_nontemporal(uint8_t *out, const uint8_t *in, size_t bytes);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+// Shared memory ring between the daemon and one client: the daemon is the
+//  only producer, the client is the only consumer. Both positions count
+//  bytes since the ring creation and only grow, data size is a power of two.
+
+#define RING_MAGIC    0x52524e47u   // "RRNG"
+#define RING_VERSION  1
+
+// Control bytes sent by clients over the socket
+#define RING_REFILL   'R'    // top the ring up, no reply
+#define RING_WAIT     'W'    // top the ring up and reply with RING_READY
+#define RING_READY    'K'
+
+// Clients ask for a refill once fewer bytes are left
+#define RING_LOW_WATER(size) ((size) / 2)
+
+struct rng_ring {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t head __attribute__ ((aligned (64)));    // produced, written by the daemon
+    uint64_t tail __attribute__ ((aligned (64)));    // consumed, written by the client
+    uint32_t refill_pending;                         // set by the client, cleared by the daemon
+    uint8_t data[] __attribute__ ((aligned (64)));
+};
+
+#endif
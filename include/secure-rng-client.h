@@ -0,0 +1,25 @@
+#ifndef SECURERNG_CLIENT_H
+#define SECURERNG_CLIENT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Socket of secure-rng-daemon, may be overridden
+//  with the SECURE_RNG_SOCKET environment variable
+#define SECURE_RNG_DEFAULT_SOCKET "/tmp/secure-rng.sock"
+
+struct secure_rng_client;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct secure_rng_client *secure_rng_client_open(const char *socket_path);
+int secure_rng_client_bytes(struct secure_rng_client *client, uint8_t *x, size_t xlen);
+void secure_rng_client_close(struct secure_rng_client *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
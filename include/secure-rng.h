@@ -7,16 +7,159 @@
 #define RNG_SUCCESS       0
 #define RNG_BAD_MAXLEN   -1
 #define RNG_NEED_RESEED  -2
+#define RNG_IO_ERROR     -3
+#define RNG_NOT_SUPPORTED -4
+#define RNG_HEALTH_FAILURE -5
 
 #define MAX_GENERATE_LENGTH 65535
 
+// AES implementations
+#define RNG_BACKEND_AUTO      0
+#define RNG_BACKEND_SOFTWARE  1
+#define RNG_BACKEND_HARDWARE  2    // AES-NI or Armv8 Cryptographic Extension
+#define RNG_BACKEND_VAES256   3    // VAES with AVX2
+#define RNG_BACKEND_VAES512   4    // VAES with AVX-512
+#define RNG_BACKEND_TUNED     5    // Per size class choice of the autotuner
+
+// Curves of secure_rng_ec_scalars()
+#define RNG_CURVE_SECP256K1   1    // big-endian, 0 < k < n
+#define RNG_CURVE_P256        2    // big-endian, 0 < k < n
+#define RNG_CURVE_X25519      3    // little-endian, clamped per RFC 7748
+#define RNG_CURVE_ED25519     4    // 32-byte seed per RFC 8032
+
+// Number of request size classes tuned separately
+#define RNG_PLAN_CLASSES 4
+
+// Policy limit value which is never reached
+#define RNG_NO_LIMIT     UINT64_MAX
+
+// Reseeding is required once any of these limits is hit
+struct secure_rng_policy {
+    uint64_t  max_calls;     // secure_rng_bytes() invocations
+    uint64_t  max_bytes;     // bytes generated
+    uint64_t  max_age_ms;    // milliseconds of monotonic time
+};
+
+// Latency histogram size, bucket i counts
+//  latencies in [2^(i-1), 2^i) nanoseconds
+#define RNG_STATS_BUCKETS 64
+
+// Runtime statistics, available if the library
+//  is built with ENABLE_STATS option
+struct secure_rng_stats {
+    uint64_t  calls;          // secure_rng_bytes() invocations
+    uint64_t  bytes;          // bytes generated
+    uint64_t  reseeds;        // reseeds, including explicit ones
+    uint64_t  need_reseed;    // RNG_NEED_RESEED results
+    uint64_t  seeder_calls;   // seeder function invocations
+    uint64_t  generate_ns[RNG_STATS_BUCKETS];
+    uint64_t  seeder_ns[RNG_STATS_BUCKETS];
+    int       backend;
+};
+
+// Alphabets of secure_rng_token() with vectorized encoders,
+//  any other one goes through rejection sampling
+#define RNG_ALPHABET_HEX       "0123456789abcdef"
+#define RNG_ALPHABET_BASE64URL "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_"
+#define RNG_ALPHABET_BASE62    "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz"
+
+// Bytes per UUID of secure_rng_uuid4_batch(), including the terminator
+#define RNG_UUID_STRLEN 37
+
+// SP 800-90B cutoffs for byte samples of 1 bit min-entropy,
+//  with false positive probability of 2^-20
+#define RNG_HEALTH_RCT_CUTOFF 21     // 1 + ceil(20 / H)
+#define RNG_HEALTH_APT_CUTOFF 311    // window of 512 samples
+#define RNG_HEALTH_APT_WINDOW 512
+
+// Continuous health tests of seeder output, each byte is a
+//  sample. Initialized by secure_rng_health_init, the test
+//  state is carried from one block to the next.
+struct secure_rng_health {
+    uint32_t  rct_cutoff;     // identical samples in a row which fail
+    uint32_t  apt_cutoff;     // repeats of a window's first sample which fail
+    uint64_t  blocks;         // tested blocks
+    uint64_t  rct_failures;   // Repetition Count Test failures
+    uint64_t  apt_failures;   // Adaptive Proportion Test failures
+    uint32_t  rct_run;
+    uint32_t  apt_count;
+    uint32_t  apt_seen;
+    uint8_t   rct_last;
+    uint8_t   apt_first;
+};
+
+// Buffer, offset and length alignment of direct I/O fills
+#define RNG_FILL_ALIGN 4096
+
+// Write with pwrite() even if io_uring is available
+#define RNG_FILL_PWRITE 1
+
+// Settings of secure_rng_fill_fd_ex, zero picks the default
+struct secure_rng_fill_options {
+    uint32_t  queue_depth;    // writes in flight, 8 by default and at most 256
+    uint32_t  buffer_size;    // bytes per write, multiple of RNG_FILL_ALIGN, 1 MiB by default
+    uint32_t  flags;
+};
+
+// Tile sizes of secure_rng_stream, the default fits in L1 along
+//  with the consumer's own data
+#define RNG_STREAM_TILE      16384
+#define RNG_STREAM_MAX_TILE  32768
+
+// Consumer of secure_rng_stream tiles, the tile is overwritten once
+//  it returns. Returning nonzero stops the stream.
+typedef int (*secure_rng_consumer_fn)(const uint8_t *tile, size_t len, void *userdata);
+
+// Backends chosen by the autotuner, class i covers AES
+//  kernel invocations up to max_bytes[i] bytes long
+struct secure_rng_plan {
+    uint32_t  max_bytes[RNG_PLAN_CLASSES];
+    int       backend[RNG_PLAN_CLASSES];
+    uint32_t  mbps[RNG_PLAN_CLASSES];     // measured throughput, MB/s
+};
+
+// 64-bit words of keystream buffered for secure_rng_bit and friends
+#define RNG_BIT_WORDS 32
+
 struct secure_rng_ctx {
     uint8_t   Key[32];
     uint8_t   V[16];
     uint64_t  reseed_counter;
-    uint64_t  reseed_interval;
+    uint64_t  reseed_bytes;
+    uint64_t  reseed_time;
+    struct secure_rng_policy policy;
+    uint64_t  fork_generation;
+    struct secure_rng_stats *stats;
+    struct secure_rng_health *health;
+    uint64_t  nontemporal_bytes;
+    uint64_t  bit_word;       // reservoir bits, consumed from the top
+    uint32_t  bit_count;      // bits left in bit_word
+    uint32_t  bit_position;   // next word of bit_words
+    uint64_t  bit_words[RNG_BIT_WORDS];
     void (*resistance_seeder)(uint8_t seed_out[48]);
     void (*aesctr256)(uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+    void (*aesctr256_xor)(uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+} __attribute__ ((aligned (16)));
+
+// Keystream batch of the fast key erasure engine
+#define RNG_FKE_BUFFER 2048
+
+// Fast key erasure engine: keystream is generated in batches and the
+//  first 32 bytes of each one replace the key at once. Seeder, policy,
+//  fork detection, health tests and backend are set on the drbg member.
+struct secure_rng_fke_ctx {
+    struct secure_rng_ctx drbg;
+    uint32_t  position;
+    uint8_t   buffer[RNG_FKE_BUFFER] __attribute__ ((aligned (64)));
+};
+
+// Expand mode: a fixed AES-CTR keystream derived from a seed, which
+//  may be read at any offset. Not a DRBG, nothing is ever rekeyed
+//  and the same seed always gives the same stream.
+struct secure_rng_expand_ctx {
+    uint8_t   Key[32];
+    uint8_t   IV[16];     // counter block at offset 0
+    void (*aesctr256)(uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
 } __attribute__ ((aligned (16)));
 
 #ifdef __cplusplus
@@ -24,9 +167,46 @@ extern "C" {
 #endif
 
 void secure_rng_set_seeder(struct secure_rng_ctx *ctx, void (*resistance_seeder_function)(uint8_t seed_out[48]), uint64_t reseed_interval);
+void secure_rng_set_policy(struct secure_rng_ctx *ctx, const struct secure_rng_policy *policy);
+int secure_rng_enable_fork_detection(struct secure_rng_ctx *ctx);
+int secure_rng_forked(const struct secure_rng_ctx *ctx);
+void secure_rng_set_nontemporal(struct secure_rng_ctx *ctx, uint64_t threshold);
+int secure_rng_set_backend(struct secure_rng_ctx *ctx, int backend);
+int secure_rng_autotune(const char *plan_path);
+int secure_rng_get_plan(struct secure_rng_plan *plan);
+int secure_rng_enable_stats(struct secure_rng_ctx *ctx, struct secure_rng_stats *stats);
+int secure_rng_stats_snapshot(const struct secure_rng_ctx *ctx, struct secure_rng_stats *snapshot);
+int secure_rng_health_init(struct secure_rng_health *health, uint32_t rct_cutoff, uint32_t apt_cutoff);
+int secure_rng_health_test(struct secure_rng_health *health, const uint8_t *data, size_t len);
+int secure_rng_enable_health_tests(struct secure_rng_ctx *ctx, struct secure_rng_health *health);
 int secure_rng_seed(struct secure_rng_ctx *ctx, const uint8_t entropy_input[48], const uint8_t *personalization_string, size_t personalization_len);
 int secure_rng_reseed(struct secure_rng_ctx *ctx, const uint8_t entropy_input[48], const uint8_t *additional_data, size_t additional_data_len);
 int secure_rng_bytes(struct secure_rng_ctx *ctx, uint8_t *x, size_t xlen, int resistance);
+int secure_rng_xor(struct secure_rng_ctx *ctx, uint8_t *inout, size_t len, int resistance);
+int secure_rng_bit(struct secure_rng_ctx *ctx);
+int64_t secure_rng_bits(struct secure_rng_ctx *ctx, unsigned nbits);
+int secure_rng_bernoulli(struct secure_rng_ctx *ctx, double p);
+int secure_rng_bit_array(struct secure_rng_ctx *ctx, uint8_t *out, size_t nbits);
+int secure_rng_stream(struct secure_rng_ctx *ctx, uint64_t total_len, size_t tile_size, secure_rng_consumer_fn consumer, void *userdata);
+int secure_rng_fke_seed(struct secure_rng_fke_ctx *ctx, const uint8_t entropy_input[48], const uint8_t *personalization_string, size_t personalization_len);
+int secure_rng_fke_reseed(struct secure_rng_fke_ctx *ctx, const uint8_t entropy_input[48], const uint8_t *additional_data, size_t additional_data_len);
+int secure_rng_fke_bytes(struct secure_rng_fke_ctx *ctx, uint8_t *x, size_t xlen, int resistance);
+int secure_rng_shuffle(struct secure_rng_ctx *ctx, void *base, size_t n, size_t elem_size);
+int secure_rng_sample_indices(struct secure_rng_ctx *ctx, size_t n, size_t k, size_t *out);
+int secure_rng_ec_scalars(struct secure_rng_ctx *ctx, int curve, uint8_t *out, size_t count);
+int secure_rng_token(struct secure_rng_ctx *ctx, const char *alphabet, char *out, size_t len);
+int secure_rng_uuid4_batch(struct secure_rng_ctx *ctx, char *out, size_t n);
+int secure_rng_fill_fd(struct secure_rng_ctx *ctx, int fd, uint64_t offset, uint64_t len);
+int secure_rng_fill_fd_ex(struct secure_rng_ctx *ctx, int fd, uint64_t offset, uint64_t len, const struct secure_rng_fill_options *options);
+
+int secure_rng_expand_init(struct secure_rng_expand_ctx *ctx, const uint8_t seed[48], const uint8_t *label, size_t label_len);
+int secure_rng_stream_at(const struct secure_rng_expand_ctx *ctx, uint64_t offset, uint8_t *out, size_t len);
+void secure_rng_expand_wipe(struct secure_rng_expand_ctx *ctx);
+
+void secure_rng_wipe(void *data, size_t len);
+
+int secure_rng_seed_from_file(struct secure_rng_ctx *ctx, const char *path);
+int secure_rng_save_seed_file(struct secure_rng_ctx *ctx, const char *path);
 
 #ifdef __cplusplus
 }
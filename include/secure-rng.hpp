@@ -0,0 +1,228 @@
+#ifndef SECURERNG_HPP
+#define SECURERNG_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <sys/random.h>
+
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+
+#include "secure-rng.h"
+
+namespace secure_rng {
+
+// Failure reported by the C API, code() is one of RNG_* results
+class error : public std::runtime_error {
+public:
+    explicit error(int code)
+        : std::runtime_error("secure-rng error " + std::to_string(code)), code_(code) {}
+
+    int code() const noexcept { return code_; }
+
+private:
+    int code_;
+};
+
+// Generator which satisfies UniformRandomBitGenerator. Keystream is
+//  generated BufferSize bytes at a time, consumed bytes are wiped.
+//  Instances are move-only and must not be shared between threads.
+template <std::size_t BufferSize = 16384>
+class basic_generator {
+    static_assert(BufferSize >= 64 && BufferSize % 16 == 0 && BufferSize <= (MAX_GENERATE_LENGTH & ~15),
+                  "buffer must be a whole number of blocks and fit into a single request");
+
+public:
+    using result_type = std::uint64_t;
+
+    static constexpr result_type min() noexcept { return 0; }
+    static constexpr result_type max() noexcept { return std::numeric_limits<result_type>::max(); }
+
+    // Seeded by the OS, reseeds itself after fork and
+    //  whenever the reseed policy requires it
+    basic_generator() : state_(make_state()) {
+        std::uint8_t entropy[48];
+        os_entropy(entropy);
+        int result = secure_rng_seed(&state_->ctx, entropy, nullptr, 0);
+        wipe(entropy, sizeof(entropy));
+        check(result);
+        state_->os_seeded = true;
+        check(secure_rng_enable_fork_detection(&state_->ctx));
+    }
+
+    // Seeded by the caller, throws error(RNG_NEED_RESEED) once the
+    //  context runs out or in a forked child, where it would repeat
+    //  the parent's output; reseed through native_handle()
+    explicit basic_generator(const std::uint8_t entropy[48], const std::uint8_t *personalization = nullptr, std::size_t personalization_len = 0)
+        : state_(make_state()) {
+        check(secure_rng_seed(&state_->ctx, entropy, personalization, personalization_len));
+        check(secure_rng_enable_fork_detection(&state_->ctx));
+    }
+
+    basic_generator(const basic_generator &) = delete;
+    basic_generator &operator=(const basic_generator &) = delete;
+    basic_generator(basic_generator &&) noexcept = default;
+    basic_generator &operator=(basic_generator &&) noexcept = default;
+
+    result_type operator()() {
+        if (available() == 0) {
+            refill();
+        }
+        std::uint32_t position = state_->position++;
+        result_type value = state_->words[position];
+        state_->words[position] = 0;
+        return value;
+    }
+
+    // Bulk output, large requests bypass the buffer
+    void bytes(void *out, std::size_t len) {
+        auto *x = static_cast<std::uint8_t *>(out);
+
+        std::size_t part = take(x, len);
+        x += part;
+        len -= part;
+
+        // Whole chunks straight into the destination
+        while (len >= kBytes) {
+            std::size_t chunk = len < kChunk ? (len & ~static_cast<std::size_t>(15)) : kChunk;
+            generate(x, chunk);
+            x += chunk;
+            len -= chunk;
+        }
+
+        if (len) {
+            refill();
+            take(x, len);
+        }
+    }
+
+    // Fill objects of any trivially copyable type with random bits
+    template <typename T>
+    void fill(T *data, std::size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value, "fill() needs a trivially copyable type");
+        static_assert(!std::is_same<typename std::remove_cv<T>::type, bool>::value, "random bits are not valid bool values");
+
+        bytes(data, count * sizeof(T));
+    }
+
+#if __cplusplus >= 202002L
+    template <typename T>
+    void fill(std::span<T> data) {
+        fill(data.data(), data.size());
+    }
+#endif
+
+    // Underlying context, e.g. for secure_rng_set_policy()
+    secure_rng_ctx *native_handle() noexcept { return &state_->ctx; }
+
+private:
+    static constexpr std::size_t kChunk = MAX_GENERATE_LENGTH & ~15;
+    static constexpr std::size_t kBytes = BufferSize;
+    static constexpr std::uint32_t kWords = BufferSize / sizeof(result_type);
+
+    // Buffer is kept in words and the position is a word index of
+    //  another type, so that the compiler knows they don't alias
+    struct state {
+        secure_rng_ctx ctx;
+        alignas(64) result_type words[kWords];
+        std::uint32_t position;
+        bool os_seeded;
+    };
+
+    // Context and keystream are wiped before the memory is released
+    struct state_deleter {
+        void operator()(state *s) const noexcept {
+            wipe(s, sizeof(state));
+            s->~state();
+            ::operator delete(s, std::align_val_t(alignof(state)));
+        }
+    };
+
+    static void wipe(void *p, std::size_t len) noexcept {
+        secure_rng_wipe(p, len);
+    }
+
+    static std::unique_ptr<state, state_deleter> make_state() {
+        void *memory = ::operator new(sizeof(state), std::align_val_t(alignof(state)));
+        state *s = new (memory) state;
+        s->position = kWords;
+        s->os_seeded = false;
+        return std::unique_ptr<state, state_deleter>(s);
+    }
+
+    static void check(int result) {
+        if (result != RNG_SUCCESS) {
+            throw error(result);
+        }
+    }
+
+    static void os_entropy(std::uint8_t entropy[48]) {
+        for (std::size_t done = 0; done < 48; ) {
+            ssize_t result = getrandom(entropy + done, 48 - done, 0);
+            if (result < 0) {
+                if (errno == EINTR) continue;
+                throw error(RNG_IO_ERROR);
+            }
+            done += static_cast<std::size_t>(result);
+        }
+    }
+
+    void generate(std::uint8_t *x, std::size_t len) {
+        int result = secure_rng_bytes(&state_->ctx, x, len, 0);
+
+        if (result == RNG_NEED_RESEED && state_->os_seeded) {
+            std::uint8_t entropy[48];
+            os_entropy(entropy);
+            result = secure_rng_reseed(&state_->ctx, entropy, nullptr, 0);
+            wipe(entropy, sizeof(entropy));
+            check(result);
+            result = secure_rng_bytes(&state_->ctx, x, len, 0);
+        }
+
+        check(result);
+    }
+
+    void refill() {
+        generate(reinterpret_cast<std::uint8_t *>(state_->words), kBytes);
+        state_->position = 0;
+    }
+
+    // Buffered words, none in a forked child. The context is checked,
+    //  as the generate call which follows has to reseed it anyway.
+    std::uint32_t available() const noexcept {
+        if (secure_rng_forked(&state_->ctx)) {
+            return 0;
+        }
+        return kWords - state_->position;
+    }
+
+    // Copy and wipe buffered bytes, returns the number of bytes taken.
+    //  The rest of a partially used word is dropped.
+    std::size_t take(std::uint8_t *x, std::size_t len) {
+        std::size_t left = available() * sizeof(result_type);
+        if (len > left) len = left;
+        result_type *p = state_->words + state_->position;
+        std::uint32_t used = static_cast<std::uint32_t>((len + sizeof(result_type) - 1) / sizeof(result_type));
+        std::memcpy(x, p, len);
+        wipe(p, used * sizeof(result_type));
+        state_->position += used;
+        return len;
+    }
+
+    std::unique_ptr<state, state_deleter> state_;
+};
+
+using generator = basic_generator<>;
+
+}
+
+#endif
@@ -0,0 +1,92 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "secure-rng.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef SECURE_RNG_STATS
+
+#include <time.h>
+
+// Statistics of the calling thread
+struct secure_rng_stats *rng_stats_thread(void);
+
+inline static uint64_t rng_stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Counters have a single writer, so relaxed load and store
+//  pair is enough and doesn't need a locked instruction
+inline static void rng_stats_add(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+// Bucket i holds latencies in [2^(i-1), 2^i) nanoseconds
+inline static int rng_stats_bucket(uint64_t ns) {
+    int bucket = ns ? 64 - __builtin_clzll(ns) : 0;
+    return bucket < RNG_STATS_BUCKETS ? bucket : RNG_STATS_BUCKETS - 1;
+}
+
+inline static void rng_stats_generate(const struct secure_rng_ctx *ctx, size_t bytes, uint64_t start) {
+    struct secure_rng_stats *global = rng_stats_thread();
+    int bucket = rng_stats_bucket(rng_stats_now() - start);
+
+    rng_stats_add(&global->calls, 1);
+    rng_stats_add(&global->bytes, bytes);
+    rng_stats_add(&global->generate_ns[bucket], 1);
+
+    if (ctx->stats != NULL) {
+        rng_stats_add(&ctx->stats->calls, 1);
+        rng_stats_add(&ctx->stats->bytes, bytes);
+        rng_stats_add(&ctx->stats->generate_ns[bucket], 1);
+    }
+}
+
+inline static void rng_stats_seeder(const struct secure_rng_ctx *ctx, uint64_t start) {
+    struct secure_rng_stats *global = rng_stats_thread();
+    int bucket = rng_stats_bucket(rng_stats_now() - start);
+
+    rng_stats_add(&global->seeder_calls, 1);
+    rng_stats_add(&global->seeder_ns[bucket], 1);
+
+    if (ctx->stats != NULL) {
+        rng_stats_add(&ctx->stats->seeder_calls, 1);
+        rng_stats_add(&ctx->stats->seeder_ns[bucket], 1);
+    }
+}
+
+inline static void rng_stats_reseed(const struct secure_rng_ctx *ctx) {
+    rng_stats_add(&rng_stats_thread()->reseeds, 1);
+    if (ctx->stats != NULL) {
+        rng_stats_add(&ctx->stats->reseeds, 1);
+    }
+}
+
+inline static void rng_stats_need_reseed(const struct secure_rng_ctx *ctx) {
+    rng_stats_add(&rng_stats_thread()->need_reseed, 1);
+    if (ctx->stats != NULL) {
+        rng_stats_add(&ctx->stats->need_reseed, 1);
+    }
+}
+
+#else
+
+// Statistics are compiled out
+#define rng_stats_now() 0
+#define rng_stats_generate(ctx, bytes, start) ((void)(start))
+#define rng_stats_seeder(ctx, start) ((void)(start))
+#define rng_stats_reseed(ctx) ((void)0)
+#define rng_stats_need_reseed(ctx) ((void)0)
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
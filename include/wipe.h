@@ -0,0 +1,22 @@
+#ifndef WIPE_H
+#define WIPE_H
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Erase sensitive data, the barrier keeps the compiler from
+//  dropping stores to memory which isn't read afterwards
+inline static void rng_wipe(void *data, size_t length) {
+    memset(data, 0, length);
+    __asm__ __volatile__ ("" : : "r" (data) : "memory");
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
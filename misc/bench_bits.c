@@ -0,0 +1,142 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+static struct secure_rng_ctx ctx;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// What callers write without the API: a generator call per draw
+static int bit_naive(void) {
+    uint8_t byte;
+    secure_rng_bytes(&ctx, &byte, 1, 0);
+    return byte & 1;
+}
+
+static int bits3_naive(void) {
+    uint8_t byte;
+    secure_rng_bytes(&ctx, &byte, 1, 0);
+    return byte & 7;
+}
+
+static int bernoulli_naive(double p) {
+    uint64_t word;
+    secure_rng_bytes(&ctx, (uint8_t *)&word, sizeof(word), 0);
+    return (word >> 11) * 0x1.0p-53 < p;
+}
+
+static void report(const char *name, uint64_t elapsed, size_t count, double mean, double expected) {
+    printf("%-22s %8.2f ns %10.3f mean (expected %.3f)\n", name, (double)elapsed / count, mean, expected);
+}
+
+int main(int argc, char **argv) {
+    uint8_t entropy[48] = {0};
+    size_t count = 1 << 24;
+    uint64_t start, sum;
+
+    if (argc > 1) {
+        count = strtoul(argv[1], NULL, 0);
+    }
+
+    secure_rng_seed(&ctx, entropy, NULL, 0);
+
+    sum = 0;
+    start = now_ns();
+    for (size_t i = 0; i < count / 16; ++i) {
+        sum += bit_naive();
+    }
+    report("bit naive", now_ns() - start, count / 16, (double)sum / (count / 16), 0.5);
+
+    sum = 0;
+    start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        sum += secure_rng_bit(&ctx);
+    }
+    report("secure_rng_bit", now_ns() - start, count, (double)sum / count, 0.5);
+
+    sum = 0;
+    start = now_ns();
+    for (size_t i = 0; i < count / 16; ++i) {
+        sum += bits3_naive();
+    }
+    report("bits(3) naive", now_ns() - start, count / 16, (double)sum / (count / 16), 3.5);
+
+    // Every value of a small draw must turn up equally often
+    size_t histogram[8] = {0};
+    start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        histogram[secure_rng_bits(&ctx, 3)]++;
+    }
+    uint64_t elapsed = now_ns() - start;
+    sum = 0;
+    double chi2 = 0;
+    for (int v = 0; v < 8; ++v) {
+        double deviation = histogram[v] - count / 8.0;
+        chi2 += deviation * deviation / (count / 8.0);
+        sum += v * histogram[v];
+    }
+    report("secure_rng_bits(3)", elapsed, count, (double)sum / count, 3.5);
+    printf("%-22s %8.2f chi-square, 7 degrees of freedom\n", "", chi2);
+
+    // Wide draws straddle reservoir words
+    sum = 0;
+    start = now_ns();
+    for (size_t i = 0; i < count; ++i) {
+        sum += (uint64_t)secure_rng_bits(&ctx, 27);
+    }
+    report("secure_rng_bits(27)", now_ns() - start, count, (double)sum / count / (1 << 26), 1.0);
+
+    static const double probabilities[] = { 0.5, 0.3, 1e-3, 1e-9 };
+    for (size_t k = 0; k < sizeof(probabilities) / sizeof(probabilities[0]); ++k) {
+        double p = probabilities[k];
+        char name[32];
+
+        sum = 0;
+        start = now_ns();
+        for (size_t i = 0; i < count / 16; ++i) {
+            sum += bernoulli_naive(p);
+        }
+        snprintf(name, sizeof(name), "bernoulli(%g) naive", p);
+        report(name, now_ns() - start, count / 16, (double)sum / (count / 16) / p, 1.0);
+
+        sum = 0;
+        start = now_ns();
+        for (size_t i = 0; i < count; ++i) {
+            sum += secure_rng_bernoulli(&ctx, p);
+        }
+        snprintf(name, sizeof(name), "bernoulli(%g)", p);
+        report(name, now_ns() - start, count, (double)sum / count / p, 1.0);
+    }
+
+    // Packed arrays, bits past the end must stay clear
+    static const size_t sizes[] = { 13, 256, 4096, 1 << 20 };
+    uint8_t *array = malloc((1 << 20) / 8 + 1);
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        size_t nbits = sizes[k], rounds = (count / nbits) + 1, ones = 0, stray = 0;
+        char name[32];
+
+        start = now_ns();
+        for (size_t r = 0; r < rounds; ++r) {
+            memset(array, 0xff, nbits / 8 + 1);
+            secure_rng_bit_array(&ctx, array, nbits);
+            stray |= (nbits % 8) ? array[nbits / 8] >> (nbits % 8) : array[nbits / 8] != 0xff;
+        }
+        elapsed = now_ns() - start;
+        for (size_t i = 0; i < nbits; ++i) {
+            ones += (array[i / 8] >> (i % 8)) & 1;
+        }
+        snprintf(name, sizeof(name), "bit_array(%zu)", nbits);
+        printf("%-22s %8.3f ns/bit %7.3f mean%s\n", name, (double)elapsed / (rounds * nbits), (double)ones / nbits,
+               stray ? " BITS PAST THE END" : "");
+    }
+
+    free(array);
+    return 0;
+}
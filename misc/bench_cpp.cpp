@@ -0,0 +1,112 @@
+#include "secure-rng.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+// Values drawn per case, as 64-bit words
+static std::size_t count = 1 << 24;
+
+// Keep results alive without printing them
+static volatile std::uint64_t sink;
+
+// The adapter users write by hand: one library call per value
+class naive_adapter {
+public:
+    using result_type = std::uint64_t;
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    explicit naive_adapter(secure_rng_ctx *ctx) : ctx_(ctx) {}
+
+    result_type operator()() {
+        result_type value;
+        secure_rng_bytes(ctx_, reinterpret_cast<std::uint8_t *>(&value), sizeof(value), 0);
+        return value;
+    }
+
+private:
+    secure_rng_ctx *ctx_;
+};
+
+template <typename F>
+static void run(const char *name, std::size_t values, F &&body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    std::printf("%-24s %10zu %10.2f ns %10.3f GB/s\n", name, values, ns / values, values * 8.0 / ns);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        count = std::strtoul(argv[1], nullptr, 0);
+    }
+    if (count < 1024) {
+        std::fprintf(stderr, "Usage: %s [values, at least 1024]\n", argv[0]);
+        return -1;
+    }
+
+    std::uint8_t entropy[48] = {0};
+    secure_rng_ctx ctx;
+    secure_rng_seed(&ctx, entropy, nullptr, 0);
+    secure_rng::generator rng;
+    std::vector<std::uint64_t> words(count);
+    std::vector<std::uint32_t> deck(count);
+
+    std::printf("%-24s %10s %13s %15s\n", "case", "values", "per value", "keystream");
+
+    run("raw secure_rng_bytes", count, [&] {
+        auto *out = reinterpret_cast<std::uint8_t *>(words.data());
+        for (std::size_t done = 0, len = count * 8; done < len; done += 16384) {
+            secure_rng_bytes(&ctx, out + done, std::min<std::size_t>(16384, len - done), 0);
+        }
+        sink = words[count - 1];
+    });
+
+    run("naive adapter", count / 16, [&] {
+        naive_adapter naive(&ctx);
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < count / 16; ++i) sum += naive();
+        sink = sum;
+    });
+
+    run("generator()", count, [&] {
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < count; ++i) sum += rng();
+        sink = sum;
+    });
+
+    run("fill<uint64_t>", count, [&] {
+        rng.fill(words.data(), words.size());
+        sink = words[count - 1];
+    });
+
+    run("uniform_int(0, 999)", count, [&] {
+        std::uniform_int_distribution<std::uint32_t> distribution(0, 999);
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < count; ++i) sum += distribution(rng);
+        sink = sum;
+    });
+
+    run("uniform_real(0, 1)", count, [&] {
+        std::uniform_real_distribution<double> distribution(0.0, 1.0);
+        double sum = 0;
+        for (std::size_t i = 0; i < count; ++i) sum += distribution(rng);
+        sink = static_cast<std::uint64_t>(sum);
+    });
+
+    std::iota(deck.begin(), deck.end(), 0);
+    run("std::shuffle", count, [&] {
+        std::shuffle(deck.begin(), deck.end(), rng);
+        sink = deck[0];
+    });
+
+    return 0;
+}
@@ -0,0 +1,294 @@
+#include "secure-rng.h"
+#include "secure-rng-client.h"
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/wait.h>
+
+#define MAX_CLIENTS     256
+#define MAX_SAMPLES     (1 << 20)
+#define STARTUP_RUNS    2000
+
+struct options {
+    const char *socket_path;
+    const char *daemon_path;
+    int clients;
+    size_t size;
+    double seconds;
+};
+
+static struct options options = { NULL, NULL, 4, 32, 1.0 };
+
+// Per process results, sent to the parent through a pipe
+struct result {
+    uint64_t reads;
+    uint64_t bytes;
+    uint64_t elapsed_ns;
+    uint64_t p50_ns;
+    uint64_t p99_ns;
+    uint64_t p999_ns;
+    int failed;
+};
+
+#define SOURCE_DAEMON    0
+#define SOURCE_GETRANDOM 1
+
+static const char *source_names[] = { "daemon", "getrandom" };
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int compare_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int getrandom_bytes(uint8_t *x, size_t len) {
+    while (len) {
+        ssize_t result = getrandom(x, len, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        x += result;
+        len -= (size_t)result;
+    }
+    return 0;
+}
+
+// Cost of a short lived process getting its first random bytes
+static void bench_startup(void) {
+    static uint64_t samples[3][STARTUP_RUNS];
+    static const char *names[] = { "client_open", "seed_context", "getrandom" };
+    uint8_t out[32], entropy[48];
+
+    for (int r = 0; r < STARTUP_RUNS; ++r) {
+        struct secure_rng_client *client;
+        struct secure_rng_ctx ctx;
+        uint64_t tic = now_ns();
+
+        client = secure_rng_client_open(options.socket_path);
+        if (client == NULL || secure_rng_client_bytes(client, out, sizeof(out)) != RNG_SUCCESS) {
+            fprintf(stderr, "can't read from the daemon\n");
+            exit(1);
+        }
+        secure_rng_client_close(client);
+        samples[0][r] = now_ns() - tic;
+
+        tic = now_ns();
+        if (getrandom_bytes(entropy, sizeof(entropy)) != 0
+                || secure_rng_seed(&ctx, entropy, NULL, 0) != RNG_SUCCESS
+                || secure_rng_bytes(&ctx, out, sizeof(out), 0) != RNG_SUCCESS) {
+            fprintf(stderr, "can't seed a context\n");
+            exit(1);
+        }
+        samples[1][r] = now_ns() - tic;
+
+        tic = now_ns();
+        if (getrandom_bytes(out, sizeof(out)) != 0) {
+            exit(1);
+        }
+        samples[2][r] = now_ns() - tic;
+    }
+
+    for (int i = 0; i < 3; ++i) {
+        qsort(samples[i], STARTUP_RUNS, sizeof(uint64_t), compare_u64);
+        printf("%-12s %8zu %8d %10llu ns %10llu ns\n", names[i], sizeof(out), 1,
+               (unsigned long long)samples[i][STARTUP_RUNS / 2],
+               (unsigned long long)samples[i][STARTUP_RUNS * 99 / 100]);
+    }
+}
+
+static void client_process(int source, int fd) {
+    static uint64_t samples[MAX_SAMPLES];
+    struct secure_rng_client *client = NULL;
+    struct result result;
+    uint8_t *buffer = malloc(options.size);
+    uint64_t start, deadline, count = 0;
+
+    memset(&result, 0, sizeof(result));
+    if (source == SOURCE_DAEMON) {
+        client = secure_rng_client_open(options.socket_path);
+        result.failed = (client == NULL);
+    }
+    result.failed |= (buffer == NULL);
+
+    start = now_ns();
+    deadline = start + (uint64_t)(options.seconds * 1e9);
+    while (!result.failed) {
+        uint64_t tic = now_ns();
+        if (tic >= deadline) {
+            break;
+        }
+
+        if (source == SOURCE_DAEMON) {
+            result.failed = (secure_rng_client_bytes(client, buffer, options.size) != RNG_SUCCESS);
+        }
+        else {
+            result.failed = (getrandom_bytes(buffer, options.size) != 0);
+        }
+
+        // Keep the latest samples if there are too many
+        samples[count++ % MAX_SAMPLES] = now_ns() - tic;
+    }
+    result.elapsed_ns = now_ns() - start;
+    result.reads = count;
+    result.bytes = count * options.size;
+
+    if (count) {
+        uint64_t n = (count < MAX_SAMPLES) ? count : MAX_SAMPLES;
+        qsort(samples, n, sizeof(uint64_t), compare_u64);
+        result.p50_ns = samples[n / 2];
+        result.p99_ns = samples[n * 99 / 100];
+        result.p999_ns = samples[n * 999 / 1000];
+    }
+
+    secure_rng_client_close(client);
+    if (write(fd, &result, sizeof(result)) != sizeof(result)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+// Concurrent clients, each one in its own process
+static int bench_load(int source) {
+    struct result total, result;
+    uint64_t p50 = 0, p99 = 0, p999 = 0;
+    pid_t pids[MAX_CLIENTS];
+    int fds[2];
+
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+
+    // Children must not flush the parent's buffered output
+    fflush(stdout);
+    for (int i = 0; i < options.clients; ++i) {
+        pid_t pid = fork();
+        if (pid < 0) {
+            return -1;
+        }
+        pids[i] = pid;
+        if (pid == 0) {
+            close(fds[0]);
+            client_process(source, fds[1]);
+        }
+    }
+    close(fds[1]);
+
+    // Latency percentiles are the worst among clients
+    memset(&total, 0, sizeof(total));
+    for (int i = 0; i < options.clients; ++i) {
+        if (read(fds[0], &result, sizeof(result)) != sizeof(result)) {
+            total.failed = 1;
+            break;
+        }
+        total.failed |= result.failed;
+        total.reads += result.reads;
+        total.bytes += result.bytes;
+        if (result.elapsed_ns > total.elapsed_ns) total.elapsed_ns = result.elapsed_ns;
+        if (result.p50_ns > p50) p50 = result.p50_ns;
+        if (result.p99_ns > p99) p99 = result.p99_ns;
+        if (result.p999_ns > p999) p999 = result.p999_ns;
+    }
+    close(fds[0]);
+
+    // Not wait(), the daemon may be our child too
+    for (int i = 0; i < options.clients; ++i) {
+        waitpid(pids[i], NULL, 0);
+    }
+
+    if (total.failed || total.elapsed_ns == 0) {
+        fprintf(stderr, "%s clients failed\n", source_names[source]);
+        return -1;
+    }
+
+    printf("%-12s %8zu %8d %10llu ns %10llu ns %10llu ns %10.3f GB/s %12.0f reads/s\n", source_names[source], options.size, options.clients,
+           (unsigned long long)p50, (unsigned long long)p99, (unsigned long long)p999,
+           (double)total.bytes / total.elapsed_ns, total.reads * 1e9 / total.elapsed_ns);
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --socket PATH    daemon socket (default: $SECURE_RNG_SOCKET or %s)\n"
+            "  --daemon PATH    start this daemon binary for the duration of the test\n"
+            "  --clients N      concurrent client processes (default %d)\n"
+            "  --size BYTES     read size (default %zu)\n"
+            "  --seconds S      duration of the load test (default %.1f)\n",
+            program, SECURE_RNG_DEFAULT_SOCKET, options.clients, options.size, options.seconds);
+}
+
+int main(int argc, char **argv) {
+    pid_t daemon_pid = -1;
+    int status = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--socket") && i + 1 < argc) {
+            options.socket_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--daemon") && i + 1 < argc) {
+            options.daemon_path = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--clients") && i + 1 < argc) {
+            options.clients = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            options.size = (size_t)atol(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            options.seconds = atof(argv[++i]);
+        }
+        else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (options.clients < 1 || options.clients > MAX_CLIENTS || options.size < 1 || options.seconds <= 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (options.daemon_path) {
+        const char *path = options.socket_path ? options.socket_path : SECURE_RNG_DEFAULT_SOCKET;
+        daemon_pid = fork();
+        if (daemon_pid == 0) {
+            execl(options.daemon_path, options.daemon_path, "-s", path, (char *)NULL);
+            _exit(127);
+        }
+
+        // Wait for the socket to appear
+        for (int i = 0; i < 200; ++i) {
+            struct secure_rng_client *probe = secure_rng_client_open(path);
+            if (probe != NULL) {
+                secure_rng_client_close(probe);
+                break;
+            }
+            usleep(10000);
+        }
+    }
+
+    printf("%-12s %8s %8s %13s %13s %13s %15s %19s\n", "source", "size", "clients", "p50", "p99", "p99.9", "throughput", "rate");
+    bench_startup();
+    if (bench_load(SOURCE_DAEMON) != 0 || bench_load(SOURCE_GETRANDOM) != 0) {
+        status = -1;
+    }
+
+    if (daemon_pid > 0) {
+        kill(daemon_pid, SIGTERM);
+        waitpid(daemon_pid, NULL, 0);
+    }
+
+    return status;
+}
@@ -0,0 +1,123 @@
+#include "secure-rng.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MAX_THREADS 64
+
+struct slice {
+    pthread_t thread;
+    const struct secure_rng_expand_ctx *ctx;
+    uint64_t offset;
+    uint8_t *out;
+    size_t len;
+    int result;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *slice_run(void *arg) {
+    struct slice *slice = arg;
+    slice->result = secure_rng_stream_at(slice->ctx, slice->offset, slice->out, slice->len);
+    return NULL;
+}
+
+// Workers fill disjoint slices of one buffer, slice boundaries
+//  are deliberately not block aligned
+static double bench_parallel(const struct secure_rng_expand_ctx *ctx, uint8_t *out, size_t total, int threads) {
+    struct slice slices[MAX_THREADS];
+    size_t per_thread = total / threads;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < threads; ++i) {
+        size_t begin = i * per_thread + (i ? 7 : 0);
+        size_t end = (i == threads - 1) ? total : (i + 1) * per_thread + 7;
+        slices[i].ctx = ctx;
+        slices[i].offset = begin;
+        slices[i].out = out + begin;
+        slices[i].len = end - begin;
+        pthread_create(&slices[i].thread, NULL, slice_run, &slices[i]);
+    }
+    for (int i = 0; i < threads; ++i) {
+        pthread_join(slices[i].thread, NULL);
+        if (slices[i].result != RNG_SUCCESS) {
+            return -1;
+        }
+    }
+    return (double)total / (now_ns() - start);
+}
+
+// Sequential DRBG output of the same size, for reference
+static double bench_drbg(uint8_t *out, size_t total) {
+    struct secure_rng_ctx drbg;
+    uint8_t entropy[48] = {0};
+    const size_t chunk = MAX_GENERATE_LENGTH & ~15;
+
+    secure_rng_seed(&drbg, entropy, NULL, 0);
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < total; done += chunk) {
+        secure_rng_bytes(&drbg, out + done, (total - done < chunk) ? total - done : chunk, 0);
+    }
+    return (double)total / (now_ns() - start);
+}
+
+int main(int argc, char **argv) {
+    struct secure_rng_expand_ctx ctx;
+    uint8_t seed[48] = {0};
+    size_t total = (size_t)256 << 20;
+    int max_threads = 8;
+
+    if (argc > 1) {
+        max_threads = atoi(argv[1]);
+    }
+    if (max_threads < 1 || max_threads > MAX_THREADS) {
+        fprintf(stderr, "Usage: %s [threads]\n", argv[0]);
+        return -1;
+    }
+
+    uint8_t *reference = malloc(total);
+    uint8_t *out = malloc(total);
+    if (reference == NULL || out == NULL || secure_rng_expand_init(&ctx, seed, (const uint8_t *)"bench", 5) != RNG_SUCCESS) {
+        return 1;
+    }
+
+    memset(reference, 0, total);
+    memset(out, 0, total);
+    printf("%-24s %8.2f GB/s\n", "secure_rng_bytes", bench_drbg(out, total));
+    printf("%-24s %8.2f GB/s\n", "secure_rng_stream_at", bench_parallel(&ctx, reference, total, 1));
+
+    for (int threads = 2; threads <= max_threads; threads *= 2) {
+        memset(out, 0, total);
+        double rate = bench_parallel(&ctx, out, total, threads);
+        printf("%-13s %2d threads %8.2f GB/s %s\n", "secure_rng_stream_at", threads, rate,
+               (rate > 0 && !memcmp(out, reference, total)) ? "" : "MISMATCH");
+    }
+
+    // Random access must agree with the sequential stream
+    struct secure_rng_ctx picker;
+    secure_rng_seed(&picker, seed, NULL, 0);
+    uint64_t start = now_ns();
+    int mismatches = 0;
+    for (int i = 0; i < 100000; ++i) {
+        uint64_t position[2];
+        uint8_t piece[100];
+        secure_rng_bytes(&picker, (uint8_t *)position, sizeof(position), 0);
+        size_t len = position[1] % sizeof(piece);
+        uint64_t offset = position[0] % (total - len);
+        secure_rng_stream_at(&ctx, offset, piece, len);
+        mismatches += memcmp(piece, reference + offset, len) != 0;
+    }
+    printf("%-24s %8.1f ns per seek %s\n", "random access", (now_ns() - start) / 100000.0, mismatches ? "MISMATCH" : "");
+
+    secure_rng_expand_wipe(&ctx);
+    free(reference);
+    free(out);
+    return 0;
+}
@@ -0,0 +1,151 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/random.h>
+
+#define BLOCK       48
+#define BLOCKS      (1 << 16)
+
+static struct secure_rng_ctx source;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Straightforward byte at a time version of the same tests,
+//  for the comparison of speed and verdicts
+struct naive_health {
+    uint32_t rct_run, apt_count, apt_seen;
+    uint8_t rct_last, apt_first;
+    uint64_t rct_failures, apt_failures;
+};
+
+static int naive_test(struct naive_health *h, const uint8_t *data, size_t len) {
+    int failed = 0;
+
+    for (size_t i = 0; i < len; ++i) {
+        if (h->rct_run > 0 && data[i] == h->rct_last) {
+            failed |= ++h->rct_run >= RNG_HEALTH_RCT_CUTOFF;
+        }
+        else {
+            h->rct_run = 1;
+        }
+        h->rct_last = data[i];
+
+        if (h->apt_seen == 0) {
+            h->apt_first = data[i];
+            h->apt_count = 0;
+        }
+        if (data[i] == h->apt_first && ++h->apt_count >= RNG_HEALTH_APT_CUTOFF) {
+            failed |= 2;
+        }
+        h->apt_seen = (h->apt_seen + 1) % RNG_HEALTH_APT_WINDOW;
+    }
+
+    // The whole block fails and the tests start over
+    if (failed) {
+        h->rct_failures += failed & 1;
+        h->apt_failures += (failed >> 1) & 1;
+        h->rct_run = 0;
+        h->apt_seen = 0;
+        return RNG_HEALTH_FAILURE;
+    }
+    return RNG_SUCCESS;
+}
+
+// Bytes which are zero with the given probability in percent
+static void fill_biased(uint8_t *data, size_t len, int zero_percent) {
+    const size_t chunk = MAX_GENERATE_LENGTH & ~15;
+    for (size_t done = 0; done < len; done += chunk) {
+        secure_rng_bytes(&source, data + done, (len - done < chunk) ? len - done : chunk, 0);
+    }
+    for (size_t i = 0; i < len; ++i) {
+        data[i] = (data[i] % 100 < zero_percent) ? 0 : data[i];
+    }
+}
+
+static void bench_tests(const char *name, int zero_percent) {
+    uint8_t *data = malloc((size_t)BLOCKS * BLOCK);
+    struct secure_rng_health health;
+    struct naive_health naive;
+    uint64_t start, simd_ns, naive_ns;
+
+    if (data == NULL) {
+        exit(1);
+    }
+    fill_biased(data, (size_t)BLOCKS * BLOCK, zero_percent);
+    secure_rng_health_init(&health, RNG_HEALTH_RCT_CUTOFF, RNG_HEALTH_APT_CUTOFF);
+    memset(&naive, 0, sizeof(naive));
+
+    start = now_ns();
+    for (size_t i = 0; i < BLOCKS; ++i) {
+        secure_rng_health_test(&health, data + i * BLOCK, BLOCK);
+    }
+    simd_ns = now_ns() - start;
+
+    start = now_ns();
+    for (size_t i = 0; i < BLOCKS; ++i) {
+        naive_test(&naive, data + i * BLOCK, BLOCK);
+    }
+    naive_ns = now_ns() - start;
+
+    printf("%-14s %8.1f ns %8.1f ns %8llu %8llu %s\n", name, (double)simd_ns / BLOCKS, (double)naive_ns / BLOCKS,
+           (unsigned long long)health.rct_failures, (unsigned long long)health.apt_failures,
+           (health.rct_failures == naive.rct_failures && health.apt_failures == naive.apt_failures) ? "" : "MISMATCH");
+    free(data);
+}
+
+static void seeder(uint8_t seed_out[48]) {
+    if (getrandom(seed_out, 48, 0) != 48) {
+        abort();
+    }
+}
+
+// Generate with prediction resistance, so that every call runs the seeder
+static double bench_reseed(int with_health) {
+    struct secure_rng_ctx ctx;
+    struct secure_rng_health health;
+    uint8_t entropy[48] = {0}, out[32];
+    const int calls = 100000;
+
+    secure_rng_seed(&ctx, entropy, NULL, 0);
+    secure_rng_set_seeder(&ctx, seeder, 1);
+    if (with_health) {
+        secure_rng_health_init(&health, RNG_HEALTH_RCT_CUTOFF, RNG_HEALTH_APT_CUTOFF);
+        secure_rng_enable_health_tests(&ctx, &health);
+    }
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < calls; ++i) {
+        if (secure_rng_bytes(&ctx, out, sizeof(out), 1) != RNG_SUCCESS) {
+            fprintf(stderr, "secure_rng_bytes failed\n");
+            exit(1);
+        }
+    }
+    return (double)(now_ns() - start) / calls;
+}
+
+int main(void) {
+    uint8_t entropy[48] = {0};
+    secure_rng_seed(&source, entropy, NULL, 0);
+
+    printf("%-14s %11s %11s %8s %8s\n", "input", "per block", "naive", "RCT", "APT");
+    bench_tests("uniform", 0);
+    bench_tests("50% zeroes", 50);
+    bench_tests("70% zeroes", 70);
+
+    // A stuck seeder has to be caught
+    struct secure_rng_health health;
+    uint8_t stuck[BLOCK] = {0};
+    secure_rng_health_init(&health, RNG_HEALTH_RCT_CUTOFF, RNG_HEALTH_APT_CUTOFF);
+    printf("%-14s %s\n", "stuck", secure_rng_health_test(&health, stuck, BLOCK) == RNG_HEALTH_FAILURE ? "detected" : "NOT DETECTED");
+
+    double plain = bench_reseed(0), tested = bench_reseed(1);
+    printf("\nreseed per call %8.1f ns, with health tests %8.1f ns\n", plain, tested);
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define KEY_BYTES   32
+
+struct curve {
+    const char *name;
+    int id;
+    uint8_t order[KEY_BYTES];    // big-endian, all ones if there is none
+};
+
+static const struct curve curves[] = {
+    { "secp256k1", RNG_CURVE_SECP256K1, {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+        0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41 } },
+    { "p256", RNG_CURVE_P256, {
+        0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51 } },
+    { "x25519", RNG_CURVE_X25519, { 0 } },
+};
+
+#define CURVE_COUNT (sizeof(curves) / sizeof(curves[0]))
+
+static const size_t batches[] = { 1, 16, 256, 4096 };
+
+#define BATCH_COUNT (sizeof(batches) / sizeof(batches[0]))
+
+static struct secure_rng_ctx ctx;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int is_zero(const uint8_t *key) {
+    uint8_t bits = 0;
+    for (int i = 0; i < KEY_BYTES; ++i) {
+        bits |= key[i];
+    }
+    return bits == 0;
+}
+
+static int valid_key(const struct curve *curve, const uint8_t *key) {
+    if (curve->id == RNG_CURVE_X25519) {
+        return (key[0] & 7) == 0 && (key[31] & 0xc0) == 0x40;
+    }
+    return !is_zero(key) && memcmp(key, curve->order, KEY_BYTES) < 0;
+}
+
+// What callers write without the API: one library call per key,
+//  then a range check and a retry
+static void keys_naive(const struct curve *curve, uint8_t *out, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t *key = out + i * KEY_BYTES;
+        do {
+            secure_rng_bytes(&ctx, key, KEY_BYTES, 0);
+            if (curve->id == RNG_CURVE_X25519) {
+                key[0] &= 248;
+                key[31] &= 127;
+                key[31] |= 64;
+            }
+        } while (!valid_key(curve, key));
+    }
+}
+
+static void keys_api(const struct curve *curve, uint8_t *out, size_t count) {
+    if (secure_rng_ec_scalars(&ctx, curve->id, out, count) != RNG_SUCCESS) {
+        fprintf(stderr, "secure_rng_ec_scalars failed\n");
+        exit(1);
+    }
+}
+
+static void bench_keys(const struct curve *curve, const char *name, void (*generate)(const struct curve *, uint8_t *, size_t),
+                       size_t batch, size_t total) {
+    uint8_t *out = malloc(batch * KEY_BYTES);
+    size_t invalid = 0;
+
+    if (out == NULL) {
+        exit(1);
+    }
+
+    uint64_t start = now_ns();
+    for (size_t done = 0; done < total; done += batch) {
+        generate(curve, out, batch);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    for (size_t i = 0; i < batch; ++i) {
+        invalid += !valid_key(curve, out + i * KEY_BYTES);
+    }
+
+    printf("%-10s %-12s %6zu %10.2f ns %10.2f M keys/s %s\n", curve->name, name, batch,
+           (double)elapsed / total, total * 1e3 / elapsed, invalid ? "INVALID KEYS" : "");
+    free(out);
+}
+
+int main(int argc, char **argv) {
+    uint8_t entropy[48] = {0};
+    size_t total = 1 << 20;
+
+    if (argc > 1) {
+        total = strtoul(argv[1], NULL, 0);
+    }
+    if (total < batches[BATCH_COUNT - 1]) {
+        fprintf(stderr, "Usage: %s [keys, at least %zu]\n", argv[0], batches[BATCH_COUNT - 1]);
+        return -1;
+    }
+
+    secure_rng_seed(&ctx, entropy, NULL, 0);
+
+    printf("%-10s %-12s %6s %13s %18s\n", "curve", "method", "batch", "per key", "rate");
+    for (size_t c = 0; c < CURVE_COUNT; ++c) {
+        bench_keys(&curves[c], "naive", keys_naive, 1, total);
+        for (size_t b = 0; b < BATCH_COUNT; ++b) {
+            bench_keys(&curves[c], "secure_rng", keys_api, batches[b], total);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include "secure-rng.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_THREADS     64
+#define MAX_SIZE        MAX_GENERATE_LENGTH
+
+// Log-linear histogram: values below 2^HIST_SUB_BITS are exact, larger
+//  values are recorded with HIST_SUB_BITS bits of precision (< 1%)
+#define HIST_SUB_BITS   7
+#define HIST_SUB_COUNT  (1 << HIST_SUB_BITS)
+#define HIST_BUCKETS    ((64 - HIST_SUB_BITS + 1) * HIST_SUB_COUNT)
+
+struct histogram {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+};
+
+// Seeder stand-ins
+
+#define SEEDER_NONE     0
+#define SEEDER_FIXED    1
+#define SEEDER_JITTER   2
+#define SEEDER_STALL    3
+#define SEEDER_URANDOM  4
+
+struct seeder_model {
+    int type;
+    uint64_t min_ns;      // fixed delay or lower jitter bound
+    uint64_t max_ns;      // upper jitter bound
+    double stall_prob;    // probability of a stall
+    uint64_t stall_ns;    // stall duration
+    char name[64];
+};
+
+struct scenario {
+    struct seeder_model seeder;
+    uint64_t interval;
+    size_t size;
+    int threads;
+    int shared;
+    uint64_t calls;
+};
+
+// Seeder callback has no user data
+static struct seeder_model seeder;
+static __thread uint64_t rng_state;
+static int urandom_fd = -1;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Cheap thread local PRNG for delay models only
+static uint64_t xorshift(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double uniform(void) {
+    return (xorshift() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Busy wait models CPU-bound entropy collection
+static void spin_ns(uint64_t ns) {
+    uint64_t deadline = now_ns() + ns;
+    while (now_ns() < deadline);
+}
+
+// Sleep models blocking entropy sources
+static void sleep_ns(uint64_t ns) {
+    struct timespec ts = { (time_t)(ns / 1000000000), (long)(ns % 1000000000) };
+    while (nanosleep(&ts, &ts) != 0);
+}
+
+static void model_seeder(uint8_t entropy[48]) {
+    switch (seeder.type) {
+    case SEEDER_FIXED:
+        spin_ns(seeder.min_ns);
+        break;
+    case SEEDER_JITTER:
+        spin_ns(seeder.min_ns + (uint64_t)(uniform() * (seeder.max_ns - seeder.min_ns)));
+        break;
+    case SEEDER_STALL:
+        spin_ns(seeder.min_ns);
+        if (uniform() < seeder.stall_prob) {
+            sleep_ns(seeder.stall_ns);
+        }
+        break;
+    case SEEDER_URANDOM:
+        if (read(urandom_fd, entropy, 48) != 48) abort();
+        return;
+    }
+    memset(entropy, 0xa5, 48);
+}
+
+// Histogram
+
+static int hist_index(uint64_t value) {
+    int msb, octave;
+
+    if (value < HIST_SUB_COUNT) {
+        return (int)value;
+    }
+
+    msb = 63 - __builtin_clzll(value);
+    octave = msb - HIST_SUB_BITS + 1;
+    return (octave << HIST_SUB_BITS) + (int)((value >> (msb - HIST_SUB_BITS)) & (HIST_SUB_COUNT - 1));
+}
+
+// Highest value which falls into the bucket
+static uint64_t hist_value(int index) {
+    int octave = index >> HIST_SUB_BITS;
+    uint64_t sub = index & (HIST_SUB_COUNT - 1);
+
+    if (octave == 0) {
+        return sub;
+    }
+
+    return ((HIST_SUB_COUNT + sub + 1) << (octave - 1)) - 1;
+}
+
+static void hist_reset(struct histogram *h) {
+    memset(h, 0, sizeof(*h));
+    h->min = UINT64_MAX;
+}
+
+static inline void hist_record(struct histogram *h, uint64_t value) {
+    h->counts[hist_index(value)]++;
+    h->total++;
+    if (value < h->min) h->min = value;
+    if (value > h->max) h->max = value;
+}
+
+static void hist_merge(struct histogram *to, const struct histogram *from) {
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        to->counts[i] += from->counts[i];
+    }
+    to->total += from->total;
+    if (from->min < to->min) to->min = from->min;
+    if (from->max > to->max) to->max = from->max;
+}
+
+static uint64_t hist_percentile(const struct histogram *h, double percentile) {
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+    uint64_t seen = 0;
+
+    if (rank < 1) rank = 1;
+    for (int i = 0; i < HIST_BUCKETS; ++i) {
+        seen += h->counts[i];
+        if (seen >= rank) {
+            uint64_t value = hist_value(i);
+            return value < h->max ? value : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+// Workers
+
+struct worker {
+    pthread_t thread;
+    const struct scenario *scenario;
+    struct secure_rng_ctx *ctx;
+    pthread_mutex_t *lock;
+    struct histogram hist;
+    int failed;
+};
+
+static void ctx_init(struct secure_rng_ctx *ctx, const struct scenario *s) {
+    uint8_t entropy[48] = {0};
+
+    secure_rng_seed(ctx, entropy, NULL, 0);
+    if (s->seeder.type != SEEDER_NONE) {
+        secure_rng_set_seeder(ctx, &model_seeder, s->interval);
+    }
+}
+
+static void *worker_main(void *arg) {
+    struct worker *w = (struct worker *)arg;
+    const struct scenario *s = w->scenario;
+    uint8_t out[MAX_SIZE];
+
+    rng_state = (uint64_t)(uintptr_t)w | 1;
+    hist_reset(&w->hist);
+
+    for (uint64_t i = 0; i < s->calls; ++i) {
+        uint64_t tic, toc;
+        int result;
+
+        // Lock wait is a part of the observed latency
+        tic = now_ns();
+        if (w->lock) pthread_mutex_lock(w->lock);
+        result = secure_rng_bytes(w->ctx, out, s->size, 0);
+        if (w->lock) pthread_mutex_unlock(w->lock);
+        toc = now_ns();
+
+        if (result == RNG_NEED_RESEED && s->seeder.type == SEEDER_NONE) {
+            // Without a seeder the caller reseeds by itself
+            uint8_t entropy[48] = {0};
+            if (w->lock) pthread_mutex_lock(w->lock);
+            secure_rng_reseed(w->ctx, entropy, NULL, 0);
+            if (w->lock) pthread_mutex_unlock(w->lock);
+        }
+        else if (result != RNG_SUCCESS) {
+            w->failed = 1;
+            break;
+        }
+
+        hist_record(&w->hist, toc - tic);
+    }
+
+    return NULL;
+}
+
+static int run_scenario(const struct scenario *s, struct histogram *total) {
+    static struct worker workers[MAX_THREADS];
+    static struct secure_rng_ctx contexts[MAX_THREADS];
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    int failed = 0;
+
+    seeder = s->seeder;
+    for (int i = 0; i < s->threads; ++i) {
+        // Shared mode: all threads contend on the first context
+        if (!s->shared || i == 0) {
+            ctx_init(&contexts[i], s);
+        }
+        workers[i].scenario = s;
+        workers[i].ctx = &contexts[s->shared ? 0 : i];
+        workers[i].lock = s->shared ? &lock : NULL;
+        workers[i].failed = 0;
+    }
+
+    for (int i = 0; i < s->threads; ++i) {
+        pthread_create(&workers[i].thread, NULL, worker_main, &workers[i]);
+    }
+
+    hist_reset(total);
+    for (int i = 0; i < s->threads; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        hist_merge(total, &workers[i].hist);
+        failed |= workers[i].failed;
+    }
+
+    return failed ? -1 : 0;
+}
+
+static void report(const struct scenario *s, const struct histogram *h) {
+    static const double percentiles[] = { 50, 90, 99, 99.9, 99.99 };
+
+    printf("%-22s %8llu %6zu %3d %-7s", s->seeder.name, (unsigned long long)s->interval, s->size, s->threads, s->threads == 1 ? "single" : (s->shared ? "shared" : "private"));
+    for (size_t i = 0; i < sizeof(percentiles) / sizeof(percentiles[0]); ++i) {
+        printf(" %10.2f", hist_percentile(h, percentiles[i]) / 1000.0);
+    }
+    printf(" %10.2f\n", h->max / 1000.0);
+}
+
+// Command line
+
+static int parse_seeder(const char *spec, struct seeder_model *model) {
+    double a = 0, b = 0;
+
+    memset(model, 0, sizeof(*model));
+    snprintf(model->name, sizeof(model->name), "%s", spec);
+
+    if (!strcmp(spec, "none")) {
+        model->type = SEEDER_NONE;
+    }
+    else if (!strcmp(spec, "urandom")) {
+        model->type = SEEDER_URANDOM;
+    }
+    else if (sscanf(spec, "fixed:%lf", &a) == 1) {
+        model->type = SEEDER_FIXED;
+        model->min_ns = (uint64_t)(a * 1000);
+    }
+    else if (sscanf(spec, "jitter:%lf:%lf", &a, &b) == 2 && b >= a) {
+        model->type = SEEDER_JITTER;
+        model->min_ns = (uint64_t)(a * 1000);
+        model->max_ns = (uint64_t)(b * 1000);
+    }
+    else if (sscanf(spec, "stall:%lf:%lf", &a, &b) == 2) {
+        model->type = SEEDER_STALL;
+        model->min_ns = 5000;
+        model->stall_prob = a;
+        model->stall_ns = (uint64_t)(b * 1000000);
+    }
+    else {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --seeder MODEL     none, urandom, fixed:US, jitter:MIN_US:MAX_US or stall:PROB:MS\n"
+            "                     (stall model spins 5 us and sleeps MS with PROB probability)\n"
+            "  --interval N       reseed interval in calls (default 256)\n"
+            "  --size N           request size in bytes (default 32)\n"
+            "  --threads N        thread count for multithreaded runs (default 4)\n"
+            "  --calls N          calls per thread (default 100000)\n"
+            "Without --seeder every seeder model is run.\n",
+            program);
+}
+
+int main(int argc, char **argv) {
+    static const char *default_models[] = {
+        "none", "urandom", "fixed:50", "jitter:10:200", "stall:0.01:5"
+    };
+    static struct histogram hist;
+    struct seeder_model models[8];
+    int model_count = 0;
+    uint64_t interval = 256, calls = 100000;
+    size_t size = 32;
+    int threads = 4;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--seeder") && i + 1 < argc && model_count < 8) {
+            if (parse_seeder(argv[++i], &models[model_count++]) != 0) {
+                usage(argv[0]);
+                return -1;
+            }
+        }
+        else if (!strcmp(argv[i], "--interval") && i + 1 < argc) {
+            interval = strtoull(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            size = strtoul(argv[++i], NULL, 10);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            threads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--calls") && i + 1 < argc) {
+            calls = strtoull(argv[++i], NULL, 10);
+        }
+        else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (size > MAX_SIZE || threads < 1 || threads > MAX_THREADS || calls < 1) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (model_count == 0) {
+        for (size_t i = 0; i < sizeof(default_models) / sizeof(default_models[0]); ++i) {
+            parse_seeder(default_models[i], &models[model_count++]);
+        }
+    }
+
+    urandom_fd = open("/dev/urandom", O_RDONLY);
+
+    printf("Latency in microseconds\n");
+    printf("%-22s %8s %6s %3s %-7s %10s %10s %10s %10s %10s %10s\n",
+           "seeder", "interval", "size", "thr", "mode", "p50", "p90", "p99", "p99.9", "p99.99", "max");
+
+    for (int m = 0; m < model_count; ++m) {
+        struct scenario s;
+
+        s.seeder = models[m];
+        s.interval = interval;
+        s.size = size;
+        s.calls = calls;
+
+        // Single thread, then contended shared context
+        //  and private per thread contexts
+        for (int mode = 0; mode < 3; ++mode) {
+            s.threads = mode == 0 ? 1 : threads;
+            s.shared = mode == 1;
+            if (mode > 0 && threads == 1) break;
+
+            if (run_scenario(&s, &hist) != 0) {
+                printf("secure_rng_bytes() failed\n");
+                return -1;
+            }
+            report(&s, &hist);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+#include "secure-rng.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Whole block requests, so that everything goes through the bulk path
+#define CHUNK_LENGTH    65520
+#define CHASE_STEPS     4096
+
+struct options {
+    size_t fill_bytes;       // total output per run
+    size_t working_set;      // bytes of the cache sensitive workload
+    int concurrent;          // run the workload in another thread
+    int runs;
+};
+
+static struct options options = { 256 << 20, 1 << 20, 0, 5 };
+
+uint8_t fake_entropy[48] = {0};
+
+// Pointer chasing over a random cycle, every step misses
+//  the cache unless the working set stays resident
+static size_t *chase_next;
+static size_t chase_position;
+static volatile int chase_stop;
+static uint64_t chase_steps;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int chase_init(size_t bytes) {
+    size_t count = bytes / 64;
+    size_t *order;
+
+    // One entry per cache line
+    chase_next = aligned_alloc(64, count * 64);
+    order = malloc(count * sizeof(size_t));
+    if (chase_next == NULL || order == NULL) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        order[i] = i;
+    }
+    for (size_t i = count - 1; i > 0; --i) {
+        size_t j = (size_t)rand() % (i + 1);
+        size_t t = order[i];
+        order[i] = order[j];
+        order[j] = t;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        chase_next[order[i] * 8] = order[(i + 1) % count] * 8;
+    }
+
+    free(order);
+    return 0;
+}
+
+static void chase(uint64_t steps) {
+    size_t position = chase_position;
+    while (steps--) {
+        position = chase_next[position];
+    }
+    chase_position = position;
+}
+
+static void *chase_thread(void *arg) {
+    (void)arg;
+    while (!chase_stop) {
+        chase(CHASE_STEPS);
+        __atomic_fetch_add(&chase_steps, CHASE_STEPS, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Fill the output with chunks, touching the working set between
+//  them, and report fill throughput and workload latency
+static int bench_mode(const char *name, uint8_t *output, uint64_t threshold, int fill) {
+    struct secure_rng_ctx ctx;
+    double fill_gbps[16], chase_ns[16];
+    pthread_t thread;
+
+    if (RNG_SUCCESS != secure_rng_seed(&ctx, fake_entropy, NULL, 0)) {
+        printf("secure_rng_seed() failed\n");
+        return -1;
+    }
+    secure_rng_set_nontemporal(&ctx, threshold);
+
+    for (int r = 0; r < options.runs; ++r) {
+        uint64_t fill_time = 0, chase_time = 0, steps = 0;
+        uint64_t start = now_ns();
+
+        // Warm the working set up
+        chase(options.working_set / 8);
+
+        if (options.concurrent) {
+            chase_stop = 0;
+            chase_steps = 0;
+            pthread_create(&thread, NULL, &chase_thread, NULL);
+        }
+
+        for (size_t offset = 0; offset + CHUNK_LENGTH <= options.fill_bytes; offset += CHUNK_LENGTH) {
+            uint64_t tic = now_ns();
+            if (fill && RNG_SUCCESS != secure_rng_bytes(&ctx, output + offset, CHUNK_LENGTH, 0)) {
+                printf("secure_rng_bytes() failed\n");
+                return -1;
+            }
+            uint64_t toc = now_ns();
+            fill_time += toc - tic;
+
+            if (!options.concurrent) {
+                chase(CHASE_STEPS);
+                chase_time += now_ns() - toc;
+                steps += CHASE_STEPS;
+            }
+        }
+
+        if (options.concurrent) {
+            chase_stop = 1;
+            pthread_join(thread, NULL);
+            chase_time = now_ns() - start;
+            steps = chase_steps;
+        }
+
+        fill_gbps[r] = fill ? (double)options.fill_bytes / fill_time : 0;
+        chase_ns[r] = steps ? (double)chase_time / steps : 0;
+    }
+
+    qsort(fill_gbps, options.runs, sizeof(double), compare_doubles);
+    qsort(chase_ns, options.runs, sizeof(double), compare_doubles);
+    printf("%-12s %12.3f GB/s %12.2f ns\n", name, fill_gbps[options.runs / 2], chase_ns[options.runs / 2]);
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --size MB          output per run (default %zu)\n"
+            "  --working-set KB   working set of the co-running workload (default %zu)\n"
+            "  --runs N           runs per mode, the median is reported (default %d)\n"
+            "  --concurrent       run the workload in a separate thread\n",
+            program, options.fill_bytes >> 20, options.working_set >> 10, options.runs);
+}
+
+int main(int argc, char **argv) {
+    uint8_t *output;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            options.fill_bytes = (size_t)atol(argv[++i]) << 20;
+        }
+        else if (!strcmp(argv[i], "--working-set") && i + 1 < argc) {
+            options.working_set = (size_t)atol(argv[++i]) << 10;
+        }
+        else if (!strcmp(argv[i], "--runs") && i + 1 < argc) {
+            options.runs = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--concurrent")) {
+            options.concurrent = 1;
+        }
+        else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (options.fill_bytes < CHUNK_LENGTH || options.working_set < 4096 || options.runs < 1 || options.runs > 16) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    output = aligned_alloc(4096, options.fill_bytes);
+    if (output == NULL || chase_init(options.working_set) != 0) {
+        printf("out of memory\n");
+        return -1;
+    }
+
+    // Fault the output pages in beforehand
+    memset(output, 0, options.fill_bytes);
+
+    printf("%-12s %17s %15s\n", "mode", "fill", "workload step");
+    if (bench_mode("idle", output, RNG_NO_LIMIT, 0) != 0
+            || bench_mode("cached", output, RNG_NO_LIMIT, 1) != 0
+            || bench_mode("streaming", output, 0, 1) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
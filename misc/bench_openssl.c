@@ -0,0 +1,166 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <openssl/err.h>
+#include <openssl/provider.h>
+#include <openssl/rand.h>
+
+#define MAX_THREADS     64
+#define MAX_SIZE        16384
+
+// Request sizes of openssl speed
+static const size_t sizes[] = { 16, 64, 256, 1024, 8192, 16384 };
+
+#define SIZE_COUNT      (sizeof(sizes) / sizeof(sizes[0]))
+
+struct options {
+    const char *module_dir;
+    int threads;
+    double seconds;
+};
+
+#ifndef PROVIDER_DIR
+#define PROVIDER_DIR "."
+#endif
+
+static struct options options = { PROVIDER_DIR, 1, 1.0 };
+
+struct worker {
+    pthread_t thread;
+    OSSL_LIB_CTX *libctx;
+    size_t size;
+    uint64_t calls;
+    int failed;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *worker_run(void *arg) {
+    struct worker *worker = arg;
+    unsigned char buffer[MAX_SIZE];
+    uint64_t deadline = now_ns() + (uint64_t)(options.seconds * 1e9);
+
+    // Per thread DRBGs are created by the first call
+    worker->failed = RAND_bytes_ex(worker->libctx, buffer, worker->size, 0) != 1;
+
+    while (!worker->failed && now_ns() < deadline) {
+        for (int i = 0; i < 16 && !worker->failed; ++i) {
+            worker->failed = RAND_bytes_ex(worker->libctx, buffer, worker->size, 0) != 1;
+        }
+        worker->calls += 16;
+    }
+    return NULL;
+}
+
+// Throughput in 1000s of bytes per second, like openssl speed
+static double bench_size(OSSL_LIB_CTX *libctx, size_t size) {
+    struct worker workers[MAX_THREADS];
+    uint64_t calls = 0, start, elapsed;
+    int failed = 0;
+
+    memset(workers, 0, sizeof(workers));
+    start = now_ns();
+    for (int i = 0; i < options.threads; ++i) {
+        workers[i].libctx = libctx;
+        workers[i].size = size;
+        if (pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]) != 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < options.threads; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        calls += workers[i].calls;
+        failed |= workers[i].failed;
+    }
+    elapsed = now_ns() - start;
+
+    return (failed || elapsed == 0) ? -1 : (double)calls * size * 1e6 / elapsed;
+}
+
+static int bench_provider(const char *name, OSSL_LIB_CTX *libctx) {
+    printf("%-12s", name);
+    for (size_t i = 0; i < SIZE_COUNT; ++i) {
+        double kbps = bench_size(libctx, sizes[i]);
+        if (kbps < 0) {
+            printf("\n");
+            fprintf(stderr, "RAND_bytes failed for %s\n", name);
+            ERR_print_errors_fp(stderr);
+            return -1;
+        }
+        printf(" %11.2fk", kbps);
+        fflush(stdout);
+    }
+    printf("\n");
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --module-dir DIR  directory of securerng.so (default %s)\n"
+            "  --threads N       concurrent threads (default %d)\n"
+            "  --seconds S       duration of each size (default %.1f)\n",
+            program, PROVIDER_DIR, options.threads, options.seconds);
+}
+
+int main(int argc, char **argv) {
+    OSSL_LIB_CTX *openssl, *securerng;
+    int status = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--module-dir") && i + 1 < argc) {
+            options.module_dir = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            options.seconds = atof(argv[++i]);
+        }
+        else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (options.threads < 1 || options.threads > MAX_THREADS || options.seconds <= 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    // Separate library contexts, each one with its own DRBG chain
+    openssl = OSSL_LIB_CTX_new();
+    securerng = OSSL_LIB_CTX_new();
+    if (openssl == NULL || securerng == NULL
+            || OSSL_PROVIDER_load(openssl, "default") == NULL
+            || OSSL_PROVIDER_load(securerng, "default") == NULL
+            || !OSSL_PROVIDER_set_default_search_path(securerng, options.module_dir)
+            || OSSL_PROVIDER_load(securerng, "securerng") == NULL
+            || !RAND_set_DRBG_type(securerng, "SECURE-RNG", "provider=securerng", NULL, NULL)) {
+        fprintf(stderr, "can't load the securerng provider from %s\n", options.module_dir);
+        ERR_print_errors_fp(stderr);
+        return 1;
+    }
+
+    printf("%s, %d thread(s), %.1f s per size\n", OpenSSL_version(OPENSSL_VERSION), options.threads, options.seconds);
+    printf("The 'numbers' are in 1000s of bytes per second processed.\n");
+    printf("%-12s", "type");
+    for (size_t i = 0; i < SIZE_COUNT; ++i) {
+        printf(" %6zu bytes", sizes[i]);
+    }
+    printf("\n");
+
+    status |= bench_provider("default", openssl);
+    status |= bench_provider("securerng", securerng);
+
+    OSSL_LIB_CTX_free(securerng);
+    OSSL_LIB_CTX_free(openssl);
+    return status ? 1 : 0;
+}
@@ -0,0 +1,225 @@
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/wait.h>
+
+#define MAX_THREADS     64
+
+// Typical legacy patterns of getting a small random value
+#define CASE_GETRANDOM   0
+#define CASE_GETENTROPY  1
+#define CASE_READ        2     // read from a /dev/urandom descriptor kept open
+#define CASE_OPEN_READ   3     // open, read and close /dev/urandom every time
+#define CASE_COUNT       4
+
+static const char *case_names[CASE_COUNT] = { "getrandom", "getentropy", "read", "open+read" };
+
+struct options {
+    const char *shim;
+    int threads;
+    size_t size;
+    double seconds;
+};
+
+static struct options options = { NULL, 1, 16, 0.5 };
+
+struct worker {
+    pthread_t thread;
+    int type;
+    uint64_t calls;
+    int failed;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void *worker_run(void *arg) {
+    struct worker *worker = arg;
+    uint8_t buffer[256];
+    uint64_t deadline = now_ns() + (uint64_t)(options.seconds * 1e9);
+    int fd = -1;
+
+    if (worker->type == CASE_READ) {
+        fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        worker->failed = (fd < 0);
+    }
+
+    // Clock is read once per batch so that it doesn't dominate
+    while (!worker->failed && now_ns() < deadline) {
+        for (int i = 0; i < 64 && !worker->failed; ++i) {
+            switch (worker->type) {
+                case CASE_GETRANDOM:
+                    worker->failed = getrandom(buffer, options.size, 0) != (ssize_t)options.size;
+                    break;
+                case CASE_GETENTROPY:
+                    worker->failed = getentropy(buffer, options.size) != 0;
+                    break;
+                case CASE_READ:
+                    worker->failed = read(fd, buffer, options.size) != (ssize_t)options.size;
+                    break;
+                case CASE_OPEN_READ:
+                    fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+                    worker->failed = fd < 0 || read(fd, buffer, options.size) != (ssize_t)options.size;
+                    if (fd >= 0) {
+                        close(fd);
+                    }
+                    break;
+            }
+        }
+        worker->calls += 64;
+    }
+
+    if (worker->type == CASE_READ && fd >= 0) {
+        close(fd);
+    }
+    return NULL;
+}
+
+static int bench_case(const char *label, int type) {
+    struct worker workers[MAX_THREADS];
+    uint64_t calls = 0;
+    int failed = 0;
+
+    memset(workers, 0, sizeof(workers));
+    uint64_t start = now_ns();
+    for (int i = 0; i < options.threads; ++i) {
+        workers[i].type = type;
+        if (pthread_create(&workers[i].thread, NULL, worker_run, &workers[i]) != 0) {
+            return -1;
+        }
+    }
+    for (int i = 0; i < options.threads; ++i) {
+        pthread_join(workers[i].thread, NULL);
+        calls += workers[i].calls;
+        failed |= workers[i].failed;
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    if (failed || calls == 0) {
+        fprintf(stderr, "%s %s failed\n", label, case_names[type]);
+        return -1;
+    }
+
+    printf("%-10s %-12s %6zu %8d %10.1f ns %12.0f calls/s\n", label, case_names[type], options.size, options.threads,
+           (double)elapsed * options.threads / calls, calls * 1e9 / elapsed);
+    return 0;
+}
+
+static int bench_all(const char *label) {
+    int status = 0;
+
+    for (int type = 0; type < CASE_COUNT; ++type) {
+        status |= bench_case(label, type);
+    }
+    fflush(stdout);
+    return status;
+}
+
+// Same binary, once as is and once with the shim preloaded
+static int bench_variant(char **argv, const char *label, const char *preload) {
+    pid_t pid;
+    int status;
+
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+        return -1;
+    }
+    if (pid == 0) {
+        char *args[] = { argv[0], "--label", (char *)label, NULL };
+        char threads[16], size[32], seconds[32];
+
+        if (preload) {
+            setenv("LD_PRELOAD", preload, 1);
+        }
+        else {
+            unsetenv("LD_PRELOAD");
+        }
+        snprintf(threads, sizeof(threads), "%d", options.threads);
+        snprintf(size, sizeof(size), "%zu", options.size);
+        snprintf(seconds, sizeof(seconds), "%f", options.seconds);
+        setenv("BENCH_PRELOAD_THREADS", threads, 1);
+        setenv("BENCH_PRELOAD_SIZE", size, 1);
+        setenv("BENCH_PRELOAD_SECONDS", seconds, 1);
+
+        execv("/proc/self/exe", args);
+        _exit(127);
+    }
+
+    if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --shim PATH      secure-rng-preload library to compare against\n"
+            "  --threads N      concurrent threads (default %d)\n"
+            "  --size BYTES     bytes per call, up to 256 (default %zu)\n"
+            "  --seconds S      duration of each case (default %.1f)\n"
+            "Without --shim the cases run once in this process, so that\n"
+            "  the benchmark may also be started with LD_PRELOAD set.\n",
+            program, options.threads, options.size, options.seconds);
+}
+
+int main(int argc, char **argv) {
+    const char *label = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--shim") && i + 1 < argc) {
+            options.shim = argv[++i];
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--size") && i + 1 < argc) {
+            options.size = (size_t)atol(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--seconds") && i + 1 < argc) {
+            options.seconds = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--label") && i + 1 < argc) {
+            // Internal, options of the parent come through the environment
+            label = argv[++i];
+            options.threads = atoi(getenv("BENCH_PRELOAD_THREADS"));
+            options.size = (size_t)atol(getenv("BENCH_PRELOAD_SIZE"));
+            options.seconds = atof(getenv("BENCH_PRELOAD_SECONDS"));
+        }
+        else {
+            usage(argv[0]);
+            return -1;
+        }
+    }
+
+    if (options.threads < 1 || options.threads > MAX_THREADS || options.size < 1 || options.size > 256 || options.seconds <= 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (label) {
+        return bench_all(label) ? 1 : 0;
+    }
+
+    printf("%-10s %-12s %6s %8s %13s %18s\n", "variant", "call", "size", "threads", "latency", "rate");
+    if (options.shim == NULL) {
+        return bench_all(getenv("LD_PRELOAD") ? "preload" : "kernel") ? 1 : 0;
+    }
+
+    if (bench_variant(argv, "kernel", NULL) != 0 || bench_variant(argv, "preload", options.shim) != 0) {
+        fprintf(stderr, "benchmark failed\n");
+        return 1;
+    }
+    return 0;
+}
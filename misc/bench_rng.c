@@ -1,70 +1,596 @@
 #include "secure-rng.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
 
-uint8_t fake_entropy1[48] = {0};
-uint8_t fake_entropy2[48] = {1};
-uint8_t fake_personalization[48] = {0};
+#ifdef __linux
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
 
-uint8_t fake_key[32];
-uint8_t fake_seed[64];
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#endif
 
-int main() {
-    struct secure_rng_ctx ctx;
-    
-    unsigned i;
-    clock_t tic;
-    clock_t toc;
-    double elapsed;
-    
-    const unsigned num_keys = 1000000;
-    const unsigned num_seeds = 1000000;
-
-    if (RNG_SUCCESS != secure_rng_seed(&ctx, fake_entropy1, fake_personalization, sizeof(fake_personalization))) {
-        printf("secure_rng_seed() failed\n");
-        return -1;
+#define MAX_REPS      64
+#define MAX_THREADS   64
+#define MAX_BUFFER    (1 << 20)
+
+// Largest block aligned request accepted by secure_rng_bytes
+#define CHUNK_LENGTH  (MAX_GENERATE_LENGTH & ~15)
+
+struct bench_options {
+    int reps;
+    double min_time;
+    int max_threads;
+    int perf;
+    int json;
+    const char *backend;
+};
+
+struct bench_backend {
+    const char *name;
+    int id;
+};
+
+struct bench_stats {
+    double median;
+    double mean;
+    double stddev;
+    double min;
+    double max;
+};
+
+struct bench_counters {
+    double cycles;
+    double instructions;
+    const char *cycles_source;
+};
+
+static const struct bench_backend backends[] = {
+    { "software", RNG_BACKEND_SOFTWARE },
+    { "hardware", RNG_BACKEND_HARDWARE },
+    { "vaes256", RNG_BACKEND_VAES256 },
+    { "vaes512", RNG_BACKEND_VAES512 },
+};
+
+static const size_t sizes[] = {
+    1, 4, 16, 32, 48, 64, 128, 256, 1024, 4096, 16384, 65536, 262144, 1048576
+};
+
+// Masking: XOR API against generating into a scratch buffer
+static const size_t xor_sizes[] = { 64, 4096, 65536, 1048576 };
+
+static struct bench_options options = { 9, 0.2, 0, 0, 0, NULL };
+static uint8_t buffer[MAX_BUFFER] __attribute__ ((aligned (64)));
+static uint8_t scratch[MAX_BUFFER] __attribute__ ((aligned (64)));
+static int json_first = 1;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t tsc_now(void) {
+#ifdef HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// Fake seeders: constant memory source isolates DRBG cost
+static void memory_seeder(uint8_t entropy[48]) {
+    memset(entropy, 0x5a, 48);
+}
+
+static void urandom_seeder(uint8_t entropy[48]) {
+    static int fd = -1;
+    if (fd == -1) fd = open("/dev/urandom", O_RDONLY);
+    if (read(fd, entropy, 48) != 48) abort();
+}
+
+// Hardware performance counters
+
+static int perf_fds[2] = { -1, -1 };
+
+#ifdef __linux
+static int perf_open(uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+static void perf_init(void) {
+#ifdef __linux
+    perf_fds[0] = perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    perf_fds[1] = perf_open(PERF_COUNT_HW_INSTRUCTIONS);
+    if (perf_fds[0] < 0 || perf_fds[1] < 0) {
+        fprintf(stderr, "perf_event_open() failed (%s), falling back to TSC\n", strerror(errno));
+        if (perf_fds[0] >= 0) close(perf_fds[0]);
+        if (perf_fds[1] >= 0) close(perf_fds[1]);
+        perf_fds[0] = perf_fds[1] = -1;
+    }
+#else
+    fprintf(stderr, "perf counters are not supported on this platform\n");
+#endif
+}
+
+static void perf_start(void) {
+#ifdef __linux
+    for (int i = 0; i < 2 && perf_fds[0] >= 0; ++i) {
+        ioctl(perf_fds[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(perf_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+}
+
+static void perf_stop(uint64_t values[2]) {
+    values[0] = values[1] = 0;
+#ifdef __linux
+    for (int i = 0; i < 2 && perf_fds[0] >= 0; ++i) {
+        ioctl(perf_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+        if (read(perf_fds[i], &values[i], sizeof(values[i])) != sizeof(values[i])) {
+            values[i] = 0;
+        }
+    }
+#endif
+}
+
+// Statistics
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void stats_compute(double *samples, int n, struct bench_stats *stats) {
+    double sum = 0, sq = 0;
+
+    qsort(samples, n, sizeof(double), compare_doubles);
+    for (int i = 0; i < n; ++i) {
+        sum += samples[i];
+    }
+    stats->mean = sum / n;
+    for (int i = 0; i < n; ++i) {
+        sq += (samples[i] - stats->mean) * (samples[i] - stats->mean);
+    }
+    stats->stddev = n > 1 ? sqrt(sq / (n - 1)) : 0;
+    stats->median = (n & 1) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    stats->min = samples[0];
+    stats->max = samples[n - 1];
+}
+
+// Measured operations
+
+struct bench_op {
+    struct secure_rng_ctx *ctx;
+    size_t size;
+    int resistance;
+    struct secure_rng_fke_ctx *fke;
+};
+
+typedef int (*bench_fn)(struct bench_op *op);
+
+static int op_generate(struct bench_op *op) {
+    size_t offset = 0;
+
+    // Large requests are served in chunks
+    while (offset < op->size) {
+        size_t len = op->size - offset;
+        if (len > CHUNK_LENGTH) len = CHUNK_LENGTH;
+        if (RNG_SUCCESS != secure_rng_bytes(op->ctx, buffer + offset, len, op->resistance)) {
+            return -1;
+        }
+        offset += len;
     }
-    
-    printf("Computing %d random private keys...\n", num_keys);
+    return 0;
+}
 
-    // Benchmark start
-    tic = clock();
+// Fast key erasure engine takes requests of any size
+static int op_fke_generate(struct bench_op *op) {
+    return secure_rng_fke_bytes(op->fke, buffer, op->size, op->resistance) == RNG_SUCCESS ? 0 : -1;
+}
 
-    for(i = 0; i < num_keys; ++i) {
-        if (RNG_SUCCESS != secure_rng_bytes(&ctx, fake_key, sizeof(fake_key), 0)) {
-            printf("secure_rng_bytes() failed\n");
+static int op_xor(struct bench_op *op) {
+    size_t offset = 0;
+
+    while (offset < op->size) {
+        size_t len = op->size - offset;
+        if (len > CHUNK_LENGTH) len = CHUNK_LENGTH;
+        if (RNG_SUCCESS != secure_rng_xor(op->ctx, buffer + offset, len, op->resistance)) {
             return -1;
         }
+        offset += len;
     }
+    return 0;
+}
 
-    // Benchmark end
-    toc = clock();
-    elapsed = (double)(toc - tic) / CLOCKS_PER_SEC;
+static int op_generate_xor(struct bench_op *op) {
+    size_t offset = 0;
 
-    printf("Elapsed: %f seconds (%f keys/s)\n", elapsed, num_keys / elapsed);
+    while (offset < op->size) {
+        size_t len = op->size - offset;
+        if (len > CHUNK_LENGTH) len = CHUNK_LENGTH;
+        if (RNG_SUCCESS != secure_rng_bytes(op->ctx, scratch + offset, len, op->resistance)) {
+            return -1;
+        }
+        offset += len;
+    }
+    // Sizes are multiples of 8
+    for (size_t i = 0; i < op->size; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, buffer + i, 8);
+        memcpy(&b, scratch + i, 8);
+        a ^= b;
+        memcpy(buffer + i, &a, 8);
+    }
+    return 0;
+}
 
-    if (RNG_SUCCESS != secure_rng_reseed(&ctx, fake_entropy2, NULL, 0)) {
-        printf("secure_rng_seed() failed\n");
-        return -1;
+static int op_seed(struct bench_op *op) {
+    return secure_rng_seed(op->ctx, buffer, NULL, 0);
+}
+
+static int op_reseed(struct bench_op *op) {
+    return secure_rng_reseed(op->ctx, buffer, NULL, 0);
+}
+
+static int run_batch(bench_fn fn, struct bench_op *op, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; ++i) {
+        if (fn(op) != 0) {
+            fprintf(stderr, "benchmark operation failed\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Calibrate batch size during warmup, then time repetitions
+static int measure(bench_fn fn, struct bench_op *op, struct bench_stats *stats, struct bench_counters *counters, uint64_t *batch) {
+    double samples[MAX_REPS];
+    double min_batch = options.min_time / options.reps * 1e9;
+    uint64_t iterations = 1;
+    uint64_t tic, toc, tsc_total = 0, perf_total[2] = {0, 0};
+
+    // Warmup doubles the batch until it runs long enough
+    for (;;) {
+        tic = now_ns();
+        if (run_batch(fn, op, iterations) != 0) return -1;
+        toc = now_ns();
+        if (toc - tic >= min_batch || iterations >= (UINT64_C(1) << 32)) break;
+        iterations *= 2;
+    }
+
+    for (int r = 0; r < options.reps; ++r) {
+        uint64_t values[2];
+        uint64_t tsc_tic;
+
+        perf_start();
+        tsc_tic = tsc_now();
+        tic = now_ns();
+        if (run_batch(fn, op, iterations) != 0) return -1;
+        toc = now_ns();
+        tsc_total += tsc_now() - tsc_tic;
+        perf_stop(values);
+        perf_total[0] += values[0];
+        perf_total[1] += values[1];
+
+        samples[r] = (double)(toc - tic) / iterations;
+    }
+
+    stats_compute(samples, options.reps, stats);
+    *batch = iterations;
+
+    // Counters are averaged per call
+    counters->cycles = 0;
+    counters->instructions = 0;
+    counters->cycles_source = NULL;
+    if (perf_fds[0] >= 0) {
+        counters->cycles = (double)perf_total[0] / iterations / options.reps;
+        counters->instructions = (double)perf_total[1] / iterations / options.reps;
+        counters->cycles_source = "perf";
+    }
+    else if (tsc_total) {
+        counters->cycles = (double)tsc_total / iterations / options.reps;
+        counters->cycles_source = "tsc";
+    }
+
+    return 0;
+}
+
+// Reporting
+
+static void json_begin(const char *name, const char *backend) {
+    printf("%s\n    {\"name\": \"%s\", \"backend\": \"%s\"", json_first ? "" : ",", name, backend);
+    json_first = 0;
+}
+
+static void report(const char *name, const char *backend, size_t size, const struct bench_stats *stats, const struct bench_counters *counters, uint64_t batch) {
+    double gbps = size ? size / stats->median : 0;
+
+    if (options.json) {
+        json_begin(name, backend);
+        printf(", \"size\": %zu, \"reps\": %d, \"batch\": %llu", size, options.reps, (unsigned long long)batch);
+        printf(", \"ns_per_call\": {\"median\": %.2f, \"mean\": %.2f, \"stddev\": %.2f, \"min\": %.2f, \"max\": %.2f}",
+               stats->median, stats->mean, stats->stddev, stats->min, stats->max);
+        if (size) {
+            printf(", \"gb_per_s\": %.4f", gbps);
+        }
+        if (counters->cycles_source) {
+            printf(", \"cycles_source\": \"%s\", \"cycles_per_call\": %.1f", counters->cycles_source, counters->cycles);
+            if (size) printf(", \"cycles_per_byte\": %.3f", counters->cycles / size);
+        }
+        if (counters->instructions) {
+            printf(", \"instructions_per_call\": %.1f", counters->instructions);
+        }
+        printf("}");
+        return;
+    }
+
+    printf("%-16s %-10s %8zu %12.1f ns %8.1f%%", name, backend, size, stats->median, stats->mean ? 100 * stats->stddev / stats->mean : 0);
+    if (size) {
+        printf(" %8.3f GB/s", gbps);
+        if (counters->cycles_source) printf(" %9.3f c/B", counters->cycles / size);
+    }
+    else if (counters->cycles_source) {
+        printf(" %12.0f cycles", counters->cycles);
+    }
+    printf("\n");
+}
+
+// Multithreaded scaling
+
+struct thread_arg {
+    int backend;
+    volatile int *stop;
+    uint64_t bytes;
+};
+
+static void *thread_main(void *arg) {
+    struct thread_arg *t = (struct thread_arg *)arg;
+    struct secure_rng_ctx ctx;
+    uint8_t local[4096];
+
+    memset(local, 0, sizeof(local));
+    secure_rng_seed(&ctx, local, NULL, 0);
+    secure_rng_set_backend(&ctx, t->backend);
+
+    while (!*t->stop) {
+        if (RNG_SUCCESS != secure_rng_bytes(&ctx, local, sizeof(local), 0)) break;
+        t->bytes += sizeof(local);
+    }
+
+    return NULL;
+}
+
+static void bench_threads(const struct bench_backend *backend) {
+    pthread_t threads[MAX_THREADS];
+    struct thread_arg args[MAX_THREADS];
+    double single = 0;
+    int max_threads = options.max_threads;
+
+    if (max_threads <= 0) {
+        max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (max_threads > MAX_THREADS) max_threads = MAX_THREADS;
+
+    for (int n = 1; n <= max_threads; n = (n * 2 > max_threads && n != max_threads) ? max_threads : n * 2) {
+        volatile int stop = 0;
+        uint64_t tic, toc, total = 0;
+        double gbps;
+
+        for (int i = 0; i < n; ++i) {
+            args[i].backend = backend->id;
+            args[i].stop = &stop;
+            args[i].bytes = 0;
+        }
+
+        tic = now_ns();
+        for (int i = 0; i < n; ++i) {
+            pthread_create(&threads[i], NULL, thread_main, &args[i]);
+        }
+        usleep((useconds_t)(options.min_time * 1e6));
+        stop = 1;
+        for (int i = 0; i < n; ++i) {
+            pthread_join(threads[i], NULL);
+            total += args[i].bytes;
+        }
+        toc = now_ns();
+
+        gbps = (double)total / (toc - tic);
+        if (n == 1) single = gbps;
+
+        if (options.json) {
+            json_begin("threads", backend->name);
+            printf(", \"threads\": %d, \"gb_per_s\": %.4f, \"efficiency\": %.3f}", n, gbps, single ? gbps / single / n : 0);
+        }
+        else {
+            printf("%-16s %-10s %8d %15.3f GB/s %8.1f%%\n", "threads", backend->name, n, gbps, single ? 100 * gbps / single / n : 0);
+        }
+    }
+}
+
+// Benchmark suite
+
+static void bench_backend(const struct bench_backend *backend) {
+    static struct secure_rng_fke_ctx fke;
+    struct secure_rng_ctx ctx;
+    struct bench_op op = { &ctx, 0, 0, &fke };
+    struct bench_stats stats;
+    struct bench_counters counters;
+    uint64_t batch;
+
+    secure_rng_seed(&ctx, buffer, NULL, 0);
+    if (RNG_SUCCESS != secure_rng_set_backend(&ctx, backend->id)) {
+        fprintf(stderr, "%s backend is not supported, skipping\n", backend->name);
+        return;
+    }
+
+    // Request size sweep
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        op.size = sizes[i];
+        if (measure(op_generate, &op, &stats, &counters, &batch) == 0) {
+            report("generate", backend->name, op.size, &stats, &counters, batch);
+        }
     }
 
-    printf("Computing %d random private seeds...\n", num_seeds);
+    // Same sweep on the fast key erasure engine
+    secure_rng_fke_seed(&fke, buffer, NULL, 0);
+    secure_rng_set_backend(&fke.drbg, backend->id);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+        op.size = sizes[i];
+        if (measure(op_fke_generate, &op, &stats, &counters, &batch) == 0) {
+            report("fke_generate", backend->name, op.size, &stats, &counters, batch);
+        }
+    }
+
+    for (size_t i = 0; i < sizeof(xor_sizes) / sizeof(xor_sizes[0]); ++i) {
+        op.size = xor_sizes[i];
+        if (measure(op_xor, &op, &stats, &counters, &batch) == 0) {
+            report("xor", backend->name, op.size, &stats, &counters, batch);
+        }
+        if (measure(op_generate_xor, &op, &stats, &counters, &batch) == 0) {
+            report("generate_xor", backend->name, op.size, &stats, &counters, batch);
+        }
+    }
 
-    // Benchmark start
-    tic = clock();
+    // Seeding always runs on the automatically chosen
+    //  backend, so restore the benchmarked one afterwards
+    if (measure(op_seed, &op, &stats, &counters, &batch) == 0) {
+        report("seed", backend->name, 0, &stats, &counters, batch);
+    }
+    secure_rng_set_backend(&ctx, backend->id);
+    if (measure(op_reseed, &op, &stats, &counters, &batch) == 0) {
+        report("reseed", backend->name, 0, &stats, &counters, batch);
+    }
+
+    // Prediction resistance: seeder invoked on every call
+    op.size = 32;
+    op.resistance = 0;
+    secure_rng_set_seeder(&ctx, &memory_seeder, 0);
+    if (measure(op_generate, &op, &stats, &counters, &batch) == 0) {
+        report("pr_memory", backend->name, op.size, &stats, &counters, batch);
+    }
+    secure_rng_set_seeder(&ctx, &urandom_seeder, 0);
+    if (measure(op_generate, &op, &stats, &counters, &batch) == 0) {
+        report("pr_urandom", backend->name, op.size, &stats, &counters, batch);
+    }
+    secure_rng_set_seeder(&ctx, NULL, 0);
 
-    for(i = 0; i < num_seeds; ++i) {
-        if (RNG_SUCCESS != secure_rng_bytes(&ctx, fake_seed, sizeof(fake_seed), 0)) {
-            printf("secure_rng_bytes() failed\n");
+    bench_threads(backend);
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --json           emit JSON records\n"
+            "  --reps N         repetitions per measurement (default %d)\n"
+            "  --time SECONDS   minimum measured time per case (default %.2f)\n"
+            "  --threads N      maximum threads for the scaling test (default: CPU count)\n"
+            "  --backend NAME   only run the named backend (software, hardware, vaes256, vaes512, auto, tuned)\n"
+            "  --perf           read cycles and instructions from perf_event counters\n",
+            program, options.reps, options.min_time);
+}
+
+int main(int argc, char **argv) {
+    static const struct bench_backend automatic = { "auto", RNG_BACKEND_AUTO };
+    static const struct bench_backend tuned = { "tuned", RNG_BACKEND_TUNED };
+    int found = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--json")) {
+            options.json = 1;
+        }
+        else if (!strcmp(argv[i], "--perf")) {
+            options.perf = 1;
+        }
+        else if (!strcmp(argv[i], "--reps") && i + 1 < argc) {
+            options.reps = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--time") && i + 1 < argc) {
+            options.min_time = atof(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+            options.max_threads = atoi(argv[++i]);
+        }
+        else if (!strcmp(argv[i], "--backend") && i + 1 < argc) {
+            options.backend = argv[++i];
+        }
+        else {
+            usage(argv[0]);
             return -1;
         }
     }
 
-    // Benchmark end
-    toc = clock();
-    elapsed = (double)(toc - tic) / CLOCKS_PER_SEC;
+    if (options.reps < 1 || options.reps > MAX_REPS || options.min_time <= 0) {
+        usage(argv[0]);
+        return -1;
+    }
+
+    if (options.perf) {
+        perf_init();
+    }
+
+    if (options.json) {
+        printf("{\"benchmark\": \"secure-rng\", \"reps\": %d, \"min_time\": %.3f, \"results\": [", options.reps, options.min_time);
+    }
+    else {
+        printf("%-16s %-10s %8s %15s %9s %13s\n", "case", "backend", "size", "median", "stddev", "throughput");
+    }
+
+    if (options.backend && !strcmp(options.backend, automatic.name)) {
+        bench_backend(&automatic);
+        found = 1;
+    }
+    if (options.backend && !strcmp(options.backend, tuned.name)) {
+        struct secure_rng_plan plan;
+
+        // Tuning takes a few milliseconds, so it isn't timed
+        if (RNG_SUCCESS == secure_rng_autotune(NULL) && RNG_SUCCESS == secure_rng_get_plan(&plan)) {
+            for (int c = 0; c < RNG_PLAN_CLASSES; ++c) {
+                fprintf(stderr, "plan: up to %u bytes - backend %d, %u MB/s\n", plan.max_bytes[c], plan.backend[c], plan.mbps[c]);
+            }
+            bench_backend(&tuned);
+        }
+        else {
+            fprintf(stderr, "autotuner is not supported\n");
+        }
+        found = 1;
+    }
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        if (!options.backend || !strcmp(options.backend, backends[i].name)) {
+            bench_backend(&backends[i]);
+            found = 1;
+        }
+    }
+
+    if (options.json) {
+        printf("\n]}\n");
+    }
 
-    printf("Elapsed: %f seconds (%f seeds/s)\n", elapsed, num_seeds / elapsed);
+    if (!found) {
+        fprintf(stderr, "unknown backend %s\n", options.backend);
+        return -1;
+    }
 
+    return 0;
 }
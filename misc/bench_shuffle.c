@@ -0,0 +1,148 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+struct record {
+    uint8_t payload[64];
+};
+
+static struct secure_rng_ctx ctx;
+static uint64_t xorshift_state = 0x9e3779b97f4a7c15;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t xorshift(void) {
+    xorshift_state ^= xorshift_state << 13;
+    xorshift_state ^= xorshift_state >> 7;
+    xorshift_state ^= xorshift_state << 17;
+    return xorshift_state;
+}
+
+static void swap(void *a, void *b, size_t size) {
+    uint8_t tmp[sizeof(struct record)];
+    memcpy(tmp, a, size);
+    memcpy(a, b, size);
+    memcpy(b, tmp, size);
+}
+
+// What callers write without the API: one library call per element
+static void shuffle_naive(uint8_t *base, size_t n, size_t size) {
+    for (size_t i = n - 1; i > 0; --i) {
+        uint64_t x;
+        secure_rng_bytes(&ctx, (uint8_t *)&x, sizeof(x), 0);
+        size_t j = x % (i + 1);
+        swap(base + i * size, base + j * size, size);
+    }
+}
+
+// Non-cryptographic generator, the memory access floor
+static void shuffle_xorshift(uint8_t *base, size_t n, size_t size) {
+    for (size_t i = n - 1; i > 0; --i) {
+        size_t j = (size_t)(((__uint128_t)xorshift() * (i + 1)) >> 64);
+        swap(base + i * size, base + j * size, size);
+    }
+}
+
+static void shuffle_api(uint8_t *base, size_t n, size_t size) {
+    if (secure_rng_shuffle(&ctx, base, n, size) != RNG_SUCCESS) {
+        fprintf(stderr, "secure_rng_shuffle failed\n");
+        exit(1);
+    }
+}
+
+// Every index must appear exactly once afterwards
+static int check_permutation(const uint8_t *base, size_t n, size_t size) {
+    uint8_t *seen = calloc(n, 1);
+    int valid = (seen != NULL);
+
+    for (size_t i = 0; i < n && valid; ++i) {
+        uint32_t value;
+        memcpy(&value, base + i * size, sizeof(value));
+        valid = value < n && !seen[value];
+        if (valid) seen[value] = 1;
+    }
+
+    free(seen);
+    return valid;
+}
+
+static void bench_shuffle(const char *name, void (*shuffle)(uint8_t *, size_t, size_t), size_t n, size_t size) {
+    uint8_t *base = malloc(n * size);
+    if (base == NULL) {
+        exit(1);
+    }
+
+    memset(base, 0, n * size);
+    for (size_t i = 0; i < n; ++i) {
+        uint32_t value = (uint32_t)i;
+        memcpy(base + i * size, &value, sizeof(value));
+    }
+
+    uint64_t start = now_ns();
+    shuffle(base, n, size);
+    uint64_t elapsed = now_ns() - start;
+
+    printf("%-12s %10zu %6zu %10.2f ns %10.1f ms %s\n", name, n, size, (double)elapsed / n, elapsed / 1e6,
+           check_permutation(base, n, size) ? "" : "NOT A PERMUTATION");
+    free(base);
+}
+
+static void bench_sample(size_t n, size_t k) {
+    size_t *out = malloc(k * sizeof(size_t));
+    if (out == NULL) {
+        exit(1);
+    }
+
+    uint64_t start = now_ns();
+    int result = secure_rng_sample_indices(&ctx, n, k, out);
+    uint64_t elapsed = now_ns() - start;
+
+    // Distinct and in range
+    int valid = (result == RNG_SUCCESS);
+    uint8_t *seen = calloc(n / 8 + 1, 1);
+    for (size_t i = 0; i < k && valid && seen; ++i) {
+        valid = out[i] < n && !(seen[out[i] / 8] & (1 << (out[i] % 8)));
+        seen[out[i] / 8] |= 1 << (out[i] % 8);
+    }
+    free(seen);
+
+    printf("%-12s %10zu %10zu %10.2f ns %10.1f ms %s\n", "sample", n, k, (double)elapsed / k, elapsed / 1e6, valid ? "" : "INVALID");
+    free(out);
+}
+
+int main(int argc, char **argv) {
+    uint8_t entropy[48] = {0};
+    size_t n = 10000000;
+
+    if (argc > 1) {
+        n = strtoul(argv[1], NULL, 0);
+    }
+    if (n < 2 || n > UINT32_MAX) {
+        fprintf(stderr, "Usage: %s [elements]\n", argv[0]);
+        return -1;
+    }
+
+    secure_rng_seed(&ctx, entropy, NULL, 0);
+
+    printf("%-12s %10s %6s %13s %13s\n", "shuffle", "elements", "size", "per element", "total");
+    bench_shuffle("naive", shuffle_naive, n, sizeof(uint32_t));
+    bench_shuffle("xorshift", shuffle_xorshift, n, sizeof(uint32_t));
+    bench_shuffle("secure_rng", shuffle_api, n, sizeof(uint32_t));
+    bench_shuffle("naive", shuffle_naive, n, sizeof(struct record));
+    bench_shuffle("xorshift", shuffle_xorshift, n, sizeof(struct record));
+    bench_shuffle("secure_rng", shuffle_api, n, sizeof(struct record));
+
+    printf("\n%-12s %10s %10s %13s %13s\n", "sample", "n", "k", "per index", "total");
+    bench_sample((size_t)1 << 40, 1000);
+    bench_sample(n, n / 10);
+    bench_sample(n, n);
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define REQUEST_LENGTH 65520
+
+static const size_t tiles[] = { 1024, 4096, 8192, 16384, 32768 };
+
+#define TILE_COUNT (sizeof(tiles) / sizeof(tiles[0]))
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void seed(struct secure_rng_ctx *ctx) {
+    uint8_t entropy[48] = {0};
+    secure_rng_seed(ctx, entropy, NULL, 0);
+}
+
+static void fixed_seeder(uint8_t seed_out[48]) {
+    for (int i = 0; i < 48; ++i) {
+        seed_out[i] = (uint8_t)(i * 7 + 1);
+    }
+}
+
+// What the data is consumed by, e.g. a checksum before it's sent.
+//  Kept light so that generation and memory traffic dominate.
+static uint64_t checksum(uint64_t sum, const uint8_t *data, size_t len) {
+    uint64_t lanes[4] = { 0 };
+    size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t word;
+            memcpy(&word, data + i + 8 * k, 8);
+            lanes[k] += word;
+        }
+    }
+    for (; i + 8 <= len; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        lanes[0] += word;
+    }
+    return sum + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+static int consume_checksum(const uint8_t *tile, size_t len, void *userdata) {
+    uint64_t *sum = userdata;
+    *sum = checksum(*sum, tile, len);
+    return 0;
+}
+
+struct collect {
+    uint8_t *out;
+    size_t length;
+    size_t limit;
+};
+
+static int consume_collect(const uint8_t *tile, size_t len, void *userdata) {
+    struct collect *collect = userdata;
+    memcpy(collect->out + collect->length, tile, len);
+    collect->length += len;
+    return collect->length >= collect->limit;
+}
+
+// Stream output must match secure_rng_bytes invocations of request size,
+//  including reseeds on the same boundaries. A stopped stream updates
+//  the state in the middle of its last request, so only the output
+//  up to there is compared.
+static int verify(size_t tile, uint64_t total, uint64_t max_bytes, uint64_t stop_after) {
+    struct secure_rng_ctx a, b;
+    struct secure_rng_policy policy = { RNG_NO_LIMIT, max_bytes, RNG_NO_LIMIT };
+    size_t request = (REQUEST_LENGTH / tile) * tile;
+    struct collect collect = { malloc(total), 0, stop_after };
+    uint8_t *expected = malloc(total);
+    uint8_t after_a[64], after_b[64];
+    int ok;
+
+    seed(&a);
+    seed(&b);
+    secure_rng_set_seeder(&a, fixed_seeder, 0);
+    secure_rng_set_seeder(&b, fixed_seeder, 0);
+    secure_rng_set_policy(&a, &policy);
+    secure_rng_set_policy(&b, &policy);
+
+    secure_rng_stream(&a, total, tile, consume_collect, &collect);
+
+    for (uint64_t done = 0; done < total; done += request) {
+        size_t len = (total - done < request) ? (size_t)(total - done) : request;
+        secure_rng_bytes(&b, expected + done, len, 0);
+    }
+
+    secure_rng_bytes(&a, after_a, sizeof(after_a), 0);
+    secure_rng_bytes(&b, after_b, sizeof(after_b), 0);
+    ok = !memcmp(collect.out, expected, collect.length) &&
+         (collect.length < total || !memcmp(after_a, after_b, sizeof(after_a)));
+
+    free(collect.out);
+    free(expected);
+    return ok;
+}
+
+static void report(const char *name, size_t tile, uint64_t total, uint64_t elapsed, uint64_t sum) {
+    printf("%-10s %6zu %10.3f GB/s  %016llx\n", name, tile, total / (double)elapsed, (unsigned long long)sum);
+}
+
+int main(int argc, char **argv) {
+    struct secure_rng_ctx ctx;
+    uint64_t total = 256 << 20;
+    uint64_t sum, start;
+    int failed = 0;
+
+    if (argc > 1) {
+        total = strtoull(argv[1], NULL, 0);
+    }
+
+    for (size_t t = 0; t < TILE_COUNT; ++t) {
+        failed |= !verify(tiles[t], 1000003, RNG_NO_LIMIT, SIZE_MAX);
+        failed |= !verify(tiles[t], 1000003, 200000, SIZE_MAX);
+        failed |= !verify(tiles[t], 1000003, RNG_NO_LIMIT, 100000) || !verify(tiles[t], 1000003, 200000, 300000);
+    }
+    printf("stream output %s secure_rng_bytes\n", failed ? "DIFFERS FROM" : "matches");
+
+    uint8_t *buffer = malloc(total);
+    if (buffer == NULL) {
+        return 1;
+    }
+
+    // Generate everything, then consume it
+    seed(&ctx);
+    start = now_ns();
+    for (uint64_t done = 0; done < total; done += REQUEST_LENGTH) {
+        size_t len = (total - done < REQUEST_LENGTH) ? (size_t)(total - done) : REQUEST_LENGTH;
+        secure_rng_bytes(&ctx, buffer + done, len, 0);
+    }
+    sum = checksum(0, buffer, total);
+    report("buffer", 0, total, now_ns() - start, sum);
+
+    // Consume each request from a reused buffer
+    seed(&ctx);
+    start = now_ns();
+    sum = 0;
+    for (uint64_t done = 0; done < total; done += REQUEST_LENGTH) {
+        size_t len = (total - done < REQUEST_LENGTH) ? (size_t)(total - done) : REQUEST_LENGTH;
+        secure_rng_bytes(&ctx, buffer, len, 0);
+        sum = checksum(sum, buffer, len);
+    }
+    report("requests", REQUEST_LENGTH, total, now_ns() - start, sum);
+
+    for (size_t t = 0; t < TILE_COUNT; ++t) {
+        seed(&ctx);
+        start = now_ns();
+        sum = 0;
+        secure_rng_stream(&ctx, total, tiles[t], consume_checksum, &sum);
+        report("stream", tiles[t], total, now_ns() - start, sum);
+    }
+
+    free(buffer);
+    return failed;
+}
@@ -0,0 +1,159 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TOKENS      200000
+#define MAX_LEN     64
+
+static struct secure_rng_ctx ctx;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// What callers write without the API: a library call per token,
+//  then a separate encoding pass with a rejection loop if needed
+static void token_naive(const char *alphabet, char *out, size_t len) {
+    size_t size = strlen(alphabet), limit = 256 - 256 % size;
+    uint8_t bytes[MAX_LEN];
+
+    for (size_t done = 0; done < len; ) {
+        secure_rng_bytes(&ctx, bytes, len - done, 0);
+        for (size_t i = 0; done < len && i < len; ++i) {
+            if (bytes[i] < limit) {
+                out[done++] = alphabet[bytes[i] % size];
+            }
+        }
+    }
+    out[len] = '\0';
+}
+
+static void uuid_naive(char *out) {
+    uint8_t b[16];
+    secure_rng_bytes(&ctx, b, sizeof(b), 0);
+    b[6] = (b[6] & 0x0f) | 0x40;
+    b[8] = (b[8] & 0x3f) | 0x80;
+    snprintf(out, RNG_UUID_STRLEN, "%02x%02x%02x%02x-%02x%02x-%02x%02x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+             b[0], b[1], b[2], b[3], b[4], b[5], b[6], b[7], b[8], b[9], b[10], b[11], b[12], b[13], b[14], b[15]);
+}
+
+// Only alphabet characters, each one about equally often
+static int check_tokens(const char *alphabet, const char *tokens, size_t len, size_t count) {
+    size_t size = strlen(alphabet), histogram[256] = {0};
+    size_t total = len * count, expected;
+
+    for (size_t i = 0; i < count; ++i) {
+        const char *token = tokens + i * (len + 1);
+        if (token[len] != '\0') {
+            return 0;
+        }
+        for (size_t j = 0; j < len; ++j) {
+            if (strchr(alphabet, token[j]) == NULL || token[j] == '\0') {
+                return 0;
+            }
+            histogram[(uint8_t)token[j]]++;
+        }
+    }
+
+    expected = total / size;
+    for (size_t i = 0; i < size; ++i) {
+        size_t seen = histogram[(uint8_t)alphabet[i]];
+        if (seen < expected * 95 / 100 || seen > expected * 105 / 100) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void bench_token(const char *name, const char *alphabet, size_t len) {
+    char *tokens = malloc(TOKENS * (len + 1));
+    uint64_t start, naive_ns, api_ns;
+
+    if (tokens == NULL) {
+        exit(1);
+    }
+
+    start = now_ns();
+    for (size_t i = 0; i < TOKENS; ++i) {
+        token_naive(alphabet, tokens + i * (len + 1), len);
+    }
+    naive_ns = now_ns() - start;
+
+    start = now_ns();
+    for (size_t i = 0; i < TOKENS; ++i) {
+        if (secure_rng_token(&ctx, alphabet, tokens + i * (len + 1), len) != RNG_SUCCESS) {
+            fprintf(stderr, "secure_rng_token failed\n");
+            exit(1);
+        }
+    }
+    api_ns = now_ns() - start;
+
+    printf("%-10s %4zu %10.1f ns %10.1f ns %s\n", name, len, (double)naive_ns / TOKENS, (double)api_ns / TOKENS,
+           check_tokens(alphabet, tokens, len, TOKENS) ? "" : "INVALID");
+    free(tokens);
+}
+
+static int check_uuids(const char *uuids, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        const char *u = uuids + i * RNG_UUID_STRLEN;
+        for (int j = 0; j < 36; ++j) {
+            int dash = (j == 8 || j == 13 || j == 18 || j == 23);
+            if (dash ? u[j] != '-' : strchr(RNG_ALPHABET_HEX, u[j]) == NULL) {
+                return 0;
+            }
+        }
+        if (u[36] != '\0' || u[14] != '4' || strchr("89ab", u[19]) == NULL) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void bench_uuid(size_t batch) {
+    char *uuids = malloc(TOKENS * RNG_UUID_STRLEN);
+    uint64_t start, naive_ns, api_ns;
+
+    if (uuids == NULL) {
+        exit(1);
+    }
+
+    start = now_ns();
+    for (size_t i = 0; i < TOKENS; ++i) {
+        uuid_naive(uuids + i * RNG_UUID_STRLEN);
+    }
+    naive_ns = now_ns() - start;
+
+    start = now_ns();
+    for (size_t i = 0; i < TOKENS; i += batch) {
+        secure_rng_uuid4_batch(&ctx, uuids + i * RNG_UUID_STRLEN, batch);
+    }
+    api_ns = now_ns() - start;
+
+    printf("%-10s %4zu %10.1f ns %10.1f ns %s\n", "uuid4", batch, (double)naive_ns / TOKENS, (double)api_ns / TOKENS,
+           check_uuids(uuids, TOKENS) ? "" : "INVALID");
+    free(uuids);
+}
+
+int main(void) {
+    uint8_t entropy[48] = {0};
+    secure_rng_seed(&ctx, entropy, NULL, 0);
+
+    printf("%-10s %4s %13s %13s\n", "alphabet", "len", "naive", "secure_rng");
+    bench_token("hex", RNG_ALPHABET_HEX, 32);
+    bench_token("hex", RNG_ALPHABET_HEX, 64);
+    bench_token("base64url", RNG_ALPHABET_BASE64URL, 22);
+    bench_token("base64url", RNG_ALPHABET_BASE64URL, 43);
+    bench_token("base62", RNG_ALPHABET_BASE62, 22);
+    bench_token("base62", RNG_ALPHABET_BASE62, 43);
+    bench_token("digits", "0123456789", 20);
+
+    printf("\n%-10s %4s %13s %13s\n", "format", "batch", "naive", "secure_rng");
+    bench_uuid(1);
+    bench_uuid(100);
+    return 0;
+}
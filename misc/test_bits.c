@@ -0,0 +1,244 @@
+#include "secure-rng.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define RESERVOIR_BYTES (RNG_BIT_WORDS * 8)
+#define DRAWS           200000
+
+uint8_t fake_entropy1[48] = {0};
+uint8_t fake_entropy2[48] = {1};
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static void fixed_seeder(uint8_t seed_out[48]) {
+    memset(seed_out, 0x5a, 48);
+}
+
+static void seed(struct secure_rng_ctx *ctx) {
+    secure_rng_seed(ctx, fake_entropy1, NULL, 0);
+}
+
+// Bit i of a reservoir refill, words are taken in native
+//  byte order and bits from the top
+static int keystream_bit(const uint8_t *keystream, size_t i) {
+    uint64_t word;
+    memcpy(&word, keystream + 8 * (i / 64), 8);
+    return (int)((word >> (63 - i % 64)) & 1);
+}
+
+// Draws of any width read the same bit sequence
+static void test_sequence(void) {
+    static const unsigned widths[] = { 1, 5, 32, 7, 31, 1, 17, 32, 3, 29 };
+    struct secure_rng_ctx a, b;
+    uint8_t keystream[2 * RESERVOIR_BYTES];
+    size_t position = 0;
+    int bad = 0;
+
+    seed(&a);
+    seed(&b);
+    secure_rng_bytes(&b, keystream, RESERVOIR_BYTES, 0);
+    secure_rng_bytes(&b, keystream + RESERVOIR_BYTES, RESERVOIR_BYTES, 0);
+
+    // Runs into the second refill
+    while (position + 32 <= 8 * sizeof(keystream)) {
+        for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]); ++w) {
+            unsigned nbits = widths[w];
+            int64_t value = secure_rng_bits(&a, nbits);
+            int64_t expected = 0;
+
+            if (position + nbits > 8 * sizeof(keystream)) {
+                break;
+            }
+            for (unsigned i = 0; i < nbits; ++i) {
+                expected = (expected << 1) | keystream_bit(keystream, position++);
+            }
+            bad += value != expected;
+        }
+    }
+    check(bad == 0, "bits follow the keystream across words and refills");
+
+    seed(&a);
+    bad = 0;
+    for (size_t i = 0; i < 8 * RESERVOIR_BYTES; ++i) {
+        bad += secure_rng_bit(&a) != keystream_bit(keystream, i);
+    }
+    check(bad == 0, "single bits follow the keystream");
+}
+
+static void test_widths(void) {
+    struct secure_rng_ctx ctx;
+    int64_t value;
+    int bad = 0;
+
+    seed(&ctx);
+    check(secure_rng_bits(&ctx, 0) == 0, "zero bits are 0");
+
+    for (int i = 0; i < 1000; ++i) {
+        value = secure_rng_bits(&ctx, 1);
+        bad += value != 0 && value != 1;
+        value = secure_rng_bits(&ctx, 32);
+        bad += value < 0 || value > UINT32_MAX;
+    }
+    check(bad == 0, "1 and 32 bit draws in range");
+
+    check(secure_rng_bits(&ctx, 33) == RNG_BAD_MAXLEN, "33 bits rejected");
+    check(secure_rng_bits(&ctx, 64) == RNG_BAD_MAXLEN, "64 bits rejected");
+}
+
+static void test_bit_array(void) {
+    struct secure_rng_ctx ctx;
+    static uint8_t big[1 << 17];
+    uint8_t out[16];
+    size_t ones = 0;
+
+    seed(&ctx);
+
+    memset(out, 0xee, sizeof(out));
+    check(secure_rng_bit_array(&ctx, out, 0) == RNG_SUCCESS && out[0] == 0xee, "empty bit array untouched");
+
+    memset(out, 0xee, sizeof(out));
+    check(secure_rng_bit_array(&ctx, out, 1) == RNG_SUCCESS && (out[0] & 0xfe) == 0 && out[1] == 0xee, "one bit array");
+
+    memset(out, 0xee, sizeof(out));
+    check(secure_rng_bit_array(&ctx, out, 13) == RNG_SUCCESS && (out[1] & 0xe0) == 0 && out[2] == 0xee, "13 bit array cleared past the end");
+
+    memset(out, 0xee, sizeof(out));
+    check(secure_rng_bit_array(&ctx, out, 64) == RNG_SUCCESS && out[8] == 0xee, "64 bit array");
+
+    // Bulk path, past the reservoir
+    check(secure_rng_bit_array(&ctx, big, 8 * sizeof(big) - 3) == RNG_SUCCESS, "bulk bit array");
+    for (size_t i = 0; i < sizeof(big); ++i) {
+        ones += (size_t)__builtin_popcount(big[i]);
+    }
+    check(fabs((double)ones / (8 * sizeof(big)) - 0.5) < 0.005 && (big[sizeof(big) - 1] & 0xe0) == 0, "bulk bit array balanced");
+}
+
+// Reservoir bits of the old state must not be served after reseed
+static void test_reseed(void) {
+    struct secure_rng_ctx a, b;
+    uint8_t keystream[RESERVOIR_BYTES];
+    int bad = 0;
+
+    seed(&a);
+    seed(&b);
+    secure_rng_bit(&a);
+    secure_rng_bytes(&b, keystream, sizeof(keystream), 0);
+
+    secure_rng_reseed(&a, fake_entropy2, NULL, 0);
+    secure_rng_reseed(&b, fake_entropy2, NULL, 0);
+    secure_rng_bytes(&b, keystream, sizeof(keystream), 0);
+
+    for (size_t i = 0; i < 64; ++i) {
+        bad += secure_rng_bit(&a) != keystream_bit(keystream, i);
+    }
+    check(bad == 0, "reseed discards the reservoir");
+}
+
+// 64 reservoir bits, or the first error
+static int draw64(struct secure_rng_ctx *ctx, uint64_t *value) {
+    int64_t high = secure_rng_bits(ctx, 32);
+    int64_t low = (high < 0) ? high : secure_rng_bits(ctx, 32);
+
+    *value = ((uint64_t)high << 32) | (uint64_t)low;
+    return (low < 0) ? (int)low : RNG_SUCCESS;
+}
+
+// A child must neither repeat the parent's reservoir bits nor draw them
+//  without a seeder to reseed from
+static void test_fork(int with_seeder) {
+    struct secure_rng_ctx ctx;
+    struct { uint64_t value; int result; } parent, child;
+    int fds[2];
+    pid_t pid;
+
+    seed(&ctx);
+    secure_rng_enable_fork_detection(&ctx);
+    if (with_seeder) {
+        secure_rng_set_seeder(&ctx, &fixed_seeder, RNG_NO_LIMIT);
+    }
+    secure_rng_bit(&ctx);
+
+    if (pipe(fds) != 0 || (pid = fork()) < 0) {
+        check(0, "fork");
+        return;
+    }
+    if (pid == 0) {
+        child.result = draw64(&ctx, &child.value);
+        _exit(write(fds[1], &child, sizeof(child)) != sizeof(child));
+    }
+
+    parent.result = draw64(&ctx, &parent.value);
+    if (read(fds[0], &child, sizeof(child)) != sizeof(child)) {
+        child = parent;
+    }
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    check(parent.result == RNG_SUCCESS, "parent keeps drawing after fork");
+    if (with_seeder) {
+        check(child.result == RNG_SUCCESS && child.value != parent.value, "child bits differ from the parent's");
+    }
+    else {
+        check(child.result == RNG_NEED_RESEED, "child without a seeder needs reseed");
+    }
+}
+
+static void test_bernoulli(void) {
+    static const double probabilities[] = { 0.5, 0.3, 0.01, 0.999, 1.0 / 3 };
+    struct secure_rng_ctx ctx;
+    char what[64];
+
+    seed(&ctx);
+
+    for (size_t k = 0; k < sizeof(probabilities) / sizeof(probabilities[0]); ++k) {
+        double p = probabilities[k];
+        long hits = 0;
+
+        for (int i = 0; i < DRAWS; ++i) {
+            hits += secure_rng_bernoulli(&ctx, p);
+        }
+
+        // Five standard deviations
+        double tolerance = 5 * sqrt(p * (1 - p) / DRAWS);
+        snprintf(what, sizeof(what), "bernoulli(%g) frequency", p);
+        check(fabs((double)hits / DRAWS - p) <= tolerance, what);
+    }
+
+    long hits = 0;
+    for (int i = 0; i < 10000; ++i) {
+        hits += secure_rng_bernoulli(&ctx, 0) + secure_rng_bernoulli(&ctx, -1) + secure_rng_bernoulli(&ctx, NAN) +
+                secure_rng_bernoulli(&ctx, 1e-300) + secure_rng_bernoulli(&ctx, 5e-324);
+    }
+    check(hits == 0, "bernoulli of zero, negative, NaN and tiny p");
+
+    hits = 0;
+    for (int i = 0; i < 10000; ++i) {
+        hits += secure_rng_bernoulli(&ctx, 1) + secure_rng_bernoulli(&ctx, 2) + secure_rng_bernoulli(&ctx, 1 - 0x1p-53);
+    }
+    check(hits == 30000, "bernoulli of one, above one and just below one");
+}
+
+int main() {
+    test_sequence();
+    test_widths();
+    test_bit_array();
+    test_reseed();
+    test_fork(1);
+    test_fork(0);
+    test_bernoulli();
+
+    printf("%s\n", failures ? "bit tests FAILED" : "bit tests passed");
+    return failures != 0;
+}
@@ -0,0 +1,153 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_BYTES (1 << 20)
+#define WRAP_BYTES   8192
+
+uint8_t fake_seed[48] = {0};
+
+static uint8_t stream[STREAM_BYTES];
+static uint8_t slice[STREAM_BYTES];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Reproducible offsets and lengths
+static uint64_t lcg_state = 1;
+
+static uint64_t lcg_next(void) {
+    lcg_state = lcg_state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    return lcg_state >> 16;
+}
+
+static int slice_matches(const struct secure_rng_expand_ctx *ctx, uint64_t offset, size_t len) {
+    memset(slice, 0, len);
+    return secure_rng_stream_at(ctx, offset, slice, len) == RNG_SUCCESS && !memcmp(slice, stream + offset, len);
+}
+
+// Slices of the stream must match one contiguous read
+static void test_slices(const struct secure_rng_expand_ctx *ctx) {
+    static const uint64_t offsets[] = { 0, 1, 7, 15, 16, 17, 31, 500, 4095, 65536 - 3, 65536 };
+    static const size_t lengths[] = { 0, 1, 2, 15, 16, 17, 33, 496, 497, 511, 512, 513, 528, 4096, 65535, 65536, 65537, 200003 };
+    int bad = 0;
+
+    for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+        for (size_t j = 0; j < sizeof(lengths) / sizeof(lengths[0]); ++j) {
+            bad += !slice_matches(ctx, offsets[i], lengths[j]);
+        }
+    }
+    check(bad == 0, "fixed slices match the contiguous read");
+
+    // Short path ends where head and length add up to 512
+    bad = 0;
+    for (size_t skip = 0; skip < 16; ++skip) {
+        for (size_t len = 496; len <= 528; ++len) {
+            bad += !slice_matches(ctx, 4096 + skip, len);
+        }
+    }
+    check(bad == 0, "slices around the short path limit match");
+
+    bad = 0;
+    for (int i = 0; i < 2000; ++i) {
+        size_t len = (size_t)(lcg_next() % ((i & 1) ? 600 : 150000));
+        uint64_t offset = lcg_next() % (STREAM_BYTES - len + 1);
+        bad += !slice_matches(ctx, offset, len);
+    }
+    check(bad == 0, "random slices match the contiguous read");
+}
+
+// IV plus the block index, as a 128-bit big-endian number
+static void add_blocks(uint8_t iv[16], uint64_t blocks) {
+    unsigned carry = 0;
+    for (int i = 15; i >= 0; --i) {
+        unsigned sum = iv[i] + (unsigned)(blocks & 0xff) + carry;
+        iv[i] = (uint8_t)sum;
+        carry = sum >> 8;
+        blocks >>= 8;
+    }
+}
+
+// Reads across the point where the low 32 bits of the counter wrap must
+//  match single block reads, which are checked against a context whose
+//  IV is advanced to that block
+static void test_wrap(const struct secure_rng_expand_ctx *ctx, const char *name) {
+    static uint8_t reference[WRAP_BYTES + 32];
+    uint32_t low = ((uint32_t)ctx->IV[12] << 24) | ((uint32_t)ctx->IV[13] << 16) | ((uint32_t)ctx->IV[14] << 8) | ctx->IV[15];
+    uint64_t wrap_block = (uint64_t)(UINT32_MAX - low) + 1;
+    uint64_t start_block = wrap_block - WRAP_BYTES / 32;
+    char what[96];
+    int bad = 0;
+
+    for (size_t i = 0; i < sizeof(reference) / 16; ++i) {
+        bad += secure_rng_stream_at(ctx, (start_block + i) * 16, reference + 16 * i, 16) != RNG_SUCCESS;
+    }
+
+    for (uint64_t block = start_block; block < start_block + sizeof(reference) / 16; block += 61) {
+        struct secure_rng_expand_ctx moved = *ctx;
+        uint8_t expected[16];
+        add_blocks(moved.IV, block);
+        secure_rng_stream_at(&moved, 0, expected, 16);
+        bad += memcmp(expected, reference + (block - start_block) * 16, 16) != 0;
+    }
+    snprintf(what, sizeof(what), "%s single blocks match an advanced IV", name);
+    check(bad == 0, what);
+
+    // Long reads with unaligned head and tail, and a short one
+    static const size_t heads[] = { 0, 5, 15 };
+    static const size_t lengths[] = { WRAP_BYTES, WRAP_BYTES - 7, 600, 300, 33 };
+    bad = 0;
+    for (size_t i = 0; i < sizeof(heads) / sizeof(heads[0]); ++i) {
+        for (size_t j = 0; j < sizeof(lengths) / sizeof(lengths[0]); ++j) {
+            size_t from = (lengths[j] < WRAP_BYTES) ? WRAP_BYTES / 2 - lengths[j] / 2 : 0;
+            uint64_t offset = start_block * 16 + from + heads[i];
+            memset(slice, 0, lengths[j]);
+            bad += secure_rng_stream_at(ctx, offset, slice, lengths[j]) != RNG_SUCCESS;
+            bad += memcmp(slice, reference + from + heads[i], lengths[j]) != 0;
+        }
+    }
+    snprintf(what, sizeof(what), "%s reads across the counter wrap", name);
+    check(bad == 0, what);
+}
+
+int main() {
+    struct secure_rng_expand_ctx ctx, other;
+    uint8_t byte;
+
+    if (RNG_SUCCESS != secure_rng_expand_init(&ctx, fake_seed, NULL, 0)) {
+        printf("secure_rng_expand_init() failed\n");
+        return -1;
+    }
+
+    check(secure_rng_stream_at(&ctx, 0, stream, sizeof(stream)) == RNG_SUCCESS, "contiguous read");
+    test_slices(&ctx);
+
+    test_wrap(&ctx, "derived IV");
+
+    // Carry out of the low 64 bits of the counter, 256 blocks in
+    other = ctx;
+    memset(other.IV + 4, 0xff, 11);
+    other.IV[15] = 0;
+    test_wrap(&other, "all ones IV");
+
+    check(secure_rng_stream_at(&ctx, UINT64_MAX, &byte, 1) == RNG_SUCCESS, "last byte of the stream");
+    check(secure_rng_stream_at(&ctx, UINT64_MAX, slice, 2) == RNG_BAD_MAXLEN, "read past the end rejected");
+    check(secure_rng_stream_at(&ctx, 0, NULL, 0) == RNG_BAD_MAXLEN, "NULL output rejected");
+
+    secure_rng_expand_init(&other, fake_seed, (const uint8_t *)"label", 5);
+    secure_rng_stream_at(&other, 0, slice, 64);
+    check(memcmp(slice, stream, 64) != 0, "labels give different streams");
+
+    secure_rng_expand_wipe(&other);
+
+    printf("%s\n", failures ? "expand tests FAILED" : "expand tests passed");
+    return failures != 0;
+}
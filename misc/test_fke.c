@@ -0,0 +1,289 @@
+#define _GNU_SOURCE
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define FKE_DIRECT_LENGTH (MAX_GENERATE_LENGTH & ~15)
+#define PATTERN_CALLS     400
+#define OUTPUT_BYTES      (1 << 21)
+
+// Zero entropy gives an all-zero key, which would match any zeroes
+uint8_t fake_entropy1[48] = "fke test entropy, not a key of zeroes, first";
+uint8_t fake_entropy2[48] = "fke test entropy, not a key of zeroes, second";
+
+static uint8_t output[OUTPUT_BYTES];
+static uint8_t expected[OUTPUT_BYTES];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Reproducible call sizes
+static uint64_t lcg_state = 1;
+
+static uint32_t lcg_next(void) {
+    lcg_state = lcg_state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    return (uint32_t)(lcg_state >> 33);
+}
+
+// Small and large requests, around the buffer size and the direct run limit
+static size_t pattern_size(void) {
+    static const size_t sizes[] = { 0, 1, 15, 16, 17, 32, 100, 2015, 2016, 2017, 2047, 2048, 2049, 4100,
+                                    FKE_DIRECT_LENGTH, FKE_DIRECT_LENGTH + 1, FKE_DIRECT_LENGTH + 2048, 70001 };
+    uint32_t r = lcg_next();
+    return (r & 1) ? r % 300 : sizes[(r >> 1) % (sizeof(sizes) / sizeof(sizes[0]))];
+}
+
+// The engine as described: AES-CTR keystream of the drbg state, with
+//  the first 32 bytes of each buffer and of each direct run's next
+//  two blocks taking the place of the key
+struct model {
+    uint8_t Key[32];
+    uint8_t V[16];
+    uint8_t buffer[RNG_FKE_BUFFER];
+    size_t position;
+};
+
+static struct secure_rng_ctx scratch;
+
+// Keystream of a state goes first into a secure_rng_bytes
+//  output of more than 64 bytes, V counts the blocks used
+static void model_keystream(struct model *m, uint8_t *out, size_t len) {
+    static uint8_t block[FKE_DIRECT_LENGTH + 64];
+    size_t blocks = (len + 15) / 16;
+    unsigned carry = 0;
+
+    memcpy(scratch.Key, m->Key, 32);
+    memcpy(scratch.V, m->V, 16);
+    secure_rng_bytes(&scratch, block, (blocks < 5) ? 80 : 16 * blocks, 0);
+    memcpy(out, block, len);
+
+    for (int i = 15; i >= 0; --i) {
+        unsigned sum = m->V[i] + (unsigned)(blocks & 0xff) + carry;
+        m->V[i] = (uint8_t)sum;
+        carry = sum >> 8;
+        blocks >>= 8;
+    }
+}
+
+static void model_init(struct model *m, const struct secure_rng_fke_ctx *fke) {
+    memcpy(m->Key, fke->drbg.Key, 32);
+    memcpy(m->V, fke->drbg.V, 16);
+    m->position = RNG_FKE_BUFFER;
+}
+
+static void model_bytes(struct model *m, uint8_t *x, size_t xlen) {
+    while (xlen >= RNG_FKE_BUFFER) {
+        size_t len = (xlen < FKE_DIRECT_LENGTH) ? (xlen & ~(size_t)15) : FKE_DIRECT_LENGTH;
+        model_keystream(m, x, len);
+        model_keystream(m, m->Key, 32);
+        x += len;
+        xlen -= len;
+    }
+
+    while (xlen) {
+        if (m->position == RNG_FKE_BUFFER) {
+            model_keystream(m, m->buffer, RNG_FKE_BUFFER);
+            memcpy(m->Key, m->buffer, 32);
+            m->position = 32;
+        }
+        size_t part = (xlen < RNG_FKE_BUFFER - m->position) ? xlen : RNG_FKE_BUFFER - m->position;
+        memcpy(x, m->buffer + m->position, part);
+        m->position += part;
+        x += part;
+        xlen -= part;
+    }
+}
+
+static int all_zero(const uint8_t *data, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        if (data[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int compare_words(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Any keystream served twice shows up as a repeated 8-byte word, at
+//  whatever byte offset the two copies start
+static int no_repeats(const uint8_t *data, size_t len) {
+    size_t count = len - 7;
+    uint64_t *words = malloc(count * sizeof(uint64_t));
+    int unique = 1;
+
+    if (words == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        memcpy(&words[i], data + i, 8);
+    }
+    qsort(words, count, sizeof(uint64_t), &compare_words);
+    for (size_t i = 1; i < count; ++i) {
+        unique &= words[i] != words[i - 1];
+    }
+    free(words);
+    return unique;
+}
+
+// Mixed buffered and direct calls follow the model, served bytes
+//  and replaced keys don't stay behind
+static void test_pattern(void) {
+    static struct secure_rng_fke_ctx fke, again;
+    static struct model m;
+    uint8_t old_key[32];
+    size_t total = 0;
+    int bad = 0, wiped = 0, keys = 0;
+
+    secure_rng_fke_seed(&fke, fake_entropy1, NULL, 0);
+    secure_rng_fke_seed(&again, fake_entropy1, NULL, 0);
+    model_init(&m, &fke);
+
+    for (int call = 0; call < PATTERN_CALLS; ++call) {
+        size_t len = pattern_size();
+        if (total + len > OUTPUT_BYTES) {
+            break;
+        }
+
+        memcpy(old_key, fke.drbg.Key, 32);
+        bad += secure_rng_fke_bytes(&fke, output + total, len, 0) != RNG_SUCCESS;
+        model_bytes(&m, expected + total, len);
+        bad += memcmp(output + total, expected + total, len) != 0;
+        bad += memcmp(fke.drbg.Key, m.Key, 32) != 0 || memcmp(fke.drbg.V, m.V, 16) != 0 || fke.position != m.position;
+
+        // Everything before the position was either the key or served
+        wiped += !all_zero(fke.buffer, fke.position);
+        if (memcmp(old_key, fke.drbg.Key, 32) != 0) {
+            keys += memmem(&fke, sizeof(fke), old_key, 32) != NULL;
+        }
+        keys += memmem(output + total, len, fke.drbg.Key, 32) != NULL;
+
+        total += len;
+    }
+
+    check(bad == 0, "fke output and state follow the model");
+    check(wiped == 0, "served buffer bytes wiped");
+    check(keys == 0, "old keys wiped, keys never served");
+    check(no_repeats(output, total), "buffered and direct output never repeat");
+
+    // Same seed and call pattern, same output
+    lcg_state = 1;
+    bad = 0;
+    for (size_t done = 0; done < total;) {
+        size_t len = pattern_size();
+        if (done + len > total) {
+            break;
+        }
+        secure_rng_fke_bytes(&again, expected, len, 0);
+        bad += memcmp(expected, output + done, len) != 0;
+        done += len;
+    }
+    check(bad == 0 && !memcmp(again.drbg.Key, fke.drbg.Key, 32), "fke deterministic for a seed and call pattern");
+}
+
+static void test_reseed(void) {
+    static struct secure_rng_fke_ctx fke;
+    static struct model m;
+    uint8_t rest[RNG_FKE_BUFFER];
+    size_t position;
+
+    secure_rng_fke_seed(&fke, fake_entropy1, NULL, 0);
+    secure_rng_fke_bytes(&fke, output, 100, 0);
+    position = fke.position;
+    memcpy(rest, fke.buffer + position, RNG_FKE_BUFFER - position);
+
+    check(secure_rng_fke_reseed(&fke, fake_entropy2, NULL, 0) == RNG_SUCCESS, "fke reseed");
+    check(fke.position == RNG_FKE_BUFFER && all_zero(fke.buffer, RNG_FKE_BUFFER), "reseed wipes the buffer");
+
+    model_init(&m, &fke);
+    secure_rng_fke_bytes(&fke, output, 4000, 0);
+    model_bytes(&m, expected, 4000);
+    check(!memcmp(output, expected, 4000), "output after reseed comes from the new state");
+    check(memmem(output, 4000, rest, 16) == NULL, "buffered keystream not served after reseed");
+
+    // Prediction resistance discards it too, even if there's no seeder
+    check(secure_rng_fke_bytes(&fke, output, 16, 1) == RNG_NEED_RESEED, "resistance without a seeder");
+    check(fke.position == RNG_FKE_BUFFER && all_zero(fke.buffer, RNG_FKE_BUFFER), "failed reseed wipes the buffer");
+}
+
+static void fixed_seeder(uint8_t seed_out[48]) {
+    memset(seed_out, 0x5a, 48);
+}
+
+// Result of the child's first request after fork
+struct child_result {
+    int result;
+    int wiped;
+    uint8_t bytes[64];
+};
+
+// A child must neither serve the parent's buffered keystream nor
+//  go on from its state without a seeder
+static void test_fork(int with_seeder) {
+    static struct secure_rng_fke_ctx fke;
+    struct child_result child;
+    uint8_t parent[64];
+    int fds[2];
+    pid_t pid;
+
+    secure_rng_fke_seed(&fke, fake_entropy1, NULL, 0);
+    secure_rng_enable_fork_detection(&fke.drbg);
+    if (with_seeder) {
+        secure_rng_set_seeder(&fke.drbg, &fixed_seeder, RNG_NO_LIMIT);
+    }
+    secure_rng_fke_bytes(&fke, output, 100, 0);
+
+    if (pipe(fds) != 0 || (pid = fork()) < 0) {
+        check(0, "fork");
+        return;
+    }
+    if (pid == 0) {
+        child.result = secure_rng_fke_bytes(&fke, child.bytes, sizeof(child.bytes), 0);
+        child.wiped = with_seeder ? all_zero(fke.buffer, fke.position) : all_zero(fke.buffer, RNG_FKE_BUFFER);
+        _exit(write(fds[1], &child, sizeof(child)) != sizeof(child));
+    }
+
+    int result = secure_rng_fke_bytes(&fke, parent, sizeof(parent), 0);
+    if (read(fds[0], &child, sizeof(child)) != sizeof(child)) {
+        child.result = RNG_IO_ERROR;
+    }
+    waitpid(pid, NULL, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    check(result == RNG_SUCCESS && fke.position == 32 + 100 + sizeof(parent), "parent keeps its buffer after fork");
+    if (with_seeder) {
+        check(child.result == RNG_SUCCESS && child.wiped && memcmp(child.bytes, parent, sizeof(parent)) != 0, "child discards the parent's buffer");
+    }
+    else {
+        check(child.result == RNG_NEED_RESEED && child.wiped, "child without a seeder needs reseed, buffer wiped");
+    }
+}
+
+int main() {
+    if (RNG_SUCCESS != secure_rng_seed(&scratch, fake_entropy1, NULL, 0)) {
+        printf("secure_rng_seed() failed\n");
+        return -1;
+    }
+
+    test_pattern();
+    test_reseed();
+    test_fork(1);
+    test_fork(0);
+
+    printf("%s\n", failures ? "fke tests FAILED" : "fke tests passed");
+    return failures != 0;
+}
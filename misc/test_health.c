@@ -0,0 +1,291 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define RCT_CUTOFF  RNG_HEALTH_RCT_CUTOFF
+#define APT_CUTOFF  RNG_HEALTH_APT_CUTOFF
+#define WINDOW      RNG_HEALTH_APT_WINDOW
+#define CHUNK       64
+#define RANDOM_LEN  200000
+
+uint8_t fake_entropy[48] = {0};
+
+static uint8_t samples[RANDOM_LEN];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Reproducible inputs
+static uint64_t lcg_state = 1;
+
+static uint32_t lcg_next(void) {
+    lcg_state = lcg_state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+    return (uint32_t)(lcg_state >> 33);
+}
+
+// Samples one at a time, the way SP 800-90B describes the tests.
+//  Like the library it tests 64 samples of a block at a time and
+//  stops at the end of the chunk in which a test failed, so the
+//  failure counters can be compared too.
+static int reference_test(struct secure_rng_health *health, const uint8_t *data, size_t len) {
+    int rct_passed = 1, apt_passed = 1;
+
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t sample = data[i];
+
+        if (rct_passed) {
+            health->rct_run = (health->rct_run != 0 && sample == health->rct_last) ? health->rct_run + 1 : 1;
+            rct_passed = health->rct_run < health->rct_cutoff;
+        }
+        health->rct_last = sample;
+
+        if (apt_passed) {
+            if (health->apt_seen == 0) {
+                health->apt_first = sample;
+                health->apt_count = 0;
+            }
+            health->apt_count += sample == health->apt_first;
+            health->apt_seen = (health->apt_seen + 1) % WINDOW;
+            apt_passed = health->apt_count < health->apt_cutoff;
+        }
+
+        if ((i + 1) % CHUNK == 0 && !(rct_passed && apt_passed)) {
+            break;
+        }
+    }
+
+    health->blocks++;
+    if (!rct_passed || !apt_passed) {
+        health->rct_failures += !rct_passed;
+        health->apt_failures += !apt_passed;
+        health->rct_run = 0;
+        health->apt_seen = 0;
+        return RNG_HEALTH_FAILURE;
+    }
+    return RNG_SUCCESS;
+}
+
+static int same_state(const struct secure_rng_health *a, const struct secure_rng_health *b) {
+    return a->blocks == b->blocks && a->rct_failures == b->rct_failures && a->apt_failures == b->apt_failures
+        && a->rct_run == b->rct_run && a->apt_seen == b->apt_seen
+        && (a->rct_run == 0 || a->rct_last == b->rct_last)
+        && (a->apt_seen == 0 || (a->apt_count == b->apt_count && a->apt_first == b->apt_first));
+}
+
+// Runs of random length over a few values, so that both tests
+//  pass and fail now and then, split into calls of random length
+static void test_reference(uint32_t rct_cutoff, uint32_t apt_cutoff, uint32_t values, const char *name) {
+    struct secure_rng_health health, reference;
+    char what[96];
+    int bad = 0;
+
+    for (size_t i = 0; i < RANDOM_LEN;) {
+        uint8_t value = (uint8_t)(lcg_next() % values);
+        size_t run = 1 + lcg_next() % (rct_cutoff + 2);
+        while (run-- && i < RANDOM_LEN) {
+            samples[i++] = value;
+        }
+    }
+
+    secure_rng_health_init(&health, rct_cutoff, apt_cutoff);
+    secure_rng_health_init(&reference, rct_cutoff, apt_cutoff);
+
+    for (size_t done = 0; done < RANDOM_LEN;) {
+        size_t len = lcg_next() % ((lcg_next() & 1) ? 48 : 700);
+        if (len > RANDOM_LEN - done) {
+            len = RANDOM_LEN - done;
+        }
+        bad += secure_rng_health_test(&health, samples + done, len) != reference_test(&reference, samples + done, len);
+        bad += !same_state(&health, &reference);
+        done += len;
+    }
+
+    snprintf(what, sizeof(what), "%s match the reference", name);
+    check(bad == 0, what);
+    snprintf(what, sizeof(what), "%s fail now and then", name);
+    check(health.rct_failures + health.apt_failures > 0 && health.blocks > health.rct_failures + health.apt_failures, what);
+}
+
+// Runs of cutoff - 1 identical samples pass and runs of cutoff fail,
+//  wherever they start and however the block is split
+static void test_rct_runs(void) {
+    static const size_t starts[] = { 0, 1, 30, 44, 50, 63, 64, 100, 127, 200 };
+    struct secure_rng_health health;
+    uint8_t block[300];
+    int bad = 0;
+
+    for (size_t s = 0; s < sizeof(starts) / sizeof(starts[0]); ++s) {
+        for (size_t length = RCT_CUTOFF - 1; length <= RCT_CUTOFF; ++length) {
+            int expected = (length < RCT_CUTOFF) ? RNG_SUCCESS : RNG_HEALTH_FAILURE;
+
+            // Distinct neighbours, so that only the run repeats
+            for (size_t i = 0; i < sizeof(block); ++i) {
+                block[i] = (uint8_t)(i % 251 + 1);
+            }
+            memset(block + starts[s], 0, length);
+
+            for (size_t split = 0; split <= sizeof(block); split += (split < starts[s] + length + 1) ? 1 : 37) {
+                secure_rng_health_init(&health, RCT_CUTOFF, APT_CUTOFF);
+                int first = secure_rng_health_test(&health, block, split);
+                int second = (first == RNG_SUCCESS) ? secure_rng_health_test(&health, block + split, sizeof(block) - split) : first;
+
+                bad += second != expected || health.rct_failures != (expected != RNG_SUCCESS) || health.apt_failures != 0;
+            }
+        }
+    }
+    check(bad == 0, "rct runs of cutoff - 1 pass and of cutoff fail across chunks and blocks");
+
+    // A run which spans several blocks
+    secure_rng_health_init(&health, RCT_CUTOFF, APT_CUTOFF);
+    memset(block, 7, sizeof(block));
+    bad = 0;
+    for (size_t i = 0; i < RCT_CUTOFF - 1; ++i) {
+        bad += secure_rng_health_test(&health, block, 1) != RNG_SUCCESS;
+    }
+    check(bad == 0 && health.rct_run == RCT_CUTOFF - 1, "rct run carried over single sample blocks");
+    check(secure_rng_health_test(&health, block, 1) == RNG_HEALTH_FAILURE && health.rct_failures == 1, "rct fails on the block which completes the run");
+
+    // The failing block's run is forgotten, the next sample starts anew
+    check(health.rct_run == 0, "rct run reset after a failure");
+    check(secure_rng_health_test(&health, block, RCT_CUTOFF - 1) == RNG_SUCCESS, "rct starts over after a failure");
+    check(secure_rng_health_test(&health, block, 1) == RNG_HEALTH_FAILURE && health.rct_failures == 2, "rct fails again");
+}
+
+// A window of the given count of its first sample, with
+//  no runs long enough for the Repetition Count Test
+static void apt_window(uint8_t *window, uint8_t first, uint32_t count) {
+    uint32_t placed = 0;
+
+    for (size_t i = 0; i < WINDOW; ++i) {
+        window[i] = (uint8_t)(first + 1 + i % 200);
+    }
+    // Spread out, the first sample is always one of them
+    for (size_t i = 0; i < WINDOW && placed < count; ++i) {
+        if ((i * count) % WINDOW < count) {
+            window[i] = first;
+            placed++;
+        }
+    }
+}
+
+static int apt_feed(struct secure_rng_health *health, const uint8_t *data, size_t len, size_t step) {
+    int result = RNG_SUCCESS;
+
+    for (size_t done = 0; done < len && result == RNG_SUCCESS; done += step) {
+        result = secure_rng_health_test(health, data + done, (len - done < step) ? len - done : step);
+    }
+    return result;
+}
+
+static void test_apt_windows(void) {
+    static const size_t steps[] = { 1, 7, 63, 64, 65, 100, 511, 512, 513, 1536 };
+    static uint8_t windows[3 * WINDOW];
+    struct secure_rng_health health;
+    int bad = 0;
+
+    // Three windows of cutoff - 1, fed in blocks which don't
+    //  line up with windows or chunks
+    apt_window(windows, 0x10, APT_CUTOFF - 1);
+    apt_window(windows + WINDOW, 0x10, APT_CUTOFF - 1);
+    apt_window(windows + 2 * WINDOW, 0x20, APT_CUTOFF - 1);
+
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); ++s) {
+        secure_rng_health_init(&health, RCT_CUTOFF, APT_CUTOFF);
+        bad += apt_feed(&health, windows, sizeof(windows), steps[s]) != RNG_SUCCESS;
+        bad += health.apt_seen != 0 || health.apt_failures != 0;
+    }
+    check(bad == 0, "apt windows of cutoff - 1 pass, counts don't carry into the next window");
+
+    // One more in the second window fails it
+    apt_window(windows + WINDOW, 0x10, APT_CUTOFF);
+    bad = 0;
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); ++s) {
+        secure_rng_health_init(&health, RCT_CUTOFF, APT_CUTOFF);
+        bad += apt_feed(&health, windows, sizeof(windows), steps[s]) != RNG_HEALTH_FAILURE;
+        bad += health.apt_failures != 1 || health.rct_failures != 0 || health.apt_seen != 0;
+    }
+    check(bad == 0, "apt window of cutoff fails when split across blocks");
+
+    // Window started by one block and finished by another
+    secure_rng_health_init(&health, RCT_CUTOFF, APT_CUTOFF);
+    apt_window(windows, 0x30, APT_CUTOFF);
+    check(secure_rng_health_test(&health, windows, WINDOW - 1) == RNG_SUCCESS && health.apt_seen == WINDOW - 1, "apt window carried over blocks");
+    check(secure_rng_health_test(&health, windows + WINDOW - 1, 1) == RNG_HEALTH_FAILURE, "apt fails on the last sample of the window");
+
+    // The next window starts with the next block
+    check(health.apt_seen == 0 && health.apt_failures == 1, "apt window reset after a failure");
+    check(secure_rng_health_test(&health, windows + 5, WINDOW - 5) == RNG_SUCCESS && health.apt_seen == WINDOW - 5, "apt starts over after a failure");
+}
+
+static void test_init(void) {
+    struct secure_rng_health health;
+
+    check(secure_rng_health_init(&health, 1, APT_CUTOFF) == RNG_BAD_MAXLEN, "rct cutoff of 1 rejected");
+    check(secure_rng_health_init(&health, RCT_CUTOFF, 1) == RNG_BAD_MAXLEN, "apt cutoff of 1 rejected");
+    check(secure_rng_health_init(&health, RCT_CUTOFF, WINDOW + 1) == RNG_BAD_MAXLEN, "apt cutoff above the window rejected");
+    check(secure_rng_health_init(&health, 2, WINDOW) == RNG_SUCCESS, "smallest and largest cutoffs");
+    check(secure_rng_health_test(&health, samples, 0) == RNG_SUCCESS && health.blocks == 1, "empty block counted");
+}
+
+static int seeder_stuck = 0;
+
+static void test_seeder(uint8_t seed_out[48]) {
+    static uint8_t counter = 0;
+    for (int i = 0; i < 48; ++i) {
+        seed_out[i] = seeder_stuck ? 0x42 : (uint8_t)(counter + 37 * i);
+    }
+    counter++;
+}
+
+// Seeder output which fails is never mixed in
+static void test_reseed(void) {
+    struct secure_rng_ctx ctx, before;
+    struct secure_rng_health health;
+    uint8_t out[64], expected[64];
+
+    secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+    secure_rng_health_init(&health, RCT_CUTOFF, APT_CUTOFF);
+    secure_rng_set_seeder(&ctx, &test_seeder, RNG_NO_LIMIT);
+    secure_rng_enable_health_tests(&ctx, &health);
+
+    check(secure_rng_bytes(&ctx, out, sizeof(out), 1) == RNG_SUCCESS && health.blocks == 1, "healthy seeder output reseeds");
+
+    seeder_stuck = 1;
+    before = ctx;
+    memset(out, 0xee, sizeof(out));
+    check(secure_rng_bytes(&ctx, out, sizeof(out), 1) == RNG_HEALTH_FAILURE, "stuck seeder output fails");
+    check(health.rct_failures == 1 && health.blocks == 2, "failure counted");
+    check(out[0] == 0xee && !memcmp(out, out + 1, sizeof(out) - 1), "nothing generated on failure");
+    check(!memcmp(&ctx, &before, sizeof(ctx)), "context unchanged on failure");
+
+    // Without a reseed the generator goes on from the same state
+    secure_rng_bytes(&ctx, out, sizeof(out), 0);
+    secure_rng_bytes(&before, expected, sizeof(expected), 0);
+    check(!memcmp(out, expected, sizeof(out)), "state not reseeded on failure");
+
+    seeder_stuck = 0;
+    check(secure_rng_bytes(&ctx, out, sizeof(out), 1) == RNG_SUCCESS, "healthy seeder output reseeds again");
+    secure_rng_bytes(&before, expected, sizeof(expected), 0);
+    check(memcmp(out, expected, sizeof(out)) != 0, "reseeded state differs");
+}
+
+int main() {
+    test_reference(RCT_CUTOFF, APT_CUTOFF, 2, "default cutoffs, two values");
+    test_reference(RCT_CUTOFF, APT_CUTOFF, 3, "default cutoffs, three values");
+    test_reference(5, 40, 4, "low cutoffs");
+    test_reference(2, WINDOW, 200, "cutoffs at the limits");
+    test_rct_runs();
+    test_apt_windows();
+    test_init();
+    test_reseed();
+
+    printf("%s\n", failures ? "health tests FAILED" : "health tests passed");
+    return failures != 0;
+}
@@ -0,0 +1,146 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define SCALAR_BYTES 32
+#define COUNT        5000
+
+uint8_t fake_entropy[48] = {0};
+
+// Group orders, big-endian
+static const uint8_t order_secp256k1[SCALAR_BYTES] = {
+    0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xfe,
+    0xba, 0xae, 0xdc, 0xe6, 0xaf, 0x48, 0xa0, 0x3b, 0xbf, 0xd2, 0x5e, 0x8c, 0xd0, 0x36, 0x41, 0x41,
+};
+
+static const uint8_t order_p256[SCALAR_BYTES] = {
+    0xff, 0xff, 0xff, 0xff, 0x00, 0x00, 0x00, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    0xbc, 0xe6, 0xfa, 0xad, 0xa7, 0x17, 0x9e, 0x84, 0xf3, 0xb9, 0xca, 0xc2, 0xfc, 0x63, 0x25, 0x51,
+};
+
+static uint8_t scalars[COUNT * SCALAR_BYTES];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+static int in_range(const uint8_t *scalar, const uint8_t *order) {
+    static const uint8_t zero[SCALAR_BYTES] = {0};
+    return memcmp(scalar, zero, SCALAR_BYTES) != 0 && memcmp(scalar, order, SCALAR_BYTES) < 0;
+}
+
+// Candidates planted in front of the first batch: the order itself,
+//  zero and all ones are rejected, order - 1 and one are kept
+static uint8_t planted[5][SCALAR_BYTES];
+static const int planted_kept[] = { 1, 3 };
+
+static void plant(const uint8_t *order) {
+    memcpy(planted[0], order, SCALAR_BYTES);
+    memcpy(planted[1], order, SCALAR_BYTES);
+    planted[1][SCALAR_BYTES - 1]--;
+    memset(planted[2], 0, SCALAR_BYTES);
+    memset(planted[3], 0, SCALAR_BYTES);
+    planted[3][SCALAR_BYTES - 1] = 1;
+    memset(planted[4], 0xff, SCALAR_BYTES);
+}
+
+// The output can't be steered through the seeder, so the kernel of the
+//  context is replaced by one which overwrites the start of the next
+//  request. Pinned backend builds don't call it, see stub_calls.
+static void (*real_kernel)(uint8_t *out, const uint8_t *sk, const void *counter, int bytes);
+static int stub_armed = 0;
+static int stub_calls = 0;
+
+static void stub_kernel(uint8_t *out, const uint8_t *sk, const void *counter, int bytes) {
+    real_kernel(out, sk, counter, bytes);
+    if (stub_armed && bytes >= (int)sizeof(planted)) {
+        memcpy(out, planted, sizeof(planted));
+        stub_armed = 0;
+        stub_calls++;
+    }
+}
+
+static void test_range(struct secure_rng_ctx *ctx, int curve, const uint8_t *order, const char *name) {
+    char what[64];
+    int bad = 0;
+
+    snprintf(what, sizeof(what), "%s scalars generated", name);
+    check(secure_rng_ec_scalars(ctx, curve, scalars, COUNT) == RNG_SUCCESS, what);
+
+    for (size_t i = 0; i < COUNT; ++i) {
+        bad += !in_range(scalars + i * SCALAR_BYTES, order);
+    }
+    snprintf(what, sizeof(what), "%s scalars in (0, n)", name);
+    check(bad == 0, what);
+}
+
+static void test_rejection(struct secure_rng_ctx *ctx, int curve, const uint8_t *order, const char *name) {
+    char what[64];
+    int bad = 0;
+
+    plant(order);
+    real_kernel = ctx->aesctr256;
+    ctx->aesctr256 = &stub_kernel;
+    stub_armed = 1;
+    stub_calls = 0;
+
+    snprintf(what, sizeof(what), "%s scalars generated with rejections", name);
+    check(secure_rng_ec_scalars(ctx, curve, scalars, 100) == RNG_SUCCESS, what);
+    ctx->aesctr256 = real_kernel;
+
+    if (stub_calls == 0) {
+        printf("%s rejection path skipped, the kernel is pinned\n", name);
+        return;
+    }
+
+    // Accepted candidates keep their order, rejected ones are replaced
+    snprintf(what, sizeof(what), "%s planted order - 1 kept first", name);
+    check(!memcmp(scalars, planted[planted_kept[0]], SCALAR_BYTES), what);
+    snprintf(what, sizeof(what), "%s planted one kept second", name);
+    check(!memcmp(scalars + SCALAR_BYTES, planted[planted_kept[1]], SCALAR_BYTES), what);
+
+    for (size_t i = 0; i < 100; ++i) {
+        bad += !in_range(scalars + i * SCALAR_BYTES, order);
+    }
+    snprintf(what, sizeof(what), "%s scalars in (0, n) after rejections", name);
+    check(bad == 0, what);
+}
+
+static void test_x25519(struct secure_rng_ctx *ctx) {
+    int bad = 0;
+
+    check(secure_rng_ec_scalars(ctx, RNG_CURVE_X25519, scalars, COUNT) == RNG_SUCCESS, "x25519 scalars generated");
+
+    // Low three bits and the top bit cleared, bit 254 set
+    for (size_t i = 0; i < COUNT; ++i) {
+        const uint8_t *scalar = scalars + i * SCALAR_BYTES;
+        bad += (scalar[0] & 7) != 0 || (scalar[31] & 0xc0) != 0x40;
+    }
+    check(bad == 0, "x25519 scalars clamped");
+}
+
+int main() {
+    struct secure_rng_ctx ctx;
+
+    if (RNG_SUCCESS != secure_rng_seed(&ctx, fake_entropy, NULL, 0)) {
+        printf("secure_rng_seed() failed\n");
+        return -1;
+    }
+
+    test_range(&ctx, RNG_CURVE_SECP256K1, order_secp256k1, "secp256k1");
+    test_range(&ctx, RNG_CURVE_P256, order_p256, "p256");
+    test_rejection(&ctx, RNG_CURVE_SECP256K1, order_secp256k1, "secp256k1");
+    test_rejection(&ctx, RNG_CURVE_P256, order_p256, "p256");
+    test_x25519(&ctx);
+
+    check(secure_rng_ec_scalars(&ctx, 0, scalars, 1) == RNG_NOT_SUPPORTED, "unknown curve rejected");
+
+    printf("%s\n", failures ? "ec scalar tests FAILED" : "ec scalar tests passed");
+    return failures != 0;
+}
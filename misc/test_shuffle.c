@@ -0,0 +1,232 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_N   1000
+#define TRIALS  240000
+
+uint8_t fake_entropy[48] = {0};
+
+static uint8_t elements[MAX_N * 100];
+static size_t indices[1 << 20];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Chi-square statistic of observed counts against equal expected ones
+static double chi_square(const long *counts, size_t bins, long total) {
+    double expected = (double)total / bins, sum = 0;
+
+    for (size_t i = 0; i < bins; ++i) {
+        double d = counts[i] - expected;
+        sum += d * d / expected;
+    }
+    return sum;
+}
+
+// Every element carries its index in its first bytes and a
+//  filler derived from it in the rest, a shuffle must keep each
+//  element whole and leave every index exactly once
+static void fill_elements(size_t n, size_t size) {
+    for (size_t i = 0; i < n; ++i) {
+        uint8_t *element = elements + i * size;
+        for (size_t j = 0; j < size; ++j) {
+            element[j] = (uint8_t)(i * 31 + j * 7);
+        }
+        memcpy(element, &(uint16_t){ (uint16_t)i }, (size < 2) ? size : 2);
+    }
+}
+
+static int is_permutation(size_t n, size_t size) {
+    static uint8_t seen[MAX_N];
+    int bad = 0;
+
+    memset(seen, 0, sizeof(seen));
+    for (size_t i = 0; i < n; ++i) {
+        const uint8_t *element = elements + i * size;
+        uint16_t index = 0;
+
+        memcpy(&index, element, (size < 2) ? size : 2);
+        if (size == 1) {
+            // Only the low byte is kept, n is at most 256 then
+            index = element[0];
+        }
+        if (index >= n || seen[index]++) {
+            return 0;
+        }
+        for (size_t j = 2; j < size; ++j) {
+            bad += element[j] != (uint8_t)(index * 31 + j * 7);
+        }
+    }
+    return bad == 0;
+}
+
+static void test_permutations(struct secure_rng_ctx *ctx) {
+    static const size_t sizes[] = { 1, 2, 3, 4, 8, 16, 24, 64, 65, 100 };
+    static const size_t counts[] = { 0, 1, 2, 3, 31, 32, 33, 64, 200, MAX_N };
+    char what[64];
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        int bad = 0;
+
+        for (size_t c = 0; c < sizeof(counts) / sizeof(counts[0]); ++c) {
+            size_t n = (sizes[s] == 1 && counts[c] > 256) ? 256 : counts[c];
+            fill_elements(n, sizes[s]);
+            bad += secure_rng_shuffle(ctx, elements, n, sizes[s]) != RNG_SUCCESS;
+            bad += !is_permutation(n, sizes[s]);
+        }
+
+        snprintf(what, sizeof(what), "%zu byte elements shuffled into permutations", sizes[s]);
+        check(bad == 0, what);
+    }
+
+    // Large shuffles move elements
+    fill_elements(MAX_N, 4);
+    secure_rng_shuffle(ctx, elements, MAX_N, 4);
+    size_t fixed = 0;
+    for (size_t i = 0; i < MAX_N; ++i) {
+        uint16_t index;
+        memcpy(&index, elements + 4 * i, 2);
+        fixed += index == i;
+    }
+    check(fixed < 20, "shuffle leaves few elements in place");
+}
+
+// Each of the 24 orders of four elements equally likely
+static void test_shuffle_distribution(struct secure_rng_ctx *ctx) {
+    long counts[24] = {0};
+
+    for (long t = 0; t < TRIALS; ++t) {
+        uint8_t order[4] = { 0, 1, 2, 3 };
+        size_t rank = 0, factor = 6;
+
+        secure_rng_shuffle(ctx, order, 4, 1);
+
+        // Lehmer code of the order
+        for (int i = 0; i < 3; ++i) {
+            size_t smaller = 0;
+            for (int j = i + 1; j < 4; ++j) {
+                smaller += order[j] < order[i];
+            }
+            rank += smaller * factor;
+            factor /= 3 - i;
+        }
+        counts[rank]++;
+    }
+
+    // 23 degrees of freedom, p < 1e-6 above 62
+    check(chi_square(counts, 24, TRIALS) < 62, "shuffle orders uniform");
+}
+
+static int distinct_in_range(const size_t *values, size_t k, size_t n) {
+    static uint8_t seen[1 << 20];
+
+    memset(seen, 0, (n < sizeof(seen)) ? n : sizeof(seen));
+    for (size_t i = 0; i < k; ++i) {
+        if (values[i] >= n || seen[values[i]]++) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void test_sample(struct secure_rng_ctx *ctx) {
+    static const struct {
+        size_t n, k;
+        const char *what;
+    } cases[] = {
+        { 1, 1, "one of one" },
+        { 1000, 1000, "all indices" },
+        { 1000, 999, "all but one index, bitmap" },
+        { 1000, 100, "bitmap set" },
+        { 1000, 15, "bitmap set at the limit" },
+        { 1000, 3, "hash set" },
+        { 1 << 20, 1000, "hash set, large n" },
+        { 1 << 20, 1 << 14, "bitmap set, large n" },
+        { 1 << 20, 1 << 20, "all of a large n" },
+    };
+    char what[64];
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); ++c) {
+        int bad = 0;
+        for (int repeat = 0; repeat < 20; ++repeat) {
+            bad += secure_rng_sample_indices(ctx, cases[c].n, cases[c].k, indices) != RNG_SUCCESS;
+            bad += !distinct_in_range(indices, cases[c].k, cases[c].n);
+        }
+        snprintf(what, sizeof(what), "sample %s distinct and in range", cases[c].what);
+        check(bad == 0, what);
+    }
+
+    indices[0] = 12345;
+    check(secure_rng_sample_indices(ctx, 10, 0, indices) == RNG_SUCCESS && indices[0] == 12345, "empty sample untouched");
+}
+
+// Ordered samples of two out of five through the bitmap, and
+//  single indices out of 128 through the hash set
+static void test_sample_distribution(struct secure_rng_ctx *ctx) {
+    long pairs[25] = {0};
+    long singles[128] = {0};
+    long trials = TRIALS / 2;
+    size_t out[2];
+
+    for (long t = 0; t < trials; ++t) {
+        secure_rng_sample_indices(ctx, 5, 2, out);
+        pairs[out[0] * 5 + out[1]]++;
+    }
+
+    // Drop the impossible pairs of an index with itself
+    long ordered[20], repeated = 0;
+    size_t bins = 0;
+    for (size_t i = 0; i < 25; ++i) {
+        if (i / 5 != i % 5) {
+            ordered[bins++] = pairs[i];
+        }
+        else {
+            repeated += pairs[i];
+        }
+    }
+    check(repeated == 0, "no sample pair of the same index");
+    // 19 degrees of freedom, p < 1e-6 above 55
+    check(chi_square(ordered, bins, trials) < 55, "ordered samples of 2 out of 5 uniform");
+
+    for (long t = 0; t < trials; ++t) {
+        secure_rng_sample_indices(ctx, 128, 1, out);
+        singles[out[0]]++;
+    }
+    // 127 degrees of freedom, p < 1e-6 above 214
+    check(chi_square(singles, 128, trials) < 214, "samples of 1 out of 128 uniform");
+}
+
+static void test_errors(struct secure_rng_ctx *ctx) {
+    check(secure_rng_shuffle(ctx, elements, 10, 0) == RNG_BAD_MAXLEN, "zero element size rejected");
+    check(secure_rng_shuffle(ctx, elements, SIZE_MAX / 8 + 1, 8) == RNG_BAD_MAXLEN, "oversized array rejected");
+    check(secure_rng_sample_indices(ctx, 10, 11, indices) == RNG_BAD_MAXLEN, "k above n rejected");
+    check(secure_rng_sample_indices(ctx, 0, 1, indices) == RNG_BAD_MAXLEN, "sample from nothing rejected");
+    check(secure_rng_sample_indices(ctx, 0, 0, indices) == RNG_SUCCESS, "empty sample from nothing");
+}
+
+int main() {
+    struct secure_rng_ctx ctx;
+
+    if (RNG_SUCCESS != secure_rng_seed(&ctx, fake_entropy, NULL, 0)) {
+        printf("secure_rng_seed() failed\n");
+        return -1;
+    }
+
+    test_permutations(&ctx);
+    test_shuffle_distribution(&ctx);
+    test_sample(&ctx);
+    test_sample_distribution(&ctx);
+    test_errors(&ctx);
+
+    printf("%s\n", failures ? "shuffle tests FAILED" : "shuffle tests passed");
+    return failures != 0;
+}
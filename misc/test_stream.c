@@ -0,0 +1,259 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_TOTAL   (1 << 20)
+#define MAX_TILES   (MAX_TOTAL / 64 + 64)
+
+uint8_t fake_entropy[48] = {0};
+
+static uint8_t streamed[MAX_TOTAL];
+static uint8_t expected[MAX_TOTAL];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Tiles as the consumer saw them
+struct collected {
+    size_t bytes;
+    size_t tiles;
+    size_t stop_after;      // tiles to take before stopping, 0 for all
+    size_t lengths[MAX_TILES];
+};
+
+static struct collected collected;
+
+static int collect(const uint8_t *tile, size_t len, void *userdata) {
+    struct collected *c = userdata;
+
+    if (c->bytes + len <= MAX_TOTAL && c->tiles < MAX_TILES) {
+        memcpy(streamed + c->bytes, tile, len);
+        c->lengths[c->tiles] = len;
+    }
+    c->bytes += len;
+    c->tiles++;
+    return c->stop_after != 0 && c->tiles == c->stop_after;
+}
+
+static void collect_reset(size_t stop_after) {
+    collected.bytes = 0;
+    collected.tiles = 0;
+    collected.stop_after = stop_after;
+}
+
+// Deterministic seeder, restarted before each run
+static unsigned seeder_calls = 0;
+
+static void counting_seeder(uint8_t seed_out[48]) {
+    for (int i = 0; i < 48; ++i) {
+        seed_out[i] = (uint8_t)(seeder_calls * 131 + i);
+    }
+    seeder_calls++;
+}
+
+static size_t request_size(size_t tile_size) {
+    return ((MAX_GENERATE_LENGTH & ~15) / tile_size) * tile_size;
+}
+
+// What secure_rng_stream promises: secure_rng_bytes invocations
+//  of request size, the last one shorter
+static int reference(struct secure_rng_ctx *ctx, uint8_t *out, size_t total, size_t request) {
+    while (total) {
+        size_t len = (total < request) ? total : request;
+        int result = secure_rng_bytes(ctx, out, len, 0);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+        out += len;
+        total -= len;
+    }
+    return RNG_SUCCESS;
+}
+
+// Reseed times are read from the clock, everything else must match
+static int same_state(const struct secure_rng_ctx *a, const struct secure_rng_ctx *b) {
+    return !memcmp(a->Key, b->Key, sizeof(a->Key)) && !memcmp(a->V, b->V, sizeof(a->V))
+        && a->reseed_counter == b->reseed_counter && a->reseed_bytes == b->reseed_bytes;
+}
+
+// Every tile is full but the last one of each request
+static int tiles_match(size_t total, size_t tile_size, size_t request) {
+    size_t tile = 0;
+
+    while (total) {
+        size_t len = (total < request) ? total : request;
+        for (size_t done = 0; done < len; done += tile_size, ++tile) {
+            size_t expected_len = (len - done < tile_size) ? len - done : tile_size;
+            if (tile >= collected.tiles || collected.lengths[tile] != expected_len) {
+                return 0;
+            }
+        }
+        total -= len;
+    }
+    return tile == collected.tiles;
+}
+
+static void test_contract(void) {
+    static const size_t tile_sizes[] = { 0, 64, 80, 1008, 4096, 16384, 32752, RNG_STREAM_MAX_TILE };
+    char what[96];
+
+    for (size_t t = 0; t < sizeof(tile_sizes) / sizeof(tile_sizes[0]); ++t) {
+        size_t tile_size = tile_sizes[t] ? tile_sizes[t] : RNG_STREAM_TILE;
+        size_t request = request_size(tile_size);
+        const size_t totals[] = { 1, 15, 16, 17, 63, 64, 65, tile_size - 1, tile_size + 1, request - 1, request, request + 1,
+                                  2 * request + 17, 3 * request + tile_size, MAX_TOTAL };
+        int bad = 0;
+
+        for (size_t n = 0; n < sizeof(totals) / sizeof(totals[0]); ++n) {
+            struct secure_rng_ctx ctx, ref;
+
+            secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+            ref = ctx;
+            collect_reset(0);
+
+            bad += secure_rng_stream(&ctx, totals[n], tile_sizes[t], &collect, &collected) != RNG_SUCCESS;
+            bad += reference(&ref, expected, totals[n], request) != RNG_SUCCESS;
+            bad += collected.bytes != totals[n] || memcmp(streamed, expected, totals[n]) != 0;
+            bad += !tiles_match(totals[n], tile_size, request);
+            bad += !same_state(&ctx, &ref);
+
+            // And they go on the same way
+            secure_rng_bytes(&ctx, streamed, 100, 0);
+            secure_rng_bytes(&ref, expected, 100, 0);
+            bad += memcmp(streamed, expected, 100) != 0;
+        }
+
+        snprintf(what, sizeof(what), "stream of %zu byte tiles matches secure_rng_bytes", tile_size);
+        check(bad == 0, what);
+    }
+
+    struct secure_rng_ctx ctx, ref;
+    secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+    ref = ctx;
+    collect_reset(0);
+    check(secure_rng_stream(&ctx, 0, 0, &collect, &collected) == RNG_SUCCESS && collected.tiles == 0, "empty stream");
+    check(!memcmp(&ctx, &ref, sizeof(ctx)), "empty stream leaves the state alone");
+}
+
+// Tiles handed out before the stop are never produced again,
+//  the state moves on as if the rest of the request was read
+static void test_early_stop(void) {
+    static const size_t stops[] = { 1, 2, 3, 4, 5, 9 };
+    size_t tile_size = RNG_STREAM_TILE, request = request_size(tile_size);
+    int bad = 0;
+
+    for (size_t s = 0; s < sizeof(stops) / sizeof(stops[0]); ++s) {
+        struct secure_rng_ctx ctx, ref;
+        size_t seen = stops[s] * tile_size;
+        size_t whole = seen / request * request;
+
+        secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+        ref = ctx;
+        collect_reset(stops[s]);
+
+        bad += secure_rng_stream(&ctx, 20 * request, 0, &collect, &collected) != RNG_SUCCESS;
+        bad += collected.tiles != stops[s] || collected.bytes != seen;
+
+        // Requests read in full, then the part of the last one
+        reference(&ref, expected, whole, request);
+        if (seen > whole) {
+            secure_rng_bytes(&ref, expected + whole, seen - whole, 0);
+            ref.reseed_bytes += request - (seen - whole);
+        }
+        bad += memcmp(streamed, expected, seen) != 0;
+        bad += !same_state(&ctx, &ref);
+
+        // Next output is new keystream
+        secure_rng_bytes(&ctx, streamed + seen, 4096, 0);
+        secure_rng_bytes(&ref, expected, 4096, 0);
+        bad += memcmp(streamed + seen, expected, 4096) != 0;
+        for (size_t i = 0; i + 16 <= seen; i += 16) {
+            bad += !memcmp(streamed + i, streamed + seen, 16);
+        }
+    }
+    check(bad == 0, "stopped stream updates the state and accounts the request");
+}
+
+// Limits of the policy are checked before each request, just
+//  like before each secure_rng_bytes call
+static void test_policy(void) {
+    static const struct secure_rng_policy policies[] = {
+        { 3, RNG_NO_LIMIT, RNG_NO_LIMIT },
+        { RNG_NO_LIMIT, 100000, RNG_NO_LIMIT },
+        { 1, RNG_NO_LIMIT, RNG_NO_LIMIT },
+    };
+    static const size_t tile_sizes[] = { 0, 64, 1008, RNG_STREAM_MAX_TILE };
+    char what[96];
+
+    for (size_t p = 0; p < sizeof(policies) / sizeof(policies[0]); ++p) {
+        int bad = 0;
+
+        for (size_t t = 0; t < sizeof(tile_sizes) / sizeof(tile_sizes[0]); ++t) {
+            size_t tile_size = tile_sizes[t] ? tile_sizes[t] : RNG_STREAM_TILE;
+            struct secure_rng_ctx ctx, ref;
+            unsigned stream_calls, reference_calls;
+
+            secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+            secure_rng_set_seeder(&ctx, &counting_seeder, RNG_NO_LIMIT);
+            secure_rng_set_policy(&ctx, &policies[p]);
+            ref = ctx;
+
+            seeder_calls = 0;
+            collect_reset(0);
+            bad += secure_rng_stream(&ctx, MAX_TOTAL, tile_sizes[t], &collect, &collected) != RNG_SUCCESS;
+            stream_calls = seeder_calls;
+
+            seeder_calls = 0;
+            bad += reference(&ref, expected, MAX_TOTAL, request_size(tile_size)) != RNG_SUCCESS;
+            reference_calls = seeder_calls;
+
+            bad += memcmp(streamed, expected, MAX_TOTAL) != 0 || !same_state(&ctx, &ref);
+            bad += stream_calls == 0 || stream_calls != reference_calls;
+        }
+
+        snprintf(what, sizeof(what), "stream reseeds like secure_rng_bytes, policy %zu", p);
+        check(bad == 0, what);
+    }
+
+    // Without a seeder the stream ends where secure_rng_bytes fails
+    struct secure_rng_ctx ctx, ref;
+    struct secure_rng_policy policy = { 4, RNG_NO_LIMIT, RNG_NO_LIMIT };
+    size_t request = request_size(RNG_STREAM_TILE);
+
+    secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+    secure_rng_set_policy(&ctx, &policy);
+    ref = ctx;
+    collect_reset(0);
+
+    check(secure_rng_stream(&ctx, MAX_TOTAL, 0, &collect, &collected) == RNG_NEED_RESEED, "stream needs reseed without a seeder");
+    check(reference(&ref, expected, MAX_TOTAL, request) == RNG_NEED_RESEED, "reference needs reseed");
+    check(collected.bytes == 4 * request && !memcmp(streamed, expected, collected.bytes), "stream delivered the requests before the limit");
+    check(same_state(&ctx, &ref), "state at the limit matches");
+}
+
+static void test_invalid(void) {
+    struct secure_rng_ctx ctx;
+
+    secure_rng_seed(&ctx, fake_entropy, NULL, 0);
+    check(secure_rng_stream(&ctx, 100, 48, &collect, &collected) == RNG_BAD_MAXLEN, "tiles below 64 bytes rejected");
+    check(secure_rng_stream(&ctx, 100, RNG_STREAM_MAX_TILE + 16, &collect, &collected) == RNG_BAD_MAXLEN, "tiles above the maximum rejected");
+    check(secure_rng_stream(&ctx, 100, 100, &collect, &collected) == RNG_BAD_MAXLEN, "tiles of partial blocks rejected");
+    check(secure_rng_stream(&ctx, 100, 0, NULL, NULL) == RNG_BAD_MAXLEN, "NULL consumer rejected");
+}
+
+int main() {
+    test_contract();
+    test_early_stop();
+    test_policy();
+    test_invalid();
+
+    printf("%s\n", failures ? "stream tests FAILED" : "stream tests passed");
+    return failures != 0;
+}
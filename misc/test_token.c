@@ -0,0 +1,130 @@
+#include "secure-rng.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_LEN   100000
+#define UUIDS     1000
+#define SENTINEL  0x7f
+
+uint8_t fake_entropy[48] = {0};
+
+static char token[MAX_LEN + 2];
+static char uuids[UUIDS * RNG_UUID_STRLEN + 1];
+
+static int failures = 0;
+
+static void check(int condition, const char *what) {
+    if (!condition) {
+        printf("FAILED: %s\n", what);
+        failures++;
+    }
+}
+
+// Length, terminator, no write past it, and only alphabet characters.
+//  Long tokens must use the whole alphabet.
+static void test_alphabet(struct secure_rng_ctx *ctx, const char *alphabet, const char *name) {
+    static const size_t lengths[] = { 0, 1, 2, 15, 16, 17, 31, 32, 33, 47, 48, 49, 63, 64, 65, 100, 1000, 4097, MAX_LEN };
+    size_t size = strlen(alphabet);
+    char what[96];
+    int bad = 0;
+
+    for (size_t i = 0; i < sizeof(lengths) / sizeof(lengths[0]); ++i) {
+        size_t len = lengths[i];
+        size_t seen[256] = {0}, used = 0;
+
+        memset(token, SENTINEL, sizeof(token));
+        bad += secure_rng_token(ctx, alphabet, token, len) != RNG_SUCCESS;
+        bad += token[len] != '\0' || token[len + 1] != SENTINEL || strlen(token) != len;
+
+        for (size_t j = 0; j < len; ++j) {
+            bad += memchr(alphabet, token[j], size) == NULL;
+            seen[(uint8_t)token[j]]++;
+        }
+        for (size_t c = 0; c < 256; ++c) {
+            used += seen[c] != 0;
+        }
+        if (len == MAX_LEN) {
+            bad += used != size;
+        }
+    }
+
+    snprintf(what, sizeof(what), "%s tokens", name);
+    check(bad == 0, what);
+}
+
+static void test_invalid(struct secure_rng_ctx *ctx) {
+    check(secure_rng_token(ctx, "abca", token, 16) == RNG_BAD_MAXLEN, "duplicate characters rejected");
+    check(secure_rng_token(ctx, "0123456789abcdeff", token, 16) == RNG_BAD_MAXLEN, "hex with a duplicate rejected");
+    check(secure_rng_token(ctx, "a", token, 16) == RNG_BAD_MAXLEN, "single character rejected");
+    check(secure_rng_token(ctx, "", token, 16) == RNG_BAD_MAXLEN, "empty alphabet rejected");
+    check(secure_rng_token(ctx, NULL, token, 16) == RNG_BAD_MAXLEN, "NULL alphabet rejected");
+    check(secure_rng_token(ctx, RNG_ALPHABET_HEX, NULL, 16) == RNG_BAD_MAXLEN, "NULL output rejected");
+}
+
+static int is_lower_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+}
+
+// xxxxxxxx-xxxx-4xxx-Vxxx-xxxxxxxxxxxx, V one of 8, 9, a and b
+static void test_uuid(struct secure_rng_ctx *ctx) {
+    int variants[4] = {0};
+    int bad = 0;
+
+    memset(uuids, SENTINEL, sizeof(uuids));
+    check(secure_rng_uuid4_batch(ctx, uuids, UUIDS) == RNG_SUCCESS, "uuids generated");
+    check(uuids[UUIDS * RNG_UUID_STRLEN] == SENTINEL, "no write past the last uuid");
+
+    for (size_t i = 0; i < UUIDS; ++i) {
+        const char *uuid = uuids + i * RNG_UUID_STRLEN;
+
+        bad += uuid[RNG_UUID_STRLEN - 1] != '\0' || strlen(uuid) != RNG_UUID_STRLEN - 1;
+        for (int j = 0; j < RNG_UUID_STRLEN - 1; ++j) {
+            bad += (j == 8 || j == 13 || j == 18 || j == 23) ? uuid[j] != '-' : !is_lower_hex(uuid[j]);
+        }
+        bad += uuid[14] != '4';
+
+        const char *variant = memchr("89ab", uuid[19], 4);
+        bad += variant == NULL;
+        if (variant != NULL) {
+            variants[variant - "89ab"]++;
+        }
+    }
+    check(bad == 0, "uuid layout, version and variant");
+    check(variants[0] && variants[1] && variants[2] && variants[3], "all uuid variant nibbles occur");
+
+    // Batches which aren't a multiple of the internal one
+    memset(uuids, SENTINEL, sizeof(uuids));
+    check(secure_rng_uuid4_batch(ctx, uuids, 3) == RNG_SUCCESS && uuids[3 * RNG_UUID_STRLEN] == SENTINEL, "short uuid batch");
+    memset(uuids, SENTINEL, sizeof(uuids));
+    check(secure_rng_uuid4_batch(ctx, uuids, 0) == RNG_SUCCESS && uuids[0] == SENTINEL, "empty uuid batch");
+}
+
+int main() {
+    struct secure_rng_ctx ctx;
+    char wide[256];
+
+    if (RNG_SUCCESS != secure_rng_seed(&ctx, fake_entropy, NULL, 0)) {
+        printf("secure_rng_seed() failed\n");
+        return -1;
+    }
+
+    // Every non-NUL byte value
+    for (int c = 1; c < 256; ++c) {
+        wide[c - 1] = (char)c;
+    }
+    wide[255] = '\0';
+
+    test_alphabet(&ctx, RNG_ALPHABET_HEX, "hex");
+    test_alphabet(&ctx, RNG_ALPHABET_BASE64URL, "base64url");
+    test_alphabet(&ctx, RNG_ALPHABET_BASE62, "base62");
+    test_alphabet(&ctx, "ACGT", "custom 4");
+    test_alphabet(&ctx, "!#%&*+?@", "custom 8");
+    test_alphabet(&ctx, "23456789abcdefghjkmnpqrstuvwxyz", "custom 31");
+    test_alphabet(&ctx, wide, "custom 255");
+    test_invalid(&ctx);
+    test_uuid(&ctx);
+
+    printf("%s\n", failures ? "token tests FAILED" : "token tests passed");
+    return failures != 0;
+}
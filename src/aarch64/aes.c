@@ -97,7 +97,13 @@ static int32x4_t increment_be_neon(int32x4_t x) {
     return vreinterpretq_s32_u8(vrev32q_u8(vreinterpretq_u8_s32(x)));
 }
 
-void aesctr256_direct_x4 (uint8_t *out, const uint8x16_t *rkeys, const void *counter, size_t bytes) {
+// Keystream is either stored or XORed into the output, xor_out
+//  is a constant in each caller so the branch is folded away
+#define STORE_BLOCK(p, s) \
+    vst1q_u8 ((uint8_t *)(p), xor_out ? veorq_u8 (vld1q_u8 ((const uint8_t *)(p)), (s)) : (s))
+
+static inline __attribute__ ((always_inline))
+void aesctr256_direct_x4 (uint8_t *out, const uint8x16_t *rkeys, const void *counter, size_t bytes, int xor_out) {
     uint8x16_t s1, s2, s3, s4;
     int32x4_t ctr, *bo;
     /* bytes will always be a multiple of 16 */
@@ -177,10 +183,10 @@ void aesctr256_direct_x4 (uint8_t *out, const uint8x16_t *rkeys, const void *cou
         s3 = s3 ^ rkeys[14];
         s4 = s4 ^ rkeys[14];
 
-        vst1q_s32((int32_t*)(bo + i), vreinterpretq_s32_u8(s1));
-        vst1q_s32((int32_t*)(bo + i + 1), vreinterpretq_s32_u8(s2));
-        vst1q_s32((int32_t*)(bo + i + 2), vreinterpretq_s32_u8(s3));
-        vst1q_s32((int32_t*)(bo + i + 3), vreinterpretq_s32_u8(s4));
+        STORE_BLOCK(bo + i, s1);
+        STORE_BLOCK(bo + i + 1, s2);
+        STORE_BLOCK(bo + i + 2, s3);
+        STORE_BLOCK(bo + i + 3, s4);
 
     }
 
@@ -203,7 +209,7 @@ void aesctr256_direct_x4 (uint8_t *out, const uint8x16_t *rkeys, const void *cou
 
         s1 = s1 ^ rkeys[14];
 
-        vst1q_s32((int32_t*)(bo + blocks_parallel + i), vreinterpretq_s32_u8(s1));
+        STORE_BLOCK(bo + blocks_parallel + i, s1);
 
     }
 }
@@ -216,7 +222,13 @@ void aesctr256_zeroiv_hardware (uint8_t *out, const uint8_t *sk, int bytes) {
 void aesctr256_hardware (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
     uint8x16_t rkeys[15];
     expand256 (rkeys, (uint8x16_t *)k);
-    aesctr256_direct_x4 (out, rkeys, counter, bytes);
+    aesctr256_direct_x4 (out, rkeys, counter, bytes, 0);
+}
+
+void aesctr256_xor_hardware (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+    uint8x16_t rkeys[15];
+    expand256 (rkeys, (uint8x16_t *)k);
+    aesctr256_direct_x4 (out, rkeys, counter, bytes, 1);
 }
 
 #ifdef TRY_COMPILE
@@ -4,14 +4,50 @@
 #include <asm/hwcap.h>
 #endif
 
-extern "C" {
+#include "aes.h"
 
-int aes_hardware_supported() {
+// Marks cached detection result
+#define FEATURES_DETECTED (1u << 31)
+
+static unsigned detect_features() {
 #ifdef __linux
-    return getauxval(AT_HWCAP) & HWCAP_AES; // Use HWCAP on linux
+    // Use HWCAP on linux
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    unsigned features = 0;
+
+    if (hwcap & HWCAP_AES) {
+        features |= AES_FEATURE_AES;
+    }
+    if (hwcap & HWCAP_PMULL) {
+        features |= AES_FEATURE_PMULL;
+    }
+#ifdef HWCAP2_SVEAES
+    if (getauxval(AT_HWCAP2) & HWCAP2_SVEAES) {
+        features |= AES_FEATURE_SVEAES;
+    }
+#endif
+    return features;
 #else
-    return true; // No detection for now
+    return AES_FEATURE_AES; // No detection for now
 #endif
 }
 
+extern "C" {
+
+unsigned aes_cpu_features() {
+    // Query auxiliary vector only once, racing threads
+    //  would store the same value anyway
+    static unsigned cache = 0;
+    unsigned features = __atomic_load_n(&cache, __ATOMIC_RELAXED);
+    if (features == 0) {
+        features = detect_features() | FEATURES_DETECTED;
+        __atomic_store_n(&cache, features, __ATOMIC_RELAXED);
+    }
+    return features & ~FEATURES_DETECTED;
+}
+
+int aes_hardware_supported() {
+    return (aes_cpu_features() & AES_FEATURE_AES) != 0;
+}
+
 }
@@ -0,0 +1,266 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "aes.h"
+#include "secure-rng.h"
+
+#ifdef STATIC_BACKEND
+
+// Nothing to choose from
+int secure_rng_autotune(const char *path) {
+    (void)path;
+    return RNG_NOT_SUPPORTED;
+}
+
+int secure_rng_get_plan(struct secure_rng_plan *plan) {
+    (void)plan;
+    return RNG_NOT_SUPPORTED;
+}
+
+#else
+
+#define TUNE_PLAN_VERSION 1
+#define TUNE_TRIALS       3
+#define TUNE_BUDGET       65536    // bytes per trial
+
+// Upper bounds of kernel invocation sizes, the last class
+//  covers the largest whole block part of a request
+static const uint32_t tune_class_bytes[RNG_PLAN_CLASSES] = { 128, 1024, 16384, 65536 };
+
+// Sizes measured for each class: remainder and state update
+//  of a short request, then typical bulk lengths
+static const int tune_sample_bytes[RNG_PLAN_CLASSES] = { 112, 1024, 16384, 65536 };
+
+// Candidates in order of preference, they differ in the number of
+//  blocks interleaved per iteration: 16, 8, 4 and 1 respectively
+static const int tune_backends[] = {
+    RNG_BACKEND_VAES512, RNG_BACKEND_VAES256, RNG_BACKEND_HARDWARE, RNG_BACKEND_SOFTWARE,
+};
+
+struct tune_plan {
+    struct secure_rng_plan report;
+    aesctr256_fn function[RNG_PLAN_CLASSES];
+    aesctr256_fn xor_function[RNG_PLAN_CLASSES];
+};
+
+static pthread_mutex_t tune_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct tune_plan tune_storage;
+
+// Published once and never changed afterwards
+static const struct tune_plan *tune_active = NULL;
+
+// Same kernel for all classes if the plan doesn't need dispatching
+static aesctr256_fn tune_uniform = NULL;
+
+static unsigned tune_features(void) {
+#ifdef HARDWARE_SUPPORT
+    return aes_cpu_features();
+#else
+    return 0;
+#endif
+}
+
+static uint64_t tune_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Best of a few trials in MB/s, counter low bits start
+//  from zero so that no sample size may wrap them
+static uint32_t tune_measure(aesctr256_fn function, uint8_t *buffer, int bytes) {
+    uint8_t key[32] = {0};
+    uint8_t counter[16] __attribute__ ((aligned (16))) = {0};
+    int iterations = (bytes < TUNE_BUDGET) ? TUNE_BUDGET / bytes : 1;
+    uint64_t best = UINT64_MAX;
+
+    // Warm up caches and wake up wide vector units
+    function(buffer, key, counter, bytes);
+
+    for (int trial = 0; trial < TUNE_TRIALS; ++trial) {
+        uint64_t start = tune_now_ns();
+        for (int i = 0; i < iterations; ++i) {
+            function(buffer, key, counter, bytes);
+        }
+        uint64_t elapsed = tune_now_ns() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    if (best == 0) {
+        best = 1;
+    }
+
+    uint64_t mbps = (uint64_t)bytes * iterations * 1000 / best;
+    return (mbps > UINT32_MAX) ? UINT32_MAX : (uint32_t)mbps;
+}
+
+static int tune_run(struct tune_plan *plan) {
+    uint8_t *buffer = aligned_alloc(64, TUNE_BUDGET);
+
+    if (buffer == NULL) {
+        return RNG_NOT_SUPPORTED;
+    }
+
+    for (int c = 0; c < RNG_PLAN_CLASSES; ++c) {
+        plan->report.max_bytes[c] = tune_class_bytes[c];
+        plan->report.backend[c] = RNG_BACKEND_AUTO;
+        plan->report.mbps[c] = 0;
+        plan->function[c] = NULL;
+
+        // Earlier candidate wins a tie
+        for (size_t i = 0; i < sizeof(tune_backends) / sizeof(tune_backends[0]); ++i) {
+            aesctr256_fn function = aes_backend_function(tune_backends[i]);
+            if (function == NULL) {
+                continue;
+            }
+
+            uint32_t mbps = tune_measure(function, buffer, tune_sample_bytes[c]);
+            if (mbps > plan->report.mbps[c] || plan->function[c] == NULL) {
+                plan->report.backend[c] = tune_backends[i];
+                plan->report.mbps[c] = mbps;
+                plan->function[c] = function;
+            }
+        }
+    }
+
+    free(buffer);
+    return RNG_SUCCESS;
+}
+
+// Plans of other machines or library builds are rejected
+static int tune_load(struct tune_plan *plan, const char *path) {
+    unsigned version, features;
+    int result = RNG_IO_ERROR;
+    FILE *file = fopen(path, "r");
+
+    if (file == NULL) {
+        return RNG_IO_ERROR;
+    }
+
+    if (fscanf(file, "secure-rng-plan %u %x", &version, &features) == 2
+            && version == TUNE_PLAN_VERSION && features == tune_features()) {
+        result = RNG_SUCCESS;
+        for (int c = 0; c < RNG_PLAN_CLASSES && result == RNG_SUCCESS; ++c) {
+            struct secure_rng_plan *report = &plan->report;
+            if (fscanf(file, "%u %d %u", &report->max_bytes[c], &report->backend[c], &report->mbps[c]) != 3
+                    || report->max_bytes[c] != tune_class_bytes[c]
+                    || report->backend[c] == RNG_BACKEND_AUTO || report->backend[c] == RNG_BACKEND_TUNED
+                    || (plan->function[c] = aes_backend_function(report->backend[c])) == NULL) {
+                result = RNG_IO_ERROR;
+            }
+        }
+    }
+
+    fclose(file);
+    return result;
+}
+
+// Write a temporary file and rename it, so that concurrent
+//  readers never see a partially written plan
+static int tune_save(const struct tune_plan *plan, const char *path) {
+    char temporary[4096];
+    FILE *file;
+    int failed;
+
+    if (snprintf(temporary, sizeof(temporary), "%s.tmp", path) >= (int)sizeof(temporary)) {
+        return RNG_IO_ERROR;
+    }
+
+    file = fopen(temporary, "w");
+    if (file == NULL) {
+        return RNG_IO_ERROR;
+    }
+
+    failed = fprintf(file, "secure-rng-plan %u %x\n", TUNE_PLAN_VERSION, tune_features()) < 0;
+    for (int c = 0; c < RNG_PLAN_CLASSES; ++c) {
+        failed |= fprintf(file, "%u %d %u\n", plan->report.max_bytes[c], plan->report.backend[c], plan->report.mbps[c]) < 0;
+    }
+    failed |= fclose(file) != 0;
+
+    if (failed || rename(temporary, path) != 0) {
+        remove(temporary);
+        return RNG_IO_ERROR;
+    }
+
+    return RNG_SUCCESS;
+}
+
+int secure_rng_autotune(const char *path) {
+    int result = RNG_SUCCESS;
+    int loaded = 0;
+
+    pthread_mutex_lock(&tune_lock);
+
+    if (tune_active == NULL) {
+        loaded = (path != NULL && tune_load(&tune_storage, path) == RNG_SUCCESS);
+        if (!loaded) {
+            result = tune_run(&tune_storage);
+        }
+
+        if (result == RNG_SUCCESS) {
+            tune_uniform = tune_storage.function[0];
+            for (int c = 0; c < RNG_PLAN_CLASSES; ++c) {
+                tune_storage.xor_function[c] = aes_backend_xor_function(tune_storage.function[c]);
+                if (tune_storage.function[c] != tune_uniform) {
+                    tune_uniform = &aesctr256_tuned;
+                }
+            }
+            __atomic_store_n(&tune_active, &tune_storage, __ATOMIC_RELEASE);
+        }
+    }
+
+    // Plan is in effect even if it couldn't be persisted
+    if (result == RNG_SUCCESS && path != NULL && !loaded) {
+        result = tune_save(&tune_storage, path);
+    }
+
+    pthread_mutex_unlock(&tune_lock);
+    return result;
+}
+
+int secure_rng_get_plan(struct secure_rng_plan *plan) {
+    const struct tune_plan *active = __atomic_load_n(&tune_active, __ATOMIC_ACQUIRE);
+
+    if (active == NULL) {
+        return RNG_NOT_SUPPORTED;
+    }
+
+    *plan = active->report;
+    return RNG_SUCCESS;
+}
+
+aesctr256_fn aes_tuned_function(void) {
+    if (__atomic_load_n(&tune_active, __ATOMIC_ACQUIRE) == NULL) {
+        return NULL;
+    }
+
+    return tune_uniform;
+}
+
+void aesctr256_tuned(uint8_t *out, const uint8_t *sk, const void *counter, int bytes) {
+    // Contexts only get here after the plan is published
+    const struct tune_plan *plan = __atomic_load_n(&tune_active, __ATOMIC_ACQUIRE);
+    int c = 0;
+
+    while (c < RNG_PLAN_CLASSES - 1 && (uint32_t)bytes > plan->report.max_bytes[c]) {
+        ++c;
+    }
+
+    plan->function[c](out, sk, counter, bytes);
+}
+
+void aesctr256_xor_tuned(uint8_t *out, const uint8_t *sk, const void *counter, int bytes) {
+    const struct tune_plan *plan = __atomic_load_n(&tune_active, __ATOMIC_ACQUIRE);
+    int c = 0;
+
+    while (c < RNG_PLAN_CLASSES - 1 && (uint32_t)bytes > plan->report.max_bytes[c]) {
+        ++c;
+    }
+
+    plan->xor_function[c](out, sk, counter, bytes);
+}
+
+#endif
@@ -0,0 +1,198 @@
+#include <string.h>
+#include "bits.h"
+#include "fork.h"
+#include "secure-rng.h"
+#include "wipe.h"
+
+#define BITS_MAX_DRAW       32
+#define BITS_SMALL_ARRAY    64         // bytes served from the reservoir
+#define BITS_REQUEST        65520      // whole blocks, served by the bulk path
+
+void rng_bits_discard(struct secure_rng_ctx *ctx) {
+    rng_wipe(ctx->bit_words, sizeof(ctx->bit_words));
+    ctx->bit_word = 0;
+    ctx->bit_count = 0;
+    ctx->bit_position = RNG_BIT_WORDS;
+}
+
+// Load the next word, words are wiped as they're taken
+//  and consumed bits are shifted out of bit_word
+static int bits_refill(struct secure_rng_ctx *ctx) {
+    // Reservoir bits must not be shared with the parent process
+    if (rng_forked(ctx->fork_generation)) {
+        rng_bits_discard(ctx);
+    }
+
+    if (ctx->bit_position == RNG_BIT_WORDS) {
+        int result = secure_rng_bytes(ctx, (uint8_t *)ctx->bit_words, sizeof(ctx->bit_words), 0);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+        ctx->bit_position = 0;
+    }
+
+    ctx->bit_word = ctx->bit_words[ctx->bit_position];
+    ctx->bit_words[ctx->bit_position++] = 0;
+    ctx->bit_count = 64;
+    return RNG_SUCCESS;
+}
+
+static inline int bits_ready(const struct secure_rng_ctx *ctx) {
+    return __builtin_expect(ctx->bit_count != 0 && !rng_forked(ctx->fork_generation), 1);
+}
+
+// Drop the top n bits, n may be a whole word
+static inline uint64_t bits_shift(uint64_t word, unsigned n) {
+    return (n < 64) ? word << n : 0;
+}
+
+int secure_rng_bit(struct secure_rng_ctx *ctx) {
+    if (!bits_ready(ctx)) {
+        int result = bits_refill(ctx);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+    }
+
+    int bit = (int)(ctx->bit_word >> 63);
+    ctx->bit_word <<= 1;
+    ctx->bit_count--;
+    return bit;
+}
+
+int64_t secure_rng_bits(struct secure_rng_ctx *ctx, unsigned nbits) {
+    uint64_t value = 0;
+
+    if (nbits == 0) {
+        return 0;
+    }
+    if (nbits > BITS_MAX_DRAW) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    // Leftover bits of the word are the top of the value
+    if (!bits_ready(ctx) || ctx->bit_count < nbits) {
+        if (bits_ready(ctx)) {
+            value = ctx->bit_word >> (64 - ctx->bit_count);
+            nbits -= ctx->bit_count;
+        }
+        int result = bits_refill(ctx);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+    }
+
+    value = (value << nbits) | (ctx->bit_word >> (64 - nbits));
+    ctx->bit_word <<= nbits;
+    ctx->bit_count -= nbits;
+    return (int64_t)value;
+}
+
+// Split p in (0, 1) into an integer mantissa and a shift,
+//  so that p = mantissa * 2^-shift
+static inline uint64_t bits_mantissa(double p, int *shift) {
+    uint64_t raw;
+    memcpy(&raw, &p, sizeof(raw));
+
+    int exponent = (int)(raw >> 52);
+    uint64_t mantissa = raw & ((UINT64_C(1) << 52) - 1);
+
+    // Subnormals have no implicit bit
+    if (exponent == 0) {
+        *shift = 1074;
+        return mantissa;
+    }
+    *shift = 1075 - exponent;
+    return mantissa | (UINT64_C(1) << 52);
+}
+
+// Bits 64 * chunk + 1 to 64 * chunk + 64 of the binary
+//  expansion of p, the first one in the top bit
+static inline uint64_t bits_expansion(uint64_t mantissa, int shift, int chunk) {
+    int left = 64 * (chunk + 1) - shift;
+
+    if (left >= 64 || left <= -64) {
+        return 0;
+    }
+    return (left >= 0) ? mantissa << left : mantissa >> -left;
+}
+
+// Compares a uniform U in [0, 1) with p, bit by bit from the top,
+//  and returns whether U < p. The first bit where they differ decides,
+//  which takes two reservoir bits on average for any p.
+int secure_rng_bernoulli(struct secure_rng_ctx *ctx, double p) {
+    uint64_t expansion = 0, mantissa;
+    unsigned expansion_bits = 0;
+    int shift, chunk = 0;
+
+    // NaN is never true
+    if (!(p > 0)) {
+        return 0;
+    }
+    if (p >= 1) {
+        return 1;
+    }
+
+    mantissa = bits_mantissa(p, &shift);
+    for (;;) {
+        if (!bits_ready(ctx)) {
+            int result = bits_refill(ctx);
+            if (result != RNG_SUCCESS) {
+                return result;
+            }
+        }
+        if (expansion_bits == 0) {
+            expansion = bits_expansion(mantissa, shift, chunk++);
+            expansion_bits = 64;
+        }
+
+        unsigned n = (ctx->bit_count < expansion_bits) ? ctx->bit_count : expansion_bits;
+        uint64_t differ = (ctx->bit_word ^ expansion) & (~UINT64_C(0) << (64 - n));
+
+        if (differ) {
+            unsigned position = (unsigned)__builtin_clzll(differ);
+            ctx->bit_word = bits_shift(ctx->bit_word, position + 1);
+            ctx->bit_count -= position + 1;
+            return (int)((expansion >> (63 - position)) & 1);
+        }
+
+        ctx->bit_word = bits_shift(ctx->bit_word, n);
+        ctx->bit_count -= n;
+        expansion = bits_shift(expansion, n);
+        expansion_bits -= n;
+    }
+}
+
+int secure_rng_bit_array(struct secure_rng_ctx *ctx, uint8_t *out, size_t nbits) {
+    size_t nbytes = nbits / 8 + (nbits % 8 != 0);
+
+    // Short arrays would cost a whole generator invocation
+    if (nbytes <= BITS_SMALL_ARRAY) {
+        for (size_t i = 0; i < nbytes; i += 4) {
+            int64_t value = secure_rng_bits(ctx, BITS_MAX_DRAW);
+            if (value < 0) {
+                memset(out, 0, nbytes);
+                return (int)value;
+            }
+            uint32_t word = (uint32_t)value;
+            memcpy(out + i, &word, (nbytes - i < 4) ? nbytes - i : 4);
+        }
+    }
+    else {
+        for (size_t done = 0; done < nbytes; done += BITS_REQUEST) {
+            size_t len = (nbytes - done < BITS_REQUEST) ? nbytes - done : BITS_REQUEST;
+            int result = secure_rng_bytes(ctx, out + done, len, 0);
+            if (result != RNG_SUCCESS) {
+                memset(out, 0, nbytes);
+                return result;
+            }
+        }
+    }
+
+    // Bits past the end are cleared
+    if (nbits % 8) {
+        out[nbytes - 1] &= (uint8_t)((1u << (nbits % 8)) - 1);
+    }
+
+    return RNG_SUCCESS;
+}
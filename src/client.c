@@ -0,0 +1,229 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "fork.h"
+#include "ring.h"
+#include "secure-rng.h"
+#include "secure-rng-client.h"
+#include "wipe.h"
+
+struct secure_rng_client {
+    int fd;
+    uint64_t fork_generation;
+    struct rng_ring *ring;
+    size_t map_size;
+    uint64_t size;
+    char path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+};
+
+// Only trust a daemon run by root or by ourselves, the default
+//  socket lives in a world writable directory
+static int client_trusted(int fd) {
+    struct ucred credentials;
+    socklen_t length = sizeof(credentials);
+
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &length) != 0) {
+        return 0;
+    }
+    return credentials.uid == 0 || credentials.uid == getuid();
+}
+
+// Receive the ring memory file descriptor along with its description
+static int client_receive(struct secure_rng_client *client) {
+    struct {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t map_size;
+    } hello;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr message;
+    struct cmsghdr *cmsg;
+    int memory_fd = -1;
+    ssize_t result;
+
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    do {
+        result = recvmsg(client->fd, &message, MSG_CMSG_CLOEXEC);
+    } while (result < 0 && errno == EINTR);
+
+    cmsg = CMSG_FIRSTHDR(&message);
+    if (cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        memcpy(&memory_fd, CMSG_DATA(cmsg), sizeof(int));
+    }
+    if (memory_fd < 0) {
+        return -1;
+    }
+
+    if (result != (ssize_t)sizeof(hello) || hello.magic != RING_MAGIC || hello.version != RING_VERSION
+            || hello.map_size <= sizeof(struct rng_ring) || hello.map_size > SIZE_MAX) {
+        close(memory_fd);
+        return -1;
+    }
+
+    client->map_size = (size_t)hello.map_size;
+    client->ring = mmap(NULL, client->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+    close(memory_fd);
+    if (client->ring == MAP_FAILED) {
+        client->ring = NULL;
+        return -1;
+    }
+
+    // Data size must match the mapping and be a power of two
+    client->size = client->ring->size;
+    if (client->size != client->map_size - sizeof(struct rng_ring) || (client->size & (client->size - 1)) != 0) {
+        munmap(client->ring, client->map_size);
+        client->ring = NULL;
+        return -1;
+    }
+
+    return 0;
+}
+
+static int client_connect(struct secure_rng_client *client) {
+    struct sockaddr_un address;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, client->path, sizeof(address.sun_path));
+
+    client->fork_generation = rng_fork_generation();
+    client->ring = NULL;
+    client->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (client->fd < 0) {
+        return -1;
+    }
+
+    if (connect(client->fd, (struct sockaddr *)&address, sizeof(address)) != 0
+            || !client_trusted(client->fd) || client_receive(client) != 0) {
+        close(client->fd);
+        client->fd = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void client_disconnect(struct secure_rng_client *client) {
+    if (client->ring != NULL) {
+        munmap(client->ring, client->map_size);
+        client->ring = NULL;
+    }
+    if (client->fd >= 0) {
+        close(client->fd);
+        client->fd = -1;
+    }
+}
+
+// Block until the daemon has refilled the ring
+static int client_wait(struct secure_rng_client *client) {
+    char request = RING_WAIT, reply;
+    ssize_t result;
+
+    do {
+        result = send(client->fd, &request, 1, MSG_NOSIGNAL);
+    } while (result < 0 && errno == EINTR);
+    if (result != 1) {
+        return -1;
+    }
+
+    do {
+        result = recv(client->fd, &reply, 1, 0);
+    } while (result < 0 && errno == EINTR);
+
+    return (result == 1 && reply == RING_READY) ? 0 : -1;
+}
+
+struct secure_rng_client *secure_rng_client_open(const char *socket_path) {
+    struct secure_rng_client *client;
+
+    if (socket_path == NULL) {
+        socket_path = getenv("SECURE_RNG_SOCKET");
+    }
+    if (socket_path == NULL) {
+        socket_path = SECURE_RNG_DEFAULT_SOCKET;
+    }
+
+    client = calloc(1, sizeof(struct secure_rng_client));
+    if (client == NULL) {
+        return NULL;
+    }
+
+    if (strlen(socket_path) >= sizeof(client->path) || (strcpy(client->path, socket_path), client_connect(client)) != 0) {
+        free(client);
+        return NULL;
+    }
+
+    return client;
+}
+
+int secure_rng_client_bytes(struct secure_rng_client *client, uint8_t *x, size_t xlen) {
+    struct rng_ring *ring;
+
+    // A forked child must not consume from the parent's ring, checking
+    //  the marker is cheaper than calling getpid(). Reconnect also after
+    //  a failed attempt.
+    if (client->ring == NULL || client->fork_generation != *rng_fork_marker) {
+        client_disconnect(client);
+        if (client_connect(client) != 0) {
+            return RNG_IO_ERROR;
+        }
+    }
+
+    ring = client->ring;
+    while (xlen) {
+        // Client is the only writer of the tail
+        uint64_t tail = ring->tail;
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        size_t offset = (size_t)(tail & (client->size - 1));
+        size_t len = (size_t)(head - tail);
+
+        if (len == 0) {
+            if (client_wait(client) != 0) {
+                return RNG_IO_ERROR;
+            }
+            continue;
+        }
+
+        if (len > client->size - offset) len = client->size - offset;
+        if (len > xlen) len = xlen;
+
+        // Served bytes don't stay in the ring until the next top-up,
+        //  the daemon only writes there again once the tail moves past
+        memcpy(x, ring->data + offset, len);
+        rng_wipe(ring->data + offset, len);
+        tail += len;
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        x += len;
+        xlen -= len;
+
+        // Ask for a top-up early, but only once until it's done
+        if (head - tail < RING_LOW_WATER(client->size) && !__atomic_exchange_n(&ring->refill_pending, 1, __ATOMIC_ACQ_REL)) {
+            char request = RING_REFILL;
+            if (send(client->fd, &request, 1, MSG_NOSIGNAL | MSG_DONTWAIT) != 1) {
+                __atomic_store_n(&ring->refill_pending, 0, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    return RNG_SUCCESS;
+}
+
+void secure_rng_client_close(struct secure_rng_client *client) {
+    if (client == NULL) {
+        return;
+    }
+
+    client_disconnect(client);
+    free(client);
+}
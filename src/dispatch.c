@@ -0,0 +1,124 @@
+#include "aes.h"
+#include "secure-rng.h"
+
+#ifdef STATIC_BACKEND
+
+// Backend is pinned at compile time, nothing to detect
+
+aesctr256_fn aes_backend_function(int backend) {
+    if (backend == RNG_BACKEND_AUTO || backend == STATIC_BACKEND_ID) {
+        return &STATIC_BACKEND;
+    }
+
+    return NULL;
+}
+
+int aes_backend_id(aesctr256_fn function) {
+    return (function == &STATIC_BACKEND) ? STATIC_BACKEND_ID : RNG_BACKEND_AUTO;
+}
+
+aesctr256_fn aes_backend_xor_function(aesctr256_fn function) {
+    return (function == &STATIC_BACKEND) ? &STATIC_BACKEND_XOR : NULL;
+}
+
+#else
+
+struct aes_backend {
+    int id;
+    aesctr256_fn function;
+    aesctr256_fn xor_function;
+    unsigned features;
+};
+
+// Backends in order of preference
+static const struct aes_backend aes_backends[] = {
+#ifdef HARDWARE_VAES
+    { RNG_BACKEND_VAES512, &aesctr256_vaes512, &aesctr256_xor_vaes512, AES_FEATURE_AES | AES_FEATURE_VAES | AES_FEATURE_AVX512 },
+    { RNG_BACKEND_VAES256, &aesctr256_vaes256, &aesctr256_xor_vaes256, AES_FEATURE_AES | AES_FEATURE_VAES | AES_FEATURE_AVX2 },
+#endif
+#ifdef HARDWARE_SUPPORT
+    { RNG_BACKEND_HARDWARE, &aesctr256_hardware, &aesctr256_xor_hardware, AES_FEATURE_AES },
+#endif
+    { RNG_BACKEND_SOFTWARE, &aesctr256_software, &aesctr256_xor_software, 0 },
+};
+
+#define AES_BACKENDS_COUNT (sizeof(aes_backends) / sizeof(aes_backends[0]))
+
+// Chosen once per process
+static aesctr256_fn aes_best_function = NULL;
+
+static int aes_backend_supported(const struct aes_backend *backend) {
+#ifdef HARDWARE_SUPPORT
+    return (aes_cpu_features() & backend->features) == backend->features;
+#else
+    return backend->features == 0;
+#endif
+}
+
+aesctr256_fn aes_backend_function(int backend) {
+    aesctr256_fn function;
+
+    if (backend == RNG_BACKEND_TUNED) {
+        return (aes_tuned_function() != NULL) ? &aesctr256_tuned : NULL;
+    }
+
+    if (backend == RNG_BACKEND_AUTO) {
+        // Autotuner's plan takes precedence once available
+        function = aes_tuned_function();
+        if (function != NULL) {
+            return function;
+        }
+
+        function = __atomic_load_n(&aes_best_function, __ATOMIC_RELAXED);
+        if (function == NULL) {
+            // The first supported one is the best one, racing
+            //  threads would store the same value anyway
+            for (size_t i = 0; i < AES_BACKENDS_COUNT; ++i) {
+                if (aes_backend_supported(&aes_backends[i])) {
+                    function = aes_backends[i].function;
+                    break;
+                }
+            }
+            __atomic_store_n(&aes_best_function, function, __ATOMIC_RELAXED);
+        }
+        return function;
+    }
+
+    for (size_t i = 0; i < AES_BACKENDS_COUNT; ++i) {
+        if (aes_backends[i].id == backend) {
+            return aes_backend_supported(&aes_backends[i]) ? aes_backends[i].function : NULL;
+        }
+    }
+
+    return NULL;
+}
+
+int aes_backend_id(aesctr256_fn function) {
+    if (function == &aesctr256_tuned) {
+        return RNG_BACKEND_TUNED;
+    }
+
+    for (size_t i = 0; i < AES_BACKENDS_COUNT; ++i) {
+        if (aes_backends[i].function == function) {
+            return aes_backends[i].id;
+        }
+    }
+
+    return RNG_BACKEND_AUTO;
+}
+
+aesctr256_fn aes_backend_xor_function(aesctr256_fn function) {
+    if (function == &aesctr256_tuned) {
+        return &aesctr256_xor_tuned;
+    }
+
+    for (size_t i = 0; i < AES_BACKENDS_COUNT; ++i) {
+        if (aes_backends[i].function == function) {
+            return aes_backends[i].xor_function;
+        }
+    }
+
+    return NULL;
+}
+
+#endif
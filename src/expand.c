@@ -0,0 +1,114 @@
+#include <string.h>
+#include "aes.h"
+#include "secure-rng.h"
+#include "wipe.h"
+
+// Bytes per kernel invocation, a multiple of the block size
+#define EXPAND_CHUNK 65536
+
+// Short reads are served from covering blocks on the stack
+#define EXPAND_SMALL 512
+
+// Counter block of the given block index, IV plus index
+//  as a 128-bit big-endian addition
+static void expand_counter(const struct secure_rng_expand_ctx *ctx, uint64_t block, uint8_t counter[16]) {
+    unsigned carry = 0;
+
+    for (int i = 15; i >= 0; --i) {
+        unsigned sum = ctx->IV[i] + (unsigned)(block & 0xff) + carry;
+        counter[i] = (uint8_t)sum;
+        carry = sum >> 8;
+        block >>= 8;
+    }
+}
+
+// Whole blocks starting with the given index. Kernels only carry
+//  within the low 32 bits of the counter, so split where they wrap
+static void expand_blocks(const struct secure_rng_expand_ctx *ctx, uint64_t block, uint8_t *out, size_t bytes) {
+    uint8_t counter[16] __attribute__ ((aligned (16)));
+
+    while (bytes) {
+        expand_counter(ctx, block, counter);
+
+        uint32_t low = ((uint32_t)counter[12] << 24) | ((uint32_t)counter[13] << 16) | ((uint32_t)counter[14] << 8) | counter[15];
+        size_t chunk = (bytes < EXPAND_CHUNK) ? bytes : EXPAND_CHUNK;
+        if (chunk / 16 - 1 > UINT32_MAX - low) {
+            chunk = ((size_t)(UINT32_MAX - low) + 1) * 16;
+        }
+
+        ctx->aesctr256(out, ctx->Key, counter, (int)chunk);
+
+        block += chunk / 16;
+        out += chunk;
+        bytes -= chunk;
+    }
+}
+
+int secure_rng_expand_init(struct secure_rng_expand_ctx *ctx, const uint8_t seed[48], const uint8_t *label, size_t label_len) {
+    struct secure_rng_ctx drbg;
+    uint8_t material[48];
+    int result;
+
+    // Key and IV are the first output of a DRBG instance with
+    //  the label as personalization, so that labels give
+    //  independent streams of the same seed
+    result = secure_rng_seed(&drbg, seed, label, label_len);
+    if (result == RNG_SUCCESS) {
+        result = secure_rng_bytes(&drbg, material, sizeof(material), 0);
+    }
+
+    if (result == RNG_SUCCESS) {
+        memcpy(ctx->Key, material, 32);
+        memcpy(ctx->IV, material + 32, 16);
+        ctx->aesctr256 = drbg.aesctr256;
+    }
+
+    rng_wipe(material, sizeof(material));
+    rng_wipe(&drbg, sizeof(drbg));
+    return result;
+}
+
+int secure_rng_stream_at(const struct secure_rng_expand_ctx *ctx, uint64_t offset, uint8_t *out, size_t len) {
+    uint8_t block[EXPAND_SMALL] __attribute__ ((aligned (16)));
+    uint64_t index = offset / 16;
+    size_t skip = offset % 16;
+
+    // The stream is 2^64 bytes long, so its last byte is at UINT64_MAX
+    if (out == NULL || (len != 0 && len - 1 > UINT64_MAX - offset)) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    // One kernel invocation for the covering blocks
+    if (skip + len <= EXPAND_SMALL) {
+        size_t covering = (skip + len + 15) & ~(size_t)15;
+        expand_blocks(ctx, index, block, covering);
+        memcpy(out, block + skip, len);
+        rng_wipe(block, covering);
+        return RNG_SUCCESS;
+    }
+
+    // Partial block at an unaligned start
+    if (skip) {
+        size_t part = (len < 16 - skip) ? len : 16 - skip;
+        expand_blocks(ctx, index++, block, 16);
+        memcpy(out, block + skip, part);
+        out += part;
+        len -= part;
+    }
+
+    expand_blocks(ctx, index, out, len & ~(size_t)15);
+    index += len / 16;
+
+    // Partial block at the end
+    if (len % 16) {
+        expand_blocks(ctx, index, block, 16);
+        memcpy(out + (len & ~(size_t)15), block, len % 16);
+    }
+
+    rng_wipe(block, 16);
+    return RNG_SUCCESS;
+}
+
+void secure_rng_expand_wipe(struct secure_rng_expand_ctx *ctx) {
+    rng_wipe(ctx, sizeof(*ctx));
+}
@@ -0,0 +1,385 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include "secure-rng.h"
+#include "wipe.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define FILL_IO_URING
+#endif
+#endif
+
+#define FILL_REQUEST        65520      // whole blocks, served by the bulk path
+#define FILL_DEPTH          8
+#define FILL_BUFFER_SIZE    (1 << 20)
+#define FILL_MAX_DEPTH      256
+
+// A buffer and the write it's part of, pending
+//  writes are resubmitted from where they stopped
+struct fill_slot {
+    uint8_t *data;
+    uint64_t offset;
+    uint32_t length;
+    uint32_t written;
+};
+
+struct fill_job {
+    struct secure_rng_ctx *ctx;
+    int fd;
+    uint64_t offset;
+    uint64_t end;
+    uint32_t depth;
+    uint32_t buffer_size;
+    struct fill_slot slots[FILL_MAX_DEPTH];
+};
+
+// Generate the next share of the range into a slot
+static int fill_generate(struct fill_job *job, struct fill_slot *slot) {
+    uint64_t length = job->end - job->offset;
+
+    if (length > job->buffer_size) {
+        length = job->buffer_size;
+    }
+
+    for (uint32_t done = 0; done < length; done += FILL_REQUEST) {
+        size_t len = (length - done < FILL_REQUEST) ? (size_t)(length - done) : FILL_REQUEST;
+        int result = secure_rng_bytes(job->ctx, slot->data + done, len, 0);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+    }
+
+    slot->offset = job->offset;
+    slot->length = (uint32_t)length;
+    slot->written = 0;
+    job->offset += length;
+    return RNG_SUCCESS;
+}
+
+// One buffer at a time, for systems without io_uring
+static int fill_pwrite(struct fill_job *job) {
+    struct fill_slot *slot = &job->slots[0];
+
+    while (job->offset < job->end) {
+        int result = fill_generate(job, slot);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+
+        while (slot->written < slot->length) {
+            ssize_t written = pwrite(job->fd, slot->data + slot->written, slot->length - slot->written,
+                                     (off_t)(slot->offset + slot->written));
+            if (written < 0 && errno == EINTR) {
+                continue;
+            }
+            if (written <= 0) {
+                return RNG_IO_ERROR;
+            }
+            slot->written += (uint32_t)written;
+        }
+    }
+
+    return RNG_SUCCESS;
+}
+
+#ifdef FILL_IO_URING
+
+// Submission and completion rings shared with the kernel,
+//  mapped as described by the io_uring_setup() parameters
+struct fill_ring {
+    int fd;
+    int target;
+    int registered;
+    uint32_t *sq_head, *sq_tail, *sq_mask, *sq_array;
+    uint32_t *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *sq_map, *cq_map;
+    size_t sq_map_size, cq_map_size, sqes_size;
+    struct iovec iov[FILL_MAX_DEPTH];
+};
+
+static void fill_ring_exit(struct fill_ring *ring) {
+    if (ring->sqes != NULL) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_map != NULL && ring->cq_map != ring->sq_map) {
+        munmap(ring->cq_map, ring->cq_map_size);
+    }
+    if (ring->sq_map != NULL) {
+        munmap(ring->sq_map, ring->sq_map_size);
+    }
+    close(ring->fd);
+}
+
+// Returns 0 if io_uring isn't available, e.g. disabled by
+//  seccomp or sysctl, or if the kernel is too old
+static int fill_ring_init(struct fill_ring *ring, struct fill_job *job) {
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(*ring));
+    memset(&params, 0, sizeof(params));
+    ring->target = job->fd;
+
+    ring->fd = (int)syscall(__NR_io_uring_setup, job->depth, &params);
+    if (ring->fd < 0) {
+        return 0;
+    }
+
+    ring->sq_map_size = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring->cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Both rings share one mapping since Linux 5.4
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_map_size > ring->sq_map_size) {
+            ring->sq_map_size = ring->cq_map_size;
+        }
+        ring->cq_map_size = ring->sq_map_size;
+    }
+
+    ring->sq_map = mmap(NULL, ring->sq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_map == MAP_FAILED) {
+        ring->sq_map = NULL;
+        fill_ring_exit(ring);
+        return 0;
+    }
+
+    ring->cq_map = ring->sq_map;
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        ring->cq_map = mmap(NULL, ring->cq_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_map == MAP_FAILED) {
+            ring->cq_map = NULL;
+            fill_ring_exit(ring);
+            return 0;
+        }
+    }
+
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        fill_ring_exit(ring);
+        return 0;
+    }
+
+    uint8_t *sq = ring->sq_map, *cq = ring->cq_map;
+    ring->sq_head = (uint32_t *)(sq + params.sq_off.head);
+    ring->sq_tail = (uint32_t *)(sq + params.sq_off.tail);
+    ring->sq_mask = (uint32_t *)(sq + params.sq_off.ring_mask);
+    ring->sq_array = (uint32_t *)(sq + params.sq_off.array);
+    ring->cq_head = (uint32_t *)(cq + params.cq_off.head);
+    ring->cq_tail = (uint32_t *)(cq + params.cq_off.tail);
+    ring->cq_mask = (uint32_t *)(cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    // Registered buffers stay pinned, which saves mapping them for
+    //  every write. Without them (RLIMIT_MEMLOCK) writes are vectored.
+    for (uint32_t i = 0; i < job->depth; ++i) {
+        ring->iov[i].iov_base = job->slots[i].data;
+        ring->iov[i].iov_len = job->buffer_size;
+    }
+    ring->registered = syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_BUFFERS, ring->iov, job->depth) == 0;
+
+    return 1;
+}
+
+static void fill_ring_queue(struct fill_ring *ring, struct fill_slot *slot, uint32_t index) {
+    uint32_t tail = *ring->sq_tail;
+    struct io_uring_sqe *sqe = &ring->sqes[tail & *ring->sq_mask];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->fd = ring->target;
+    sqe->off = slot->offset + slot->written;
+    sqe->user_data = index;
+
+    if (ring->registered) {
+        sqe->opcode = IORING_OP_WRITE_FIXED;
+        sqe->addr = (uint64_t)(uintptr_t)(slot->data + slot->written);
+        sqe->len = slot->length - slot->written;
+        sqe->buf_index = (uint16_t)index;
+    }
+    else {
+        ring->iov[index].iov_base = slot->data + slot->written;
+        ring->iov[index].iov_len = slot->length - slot->written;
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->addr = (uint64_t)(uintptr_t)&ring->iov[index];
+        sqe->len = 1;
+    }
+
+    ring->sq_array[tail & *ring->sq_mask] = tail & *ring->sq_mask;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+static int fill_ring_enter(struct fill_ring *ring, uint32_t submit, uint32_t wait) {
+    for (;;) {
+        long result = syscall(__NR_io_uring_enter, ring->fd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+        if (result >= 0) {
+            return 0;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return -1;
+        }
+        // Queued entries which weren't consumed stay in the ring
+        submit = *ring->sq_tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    }
+}
+
+// Submit the queued entry, if that fails it's taken back, so that
+//  it doesn't go along with a later wait without being accounted for
+static int fill_ring_submit(struct fill_ring *ring) {
+    if (fill_ring_enter(ring, 1, 0) != 0) {
+        __atomic_store_n(ring->sq_tail, __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        return -1;
+    }
+    return 0;
+}
+
+// Generation of the next buffer overlaps with writes of the others:
+//  each one is submitted right after it's filled, and completions
+//  are only waited for once every slot is in flight
+static int fill_io_uring(struct fill_job *job, struct fill_ring *ring) {
+    uint32_t free_slots[FILL_MAX_DEPTH];
+    uint32_t free_count = job->depth, in_flight = 0;
+    int result = RNG_SUCCESS;
+
+    for (uint32_t i = 0; i < job->depth; ++i) {
+        free_slots[i] = i;
+    }
+
+    while (in_flight || (job->offset < job->end && result == RNG_SUCCESS)) {
+        if (free_count && job->offset < job->end && result == RNG_SUCCESS) {
+            uint32_t index = free_slots[--free_count];
+            result = fill_generate(job, &job->slots[index]);
+            if (result != RNG_SUCCESS) {
+                continue;
+            }
+            fill_ring_queue(ring, &job->slots[index], index);
+            if (fill_ring_submit(ring) != 0) {
+                // No completion will come for this one, but the writes
+                //  in flight still use their buffers
+                result = RNG_IO_ERROR;
+                free_slots[free_count++] = index;
+                continue;
+            }
+            in_flight++;
+            continue;
+        }
+
+        uint32_t head = *ring->cq_head;
+        if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            if (fill_ring_enter(ring, 0, 1) != 0) {
+                // Completions are posted to the ring anyway,
+                //  poll for them instead of waiting
+                result = RNG_IO_ERROR;
+                sched_yield();
+            }
+            continue;
+        }
+
+        struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+        uint32_t index = (uint32_t)cqe->user_data;
+        struct fill_slot *slot = &job->slots[index];
+        int32_t res = cqe->res;
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+        in_flight--;
+
+        if (res == -EINTR || res == -EAGAIN) {
+            res = 0;
+        }
+        else if (res <= 0) {
+            // Let the other writes finish, buffers are still in use
+            result = RNG_IO_ERROR;
+            free_slots[free_count++] = index;
+            continue;
+        }
+
+        slot->written += (uint32_t)res;
+        if (slot->written < slot->length && result == RNG_SUCCESS) {
+            fill_ring_queue(ring, slot, index);
+            if (fill_ring_submit(ring) == 0) {
+                in_flight++;
+                continue;
+            }
+            result = RNG_IO_ERROR;
+        }
+        free_slots[free_count++] = index;
+    }
+
+    return result;
+}
+
+#endif
+
+int secure_rng_fill_fd_ex(struct secure_rng_ctx *ctx, int fd, uint64_t offset, uint64_t len, const struct secure_rng_fill_options *options) {
+    struct fill_job *job;
+    int flags = fcntl(fd, F_GETFL);
+    int result;
+
+    if (flags < 0) {
+        return RNG_IO_ERROR;
+    }
+    if (len > UINT64_MAX - offset) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    job = calloc(1, sizeof(*job));
+    if (job == NULL) {
+        return RNG_IO_ERROR;
+    }
+    job->ctx = ctx;
+    job->fd = fd;
+    job->offset = offset;
+    job->end = offset + len;
+    job->depth = (options && options->queue_depth) ? options->queue_depth : FILL_DEPTH;
+    job->buffer_size = (options && options->buffer_size) ? options->buffer_size : FILL_BUFFER_SIZE;
+
+    // Direct I/O needs aligned buffers, offsets and lengths
+    if (job->depth > FILL_MAX_DEPTH || job->buffer_size % RNG_FILL_ALIGN != 0 || job->buffer_size > (1u << 30) ||
+        ((flags & O_DIRECT) && (offset % RNG_FILL_ALIGN != 0 || len % RNG_FILL_ALIGN != 0))) {
+        free(job);
+        return RNG_BAD_MAXLEN;
+    }
+
+    for (uint32_t i = 0; i < job->depth; ++i) {
+        if (posix_memalign((void **)&job->slots[i].data, RNG_FILL_ALIGN, job->buffer_size) != 0) {
+            job->depth = i;
+            result = RNG_IO_ERROR;
+            goto out;
+        }
+    }
+
+    result = RNG_NOT_SUPPORTED;
+#ifdef FILL_IO_URING
+    if (!(options && (options->flags & RNG_FILL_PWRITE))) {
+        struct fill_ring ring;
+        if (fill_ring_init(&ring, job)) {
+            result = fill_io_uring(job, &ring);
+            fill_ring_exit(&ring);
+        }
+    }
+#endif
+    if (result == RNG_NOT_SUPPORTED) {
+        result = fill_pwrite(job);
+    }
+
+out:
+    for (uint32_t i = 0; i < job->depth; ++i) {
+        rng_wipe(job->slots[i].data, job->buffer_size);
+        free(job->slots[i].data);
+    }
+    free(job);
+    return result;
+}
+
+int secure_rng_fill_fd(struct secure_rng_ctx *ctx, int fd, uint64_t offset, uint64_t len) {
+    return secure_rng_fill_fd_ex(ctx, fd, offset, len, NULL);
+}
@@ -0,0 +1,58 @@
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "fork.h"
+
+uint64_t *rng_fork_marker = NULL;
+
+// Marker storage if wipe-on-fork pages aren't available
+static uint64_t fork_marker_fallback = 0;
+
+// Last generation issued by this process, child
+//  processes inherit it and continue from there
+static uint64_t fork_last_generation = 0;
+
+static pthread_once_t fork_once = PTHREAD_ONCE_INIT;
+
+static void fork_child_handler(void) {
+    __atomic_store_n(rng_fork_marker, 0, __ATOMIC_RELAXED);
+}
+
+static void fork_init(void) {
+#ifdef MADV_WIPEONFORK
+    // Kernel zeroes this page in the child on fork
+    //  so that no handler needs to be invoked
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+    void *page = mmap(NULL, page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (page != MAP_FAILED) {
+        if (madvise(page, page_size, MADV_WIPEONFORK) == 0) {
+            __atomic_store_n(&rng_fork_marker, (uint64_t *)page, __ATOMIC_RELEASE);
+            return;
+        }
+        munmap(page, page_size);
+    }
+#endif
+
+    // Older kernels: reset the marker from atfork handler,
+    //  this doesn't catch raw clone() and vfork() calls though
+    __atomic_store_n(&rng_fork_marker, &fork_marker_fallback, __ATOMIC_RELEASE);
+    pthread_atfork(NULL, NULL, &fork_child_handler);
+}
+
+uint64_t rng_fork_generation(void) {
+    uint64_t generation, next;
+
+    pthread_once(&fork_once, &fork_init);
+
+    generation = __atomic_load_n(rng_fork_marker, __ATOMIC_ACQUIRE);
+    if (generation == 0) {
+        // First invocation in this process, issue
+        //  a generation which differs from the parent's
+        next = __atomic_add_fetch(&fork_last_generation, 1, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(rng_fork_marker, &generation, next, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            generation = next;
+        }
+    }
+
+    return generation;
+}
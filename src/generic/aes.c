@@ -325,7 +325,7 @@ static void Cipher(state_t* state, const uint8_t* RoundKey)
 }
 
 /* Symmetrical operation: same function for encrypting as for decrypting. Note any IV/nonce should never be reused with the same key */
-static void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length)
+static void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t length, int xor_buf)
 {
   uint8_t buffer[AES_BLOCKLEN];
 
@@ -354,7 +354,7 @@ static void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t le
       bi = 0;
     }
 
-    buf[i] = buffer[bi];
+    buf[i] = xor_buf ? (buf[i] ^ buffer[bi]) : buffer[bi];
   }
 }
 
@@ -362,11 +362,18 @@ static void AES_CTR_xcrypt_buffer(struct AES_ctx* ctx, uint8_t* buf, uint32_t le
 /* Public functions:                                                         */
 /*****************************************************************************/
 
-void aesctr256_software (uint8_t *out, const uint8_t *sk, const void *counter, int bytes)
+AES_KERNEL void aesctr256_software (uint8_t *out, const uint8_t *sk, const void *counter, int bytes)
 {
     struct AES_ctx ctx;
     AES_init_ctx_iv(&ctx, sk, (uint8_t *)counter);
-    AES_CTR_xcrypt_buffer(&ctx, out, bytes);
+    AES_CTR_xcrypt_buffer(&ctx, out, bytes, 0);
+}
+
+AES_KERNEL void aesctr256_xor_software (uint8_t *out, const uint8_t *sk, const void *counter, int bytes)
+{
+    struct AES_ctx ctx;
+    AES_init_ctx_iv(&ctx, sk, (uint8_t *)counter);
+    AES_CTR_xcrypt_buffer(&ctx, out, bytes, 1);
 }
 
 void aesctr256_zeroiv_software (uint8_t *out, const uint8_t *sk, int bytes) {
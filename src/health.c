@@ -0,0 +1,199 @@
+#include <string.h>
+#include "secure-rng.h"
+#include "wipe.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+// Samples are tested 64 at a time, one bit of a mask per sample
+#define HEALTH_CHUNK 64
+
+// Staging area: the previous sample, the chunk and padding
+//  for the whole vector loads past its end
+#define HEALTH_STAGE (1 + HEALTH_CHUNK + 15)
+
+#if defined(__SSE2__)
+
+// Bit i is set if a[i] == b[i], for 64 bytes
+static inline uint64_t health_match(const uint8_t *a, const uint8_t *b) {
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; ++k) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + 16 * k));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + 16 * k));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) << (16 * k);
+    }
+    return mask;
+}
+
+static inline uint64_t health_match_value(const uint8_t *a, uint8_t value) {
+    __m128i y = _mm_set1_epi8((char)value);
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; ++k) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + 16 * k));
+        mask |= (uint64_t)(uint16_t)_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) << (16 * k);
+    }
+    return mask;
+}
+
+#elif defined(__ARM_NEON)
+
+// NEON has no movemask, lanes are weighted and summed up instead
+static inline uint64_t health_movemask(uint8x16_t equal) {
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t bits = vandq_u8(equal, vld1q_u8(weights));
+    return vaddv_u8(vget_low_u8(bits)) | ((uint64_t)vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+static inline uint64_t health_match(const uint8_t *a, const uint8_t *b) {
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; ++k) {
+        mask |= health_movemask(vceqq_u8(vld1q_u8(a + 16 * k), vld1q_u8(b + 16 * k))) << (16 * k);
+    }
+    return mask;
+}
+
+static inline uint64_t health_match_value(const uint8_t *a, uint8_t value) {
+    uint8x16_t y = vdupq_n_u8(value);
+    uint64_t mask = 0;
+    for (int k = 0; k < 4; ++k) {
+        mask |= health_movemask(vceqq_u8(vld1q_u8(a + 16 * k), y)) << (16 * k);
+    }
+    return mask;
+}
+
+#else
+
+static inline uint64_t health_match(const uint8_t *a, const uint8_t *b) {
+    uint64_t mask = 0;
+    for (int i = 0; i < HEALTH_CHUNK; ++i) {
+        mask |= (uint64_t)(a[i] == b[i]) << i;
+    }
+    return mask;
+}
+
+static inline uint64_t health_match_value(const uint8_t *a, uint8_t value) {
+    uint64_t mask = 0;
+    for (int i = 0; i < HEALTH_CHUNK; ++i) {
+        mask |= (uint64_t)(a[i] == value) << i;
+    }
+    return mask;
+}
+
+#endif
+
+static inline uint64_t health_low_bits(size_t n) {
+    return (n >= 64) ? ~UINT64_C(0) : (UINT64_C(1) << n) - 1;
+}
+
+// Repetition Count Test, bit i of repeats is set if sample i
+//  equals the one before it. Runs are walked a whole stretch
+//  at a time, random data has one repeat per 256 samples.
+static int health_rct(struct secure_rng_health *health, uint64_t repeats, size_t n) {
+    uint32_t run = health->rct_run;
+    size_t i = 0;
+
+    while (i < n) {
+        uint64_t rest = repeats >> i;
+        if (rest & 1) {
+            size_t ones = (~rest == 0) ? 64 - i : (size_t)__builtin_ctzll(~rest);
+            run += (uint32_t)ones;
+            i += ones;
+            if (run >= health->rct_cutoff) {
+                return 0;
+            }
+        }
+        else {
+            i += (rest == 0) ? n - i : (size_t)__builtin_ctzll(rest);
+            run = 1;
+        }
+    }
+
+    health->rct_run = run;
+    return 1;
+}
+
+// Adaptive Proportion Test, windows may span several chunks
+static int health_apt(struct secure_rng_health *health, const uint8_t *samples, size_t n) {
+    size_t i = 0;
+
+    while (i < n) {
+        if (health->apt_seen == 0) {
+            health->apt_first = samples[i];
+            health->apt_count = 0;
+        }
+
+        size_t part = RNG_HEALTH_APT_WINDOW - health->apt_seen;
+        if (part > n - i) {
+            part = n - i;
+        }
+
+        // The first sample counts itself
+        uint64_t window = health_low_bits(part) << i;
+        health->apt_count += (uint32_t)__builtin_popcountll(health_match_value(samples, health->apt_first) & window);
+        if (health->apt_count >= health->apt_cutoff) {
+            return 0;
+        }
+
+        health->apt_seen = (uint32_t)((health->apt_seen + part) % RNG_HEALTH_APT_WINDOW);
+        i += part;
+    }
+
+    return 1;
+}
+
+int secure_rng_health_init(struct secure_rng_health *health, uint32_t rct_cutoff, uint32_t apt_cutoff) {
+    // Cutoffs of 1 fail on every sample
+    if (rct_cutoff < 2 || apt_cutoff < 2 || apt_cutoff > RNG_HEALTH_APT_WINDOW) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    memset(health, 0, sizeof(*health));
+    health->rct_cutoff = rct_cutoff;
+    health->apt_cutoff = apt_cutoff;
+    return RNG_SUCCESS;
+}
+
+int secure_rng_health_test(struct secure_rng_health *health, const uint8_t *data, size_t len) {
+    uint8_t stage[HEALTH_STAGE] __attribute__ ((aligned (16)));
+    int rct_passed = 1, apt_passed = 1;
+
+    for (size_t done = 0; done < len && rct_passed && apt_passed; done += HEALTH_CHUNK) {
+        size_t n = (len - done < HEALTH_CHUNK) ? len - done : HEALTH_CHUNK;
+
+        stage[0] = health->rct_last;
+        memcpy(stage + 1, data + done, n);
+        memset(stage + 1 + n, 0, sizeof(stage) - 1 - n);
+
+        // Nothing to compare the very first sample with
+        uint64_t repeats = health_match(stage + 1, stage) & health_low_bits(n);
+        if (health->rct_run == 0) {
+            repeats &= ~UINT64_C(1);
+        }
+
+        rct_passed = health_rct(health, repeats, n);
+        apt_passed = health_apt(health, stage + 1, n);
+        health->rct_last = stage[n];
+    }
+
+    health->blocks++;
+    rng_wipe(stage, sizeof(stage));
+
+    if (!rct_passed || !apt_passed) {
+        // Tests start over with the next block
+        health->rct_failures += !rct_passed;
+        health->apt_failures += !apt_passed;
+        health->rct_run = 0;
+        health->apt_seen = 0;
+        return RNG_HEALTH_FAILURE;
+    }
+
+    return RNG_SUCCESS;
+}
+
+int secure_rng_enable_health_tests(struct secure_rng_ctx *ctx, struct secure_rng_health *health) {
+    ctx->health = health;
+    return RNG_SUCCESS;
+}
@@ -0,0 +1,44 @@
+#include <string.h>
+#include "nontemporal.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define NT_ALIGNMENT 16
+#elif defined(__aarch64__)
+#define NT_ALIGNMENT 32
+#else
+#define NT_ALIGNMENT 1
+#endif
+
+void rng_copy_nontemporal(uint8_t *out, const uint8_t *in, size_t bytes) {
+#if NT_ALIGNMENT > 1
+    size_t head = (size_t)(-(uintptr_t)out & (NT_ALIGNMENT - 1));
+
+    if (head > bytes) {
+        head = bytes;
+    }
+    memcpy(out, in, head);
+    out += head;
+    in += head;
+    bytes -= head;
+
+#if defined(__SSE2__)
+    for (; bytes >= 16; bytes -= 16, out += 16, in += 16) {
+        _mm_stream_si128((__m128i *)out, _mm_loadu_si128((const __m128i *)in));
+    }
+
+    // Streaming stores are weakly ordered
+    _mm_sfence();
+#else
+    // Non-temporal pair store, a hint the core may ignore
+    for (; bytes >= 32; bytes -= 32, out += 32, in += 32) {
+        __asm__ volatile (
+            "ldp q0, q1, [%1]\n\t"
+            "stnp q0, q1, [%0]"
+            : : "r" (out), "r" (in) : "v0", "v1", "memory");
+    }
+#endif
+#endif
+
+    memcpy(out, in, bytes);
+}
@@ -0,0 +1,475 @@
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/syscall.h>
+#include <linux/close_range.h>
+#include "secure-rng.h"
+
+#ifndef GRND_INSECURE
+#define GRND_INSECURE 0x0004
+#endif
+
+// Calls which may be served from the generator, see SECURE_RNG_PRELOAD
+#define PRELOAD_GETRANDOM   1
+#define PRELOAD_GETENTROPY  2
+#define PRELOAD_URANDOM     4
+#define PRELOAD_RANDOM      8
+#define PRELOAD_ALL         (PRELOAD_GETRANDOM | PRELOAD_GETENTROPY | PRELOAD_URANDOM | PRELOAD_RANDOM)
+
+#define PRELOAD_MAX_FD      65536
+#define PRELOAD_CHUNK       65520
+
+// Limits of a per thread context, the kernel is asked
+//  for fresh entropy whichever comes first
+#define PRELOAD_RESEED_BYTES  (UINT64_C(1) << 30)
+#define PRELOAD_RESEED_MS     60000
+
+static const uint8_t preload_personalization[] = "secure-rng-preload";
+
+struct preload_state {
+    struct secure_rng_ctx ctx;
+    int seeded;     // 1 if seeded, -1 if the kernel can't seed it
+    volatile sig_atomic_t busy;     // set while the context is in use
+};
+
+static __thread struct preload_state preload_thread __attribute__ ((tls_model ("initial-exec")));
+
+static pthread_once_t preload_once = PTHREAD_ONCE_INIT;
+static pthread_key_t preload_key;
+static unsigned preload_enabled;
+
+// Descriptors of /dev/urandom and /dev/random opened through us
+static uint64_t preload_fds[PRELOAD_MAX_FD / 64];
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_open64)(const char *, int, ...);
+static int (*real_openat)(int, const char *, int, ...);
+static int (*real_openat64)(int, const char *, int, ...);
+static int (*real_open_2)(const char *, int);
+static int (*real_open64_2)(const char *, int);
+static int (*real_openat_2)(int, const char *, int);
+static int (*real_openat64_2)(int, const char *, int);
+static FILE *(*real_fopen)(const char *, const char *);
+static FILE *(*real_fopen64)(const char *, const char *);
+static FILE *(*real_fdopen)(int, const char *);
+static ssize_t (*real_read)(int, void *, size_t);
+static ssize_t (*real_read_chk)(int, void *, size_t, size_t);
+static int (*real_close)(int);
+static int (*real_dup2)(int, int);
+static int (*real_dup3)(int, int, int);
+static int (*real_close_range)(unsigned, unsigned, int);
+static void (*real_closefrom)(int);
+static ssize_t (*real_getrandom)(void *, size_t, unsigned);
+static int (*real_getentropy)(void *, size_t);
+
+// Comma separated list of getrandom, getentropy, urandom and
+//  random, or none; everything is intercepted if it's not set
+static unsigned preload_parse(const char *list) {
+    static const struct {
+        const char *name;
+        unsigned flag;
+    } names[] = {
+        { "getrandom", PRELOAD_GETRANDOM }, { "getentropy", PRELOAD_GETENTROPY },
+        { "urandom", PRELOAD_URANDOM }, { "random", PRELOAD_RANDOM }, { "all", PRELOAD_ALL },
+    };
+    unsigned enabled = 0;
+
+    if (list == NULL) {
+        return PRELOAD_ALL;
+    }
+
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+            if (len == strlen(names[i].name) && !strncmp(list, names[i].name, len)) {
+                enabled |= names[i].flag;
+            }
+        }
+        list += len;
+        list += (*list == ',');
+    }
+
+    return enabled;
+}
+
+static void preload_thread_exit(void *state) {
+    secure_rng_wipe(state, sizeof(struct preload_state));
+}
+
+static void preload_init(void) {
+    real_open = dlsym(RTLD_NEXT, "open");
+    real_open64 = dlsym(RTLD_NEXT, "open64");
+    real_openat = dlsym(RTLD_NEXT, "openat");
+    real_openat64 = dlsym(RTLD_NEXT, "openat64");
+    real_open_2 = dlsym(RTLD_NEXT, "__open_2");
+    real_open64_2 = dlsym(RTLD_NEXT, "__open64_2");
+    real_openat_2 = dlsym(RTLD_NEXT, "__openat_2");
+    real_openat64_2 = dlsym(RTLD_NEXT, "__openat64_2");
+    real_fopen = dlsym(RTLD_NEXT, "fopen");
+    real_fopen64 = dlsym(RTLD_NEXT, "fopen64");
+    real_fdopen = dlsym(RTLD_NEXT, "fdopen");
+    real_read = dlsym(RTLD_NEXT, "read");
+    real_read_chk = dlsym(RTLD_NEXT, "__read_chk");
+    real_close = dlsym(RTLD_NEXT, "close");
+    real_dup2 = dlsym(RTLD_NEXT, "dup2");
+    real_dup3 = dlsym(RTLD_NEXT, "dup3");
+    real_close_range = dlsym(RTLD_NEXT, "close_range");
+    real_closefrom = dlsym(RTLD_NEXT, "closefrom");
+    real_getrandom = dlsym(RTLD_NEXT, "getrandom");
+    real_getentropy = dlsym(RTLD_NEXT, "getentropy");
+
+    preload_enabled = preload_parse(getenv("SECURE_RNG_PRELOAD"));
+    pthread_key_create(&preload_key, &preload_thread_exit);
+}
+
+__attribute__ ((constructor))
+static void preload_constructor(void) {
+    pthread_once(&preload_once, &preload_init);
+}
+
+static unsigned preload_flags(void) {
+    pthread_once(&preload_once, &preload_init);
+    return preload_enabled;
+}
+
+// Entropy straight from the kernel, bypassing our own getrandom
+static int preload_entropy(uint8_t entropy[48]) {
+    size_t done = 0;
+
+    while (done < 48) {
+        long result = syscall(SYS_getrandom, entropy + done, 48 - done, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        done += (size_t)result;
+    }
+
+    return 0;
+}
+
+// Context of the calling thread, NULL if it can't be seeded
+static struct secure_rng_ctx *preload_context(void) {
+    struct preload_state *state = &preload_thread;
+    uint8_t entropy[48];
+    int saved_errno = errno;
+
+    if (state->seeded == 0) {
+        struct secure_rng_policy policy = { RNG_NO_LIMIT, PRELOAD_RESEED_BYTES, PRELOAD_RESEED_MS };
+
+        state->seeded = -1;
+        if (preload_entropy(entropy) == 0
+                && secure_rng_seed(&state->ctx, entropy, preload_personalization, sizeof(preload_personalization)) == RNG_SUCCESS) {
+            secure_rng_set_policy(&state->ctx, &policy);
+            secure_rng_enable_fork_detection(&state->ctx);
+            pthread_setspecific(preload_key, state);
+            state->seeded = 1;
+        }
+        secure_rng_wipe(entropy, sizeof(entropy));
+    }
+
+    errno = saved_errno;
+    return (state->seeded > 0) ? &state->ctx : NULL;
+}
+
+// Fill the buffer, reseeding from the kernel after fork or once
+//  the policy says so. Returns -1 if the kernel must serve it.
+static int preload_generate(uint8_t *x, size_t len) {
+    struct secure_rng_ctx *ctx = preload_context();
+
+    if (ctx == NULL) {
+        return -1;
+    }
+
+    while (len) {
+        size_t part = (len < PRELOAD_CHUNK) ? len : PRELOAD_CHUNK;
+        int result = secure_rng_bytes(ctx, x, part, 0);
+
+        if (result == RNG_NEED_RESEED) {
+            uint8_t entropy[48];
+            int saved_errno = errno;
+            result = preload_entropy(entropy) == 0 ? secure_rng_reseed(ctx, entropy, NULL, 0) : RNG_IO_ERROR;
+            secure_rng_wipe(entropy, sizeof(entropy));
+            errno = saved_errno;
+            if (result != RNG_SUCCESS) {
+                return -1;
+            }
+            continue;
+        }
+        if (result != RNG_SUCCESS) {
+            return -1;
+        }
+
+        x += part;
+        len -= part;
+    }
+
+    return 0;
+}
+
+// A signal handler which interrupts the generator on the same thread
+//  must not run it again with the state not yet updated, its request
+//  is left to the kernel
+static int preload_fill(uint8_t *x, size_t len) {
+    struct preload_state *state = &preload_thread;
+    int result;
+
+    if (state->busy) {
+        return -1;
+    }
+
+    state->busy = 1;
+    result = preload_generate(x, len);
+    state->busy = 0;
+    return result;
+}
+
+static unsigned preload_path_flag(const char *path) {
+    if (path == NULL) {
+        return 0;
+    }
+    if (!strcmp(path, "/dev/urandom")) {
+        return PRELOAD_URANDOM;
+    }
+    if (!strcmp(path, "/dev/random")) {
+        return PRELOAD_RANDOM;
+    }
+    return 0;
+}
+
+static int preload_tracked(int fd) {
+    return fd >= 0 && fd < PRELOAD_MAX_FD
+        && (__atomic_load_n(&preload_fds[fd / 64], __ATOMIC_RELAXED) >> (fd % 64) & 1);
+}
+
+// Forget descriptors first to last, inclusive
+static void preload_untrack(unsigned first, unsigned last) {
+    if (last >= PRELOAD_MAX_FD) {
+        last = PRELOAD_MAX_FD - 1;
+    }
+
+    for (unsigned fd = first; fd <= last; fd = (fd | 63) + 1) {
+        unsigned end = (last < (fd | 63)) ? last : (fd | 63);
+        uint64_t mask = (UINT64_MAX >> (63 - (end - fd))) << (fd % 64);
+        if (__atomic_load_n(&preload_fds[fd / 64], __ATOMIC_RELAXED) & mask) {
+            __atomic_fetch_and(&preload_fds[fd / 64], ~mask, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+static void preload_track(int fd, int tracked) {
+    if (fd < 0 || fd >= PRELOAD_MAX_FD) {
+        return;
+    }
+    if (tracked) {
+        __atomic_fetch_or(&preload_fds[fd / 64], UINT64_C(1) << (fd % 64), __ATOMIC_RELAXED);
+    }
+    else if (preload_tracked(fd)) {
+        __atomic_fetch_and(&preload_fds[fd / 64], ~(UINT64_C(1) << (fd % 64)), __ATOMIC_RELAXED);
+    }
+}
+
+// Descriptor is still opened by the kernel, so that fstat, poll and
+//  writes behave as usual; only its reads are served by us
+static int preload_opened(int fd, const char *path, int flags) {
+    unsigned flag = preload_path_flag(path);
+
+    if (fd >= 0) {
+        preload_track(fd, (flag & preload_enabled) != 0 && (flags & O_ACCMODE) != O_WRONLY);
+    }
+    return fd;
+}
+
+#define PRELOAD_MODE(flags, mode) do {          \
+    if ((flags) & (O_CREAT | O_TMPFILE)) {      \
+        va_list args;                           \
+        va_start(args, flags);                  \
+        mode = va_arg(args, mode_t);            \
+        va_end(args);                           \
+    }                                           \
+} while (0)
+
+int open(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    PRELOAD_MODE(flags, mode);
+    preload_flags();
+    return preload_opened(real_open(path, flags, mode), path, flags);
+}
+
+int open64(const char *path, int flags, ...) {
+    mode_t mode = 0;
+    PRELOAD_MODE(flags, mode);
+    preload_flags();
+    return preload_opened(real_open64(path, flags, mode), path, flags);
+}
+
+int openat(int dirfd, const char *path, int flags, ...) {
+    mode_t mode = 0;
+    PRELOAD_MODE(flags, mode);
+    preload_flags();
+    return preload_opened(real_openat(dirfd, path, flags, mode), path, flags);
+}
+
+int openat64(int dirfd, const char *path, int flags, ...) {
+    mode_t mode = 0;
+    PRELOAD_MODE(flags, mode);
+    preload_flags();
+    return preload_opened(real_openat64(dirfd, path, flags, mode), path, flags);
+}
+
+// Fortified variants
+int __open_2(const char *path, int flags) {
+    preload_flags();
+    return preload_opened(real_open_2(path, flags), path, flags);
+}
+
+int __open64_2(const char *path, int flags) {
+    preload_flags();
+    return preload_opened(real_open64_2(path, flags), path, flags);
+}
+
+int __openat_2(int dirfd, const char *path, int flags) {
+    preload_flags();
+    return preload_opened(real_openat_2(dirfd, path, flags), path, flags);
+}
+
+int __openat64_2(int dirfd, const char *path, int flags) {
+    preload_flags();
+    return preload_opened(real_openat64_2(dirfd, path, flags), path, flags);
+}
+
+static ssize_t preload_stream_read(void *cookie, char *buf, size_t size) {
+    (void)cookie;
+    if (preload_fill((uint8_t *)buf, size) == 0) {
+        return (ssize_t)size;
+    }
+
+    long result = syscall(SYS_getrandom, buf, size, 0);
+    if (result < 0) {
+        errno = EIO;
+        return -1;
+    }
+    return (ssize_t)result;
+}
+
+static int preload_stream_close(void *cookie) {
+    (void)cookie;
+    return 0;
+}
+
+// Streams opened for reading don't need a descriptor at all,
+//  stdio reads through libc internals which we can't interpose
+static FILE *preload_fopen(FILE *(*function)(const char *, const char *), const char *path, const char *mode) {
+    static const cookie_io_functions_t functions = { preload_stream_read, NULL, NULL, preload_stream_close };
+
+    if ((preload_path_flag(path) & preload_enabled) && mode[0] == 'r' && strchr(mode, '+') == NULL) {
+        return fopencookie(NULL, mode, functions);
+    }
+    return function(path, mode);
+}
+
+FILE *fopen(const char *path, const char *mode) {
+    preload_flags();
+    return preload_fopen(real_fopen, path, mode);
+}
+
+FILE *fopen64(const char *path, const char *mode) {
+    preload_flags();
+    return preload_fopen(real_fopen64, path, mode);
+}
+
+// The stream would read through libc internals and close the
+//  descriptor behind our back, leave it to the kernel
+FILE *fdopen(int fd, const char *mode) {
+    preload_flags();
+    preload_track(fd, 0);
+    return real_fdopen(fd, mode);
+}
+
+ssize_t read(int fd, void *buf, size_t count) {
+    if (preload_tracked(fd) && preload_fill(buf, count) == 0) {
+        return (ssize_t)count;
+    }
+    preload_flags();
+    return real_read(fd, buf, count);
+}
+
+ssize_t __read_chk(int fd, void *buf, size_t count, size_t size) {
+    if (count <= size && preload_tracked(fd) && preload_fill(buf, count) == 0) {
+        return (ssize_t)count;
+    }
+    preload_flags();
+    return real_read_chk(fd, buf, count, size);
+}
+
+int close(int fd) {
+    preload_flags();
+    preload_track(fd, 0);
+    return real_close(fd);
+}
+
+int dup2(int oldfd, int newfd) {
+    preload_flags();
+    int result = real_dup2(oldfd, newfd);
+    if (result >= 0 && oldfd != newfd) {
+        preload_track(newfd, 0);
+    }
+    return result;
+}
+
+int dup3(int oldfd, int newfd, int flags) {
+    preload_flags();
+    int result = real_dup3(oldfd, newfd, flags);
+    if (result >= 0) {
+        preload_track(newfd, 0);
+    }
+    return result;
+}
+
+int close_range(unsigned first, unsigned last, int flags) {
+    preload_flags();
+    int result = real_close_range(first, last, flags);
+    if (result == 0 && !(flags & CLOSE_RANGE_CLOEXEC)) {
+        preload_untrack(first, last);
+    }
+    return result;
+}
+
+void closefrom(int lowfd) {
+    preload_flags();
+    preload_untrack((lowfd < 0) ? 0 : (unsigned)lowfd, UINT_MAX);
+    real_closefrom(lowfd);
+}
+
+ssize_t getrandom(void *buf, size_t buflen, unsigned int flags) {
+    unsigned wanted = (flags & GRND_RANDOM) ? PRELOAD_GETRANDOM | PRELOAD_RANDOM : PRELOAD_GETRANDOM;
+    unsigned enabled = preload_flags();
+
+    // Unknown flags are left to the kernel to reject
+    if ((enabled & wanted) == wanted && (flags & ~(GRND_NONBLOCK | GRND_RANDOM | GRND_INSECURE)) == 0
+            && preload_fill(buf, buflen) == 0) {
+        return (ssize_t)buflen;
+    }
+    return real_getrandom(buf, buflen, flags);
+}
+
+int getentropy(void *buffer, size_t length) {
+    if (length > 256) {
+        errno = EIO;
+        return -1;
+    }
+    if ((preload_flags() & PRELOAD_GETENTROPY) && preload_fill(buffer, length) == 0) {
+        return 0;
+    }
+    return real_getentropy(buffer, length);
+}
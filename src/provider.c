@@ -0,0 +1,431 @@
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/random.h>
+#include <openssl/core_dispatch.h>
+#include <openssl/core_names.h>
+#include <openssl/evp.h>
+#include <openssl/params.h>
+#include "secure-rng.h"
+
+// OpenSSL 3 provider exposing the generator as the SECURE-RNG
+//  EVP_RAND algorithm, see README for the configuration
+
+#define PROVIDER_STRENGTH     256
+#define PROVIDER_SEED_LENGTH  48
+#define PROVIDER_CHUNK        65520
+
+struct provider_rand {
+    struct secure_rng_ctx ctx;
+    int state;
+
+    // Entropy source, the OS if there is no parent
+    void *parent;
+    OSSL_FUNC_rand_generate_fn *parent_generate;
+    OSSL_FUNC_rand_lock_fn *parent_lock;
+    OSSL_FUNC_rand_unlock_fn *parent_unlock;
+
+    // Only shared instances, such as the primary DRBG, are locked
+    pthread_mutex_t *lock;
+
+    struct secure_rng_policy policy;
+};
+
+static const uint8_t provider_personalization[] = "secure-rng OpenSSL provider";
+
+// Inputs of any length are folded into 48 bytes
+static void provider_fold(uint8_t out[PROVIDER_SEED_LENGTH], const unsigned char *in, size_t len) {
+    for (size_t i = 0; i < len; ++i) {
+        out[i % PROVIDER_SEED_LENGTH] ^= in[i];
+    }
+}
+
+static int provider_entropy(struct provider_rand *rand, uint8_t entropy[PROVIDER_SEED_LENGTH], int prediction_resistance) {
+    if (rand->parent != NULL) {
+        int result;
+
+        if (rand->parent_lock != NULL && !rand->parent_lock(rand->parent)) {
+            return 0;
+        }
+        result = rand->parent_generate(rand->parent, entropy, PROVIDER_SEED_LENGTH, PROVIDER_STRENGTH, prediction_resistance, NULL, 0);
+        if (rand->parent_unlock != NULL) {
+            rand->parent_unlock(rand->parent);
+        }
+        return result;
+    }
+
+    for (size_t done = 0; done < PROVIDER_SEED_LENGTH; ) {
+        ssize_t result = getrandom(entropy + done, PROVIDER_SEED_LENGTH - done, 0);
+        if (result < 0) {
+            if (errno == EINTR) continue;
+            return 0;
+        }
+        done += (size_t)result;
+    }
+    return 1;
+}
+
+// Fresh entropy mixed with optional caller supplied input
+static int provider_reseed_locked(struct provider_rand *rand, int prediction_resistance,
+                                  const unsigned char *ent, size_t ent_len, const unsigned char *addin, size_t addin_len) {
+    uint8_t entropy[PROVIDER_SEED_LENGTH];
+    uint8_t additional[PROVIDER_SEED_LENGTH] = {0};
+    int result = 0;
+
+    if (provider_entropy(rand, entropy, prediction_resistance)) {
+        provider_fold(entropy, ent, ent_len);
+        provider_fold(additional, addin, addin_len);
+        result = secure_rng_reseed(&rand->ctx, entropy, additional, addin_len ? sizeof(additional) : 0) == RNG_SUCCESS;
+    }
+
+    secure_rng_wipe(entropy, sizeof(entropy));
+    secure_rng_wipe(additional, sizeof(additional));
+    if (!result) {
+        rand->state = EVP_RAND_STATE_ERROR;
+    }
+    return result;
+}
+
+static void *provider_newctx(void *provctx, void *parent, const OSSL_DISPATCH *parent_calls) {
+    struct provider_rand *rand;
+    (void)provctx;
+
+    rand = aligned_alloc(16, (sizeof(struct provider_rand) + 15) & ~(size_t)15);
+    if (rand == NULL) {
+        return NULL;
+    }
+    memset(rand, 0, sizeof(struct provider_rand));
+    rand->state = EVP_RAND_STATE_UNINITIALISED;
+    rand->policy.max_calls = RNG_NO_LIMIT;
+    rand->policy.max_bytes = RNG_NO_LIMIT;
+    rand->policy.max_age_ms = RNG_NO_LIMIT;
+
+    if (parent != NULL) {
+        for (; parent_calls != NULL && parent_calls->function_id != 0; ++parent_calls) {
+            switch (parent_calls->function_id) {
+                case OSSL_FUNC_RAND_GENERATE:
+                    rand->parent_generate = OSSL_FUNC_rand_generate(parent_calls);
+                    break;
+                case OSSL_FUNC_RAND_LOCK:
+                    rand->parent_lock = OSSL_FUNC_rand_lock(parent_calls);
+                    break;
+                case OSSL_FUNC_RAND_UNLOCK:
+                    rand->parent_unlock = OSSL_FUNC_rand_unlock(parent_calls);
+                    break;
+            }
+        }
+        if (rand->parent_generate == NULL) {
+            free(rand);
+            return NULL;
+        }
+        rand->parent = parent;
+    }
+
+    return rand;
+}
+
+static void provider_freectx(void *vctx) {
+    struct provider_rand *rand = vctx;
+
+    if (rand == NULL) {
+        return;
+    }
+    if (rand->lock != NULL) {
+        pthread_mutex_destroy(rand->lock);
+        free(rand->lock);
+    }
+    secure_rng_wipe(rand, sizeof(struct provider_rand));
+    free(rand);
+}
+
+static int provider_set_ctx_params(void *vctx, const OSSL_PARAM params[]) {
+    struct provider_rand *rand = vctx;
+    const OSSL_PARAM *p;
+    unsigned int requests;
+    time_t interval;
+
+    if ((p = OSSL_PARAM_locate_const(params, OSSL_DRBG_PARAM_RESEED_REQUESTS)) != NULL) {
+        if (!OSSL_PARAM_get_uint(p, &requests)) {
+            return 0;
+        }
+        rand->policy.max_calls = requests ? requests : RNG_NO_LIMIT;
+    }
+    if ((p = OSSL_PARAM_locate_const(params, OSSL_DRBG_PARAM_RESEED_TIME_INTERVAL)) != NULL) {
+        if (!OSSL_PARAM_get_time_t(p, &interval)) {
+            return 0;
+        }
+        rand->policy.max_age_ms = (interval > 0) ? (uint64_t)interval * 1000 : RNG_NO_LIMIT;
+    }
+
+    if (rand->state == EVP_RAND_STATE_READY) {
+        secure_rng_set_policy(&rand->ctx, &rand->policy);
+    }
+    return 1;
+}
+
+static int provider_instantiate(void *vctx, unsigned int strength, int prediction_resistance,
+                                const unsigned char *pstr, size_t pstr_len, const OSSL_PARAM params[]) {
+    struct provider_rand *rand = vctx;
+    uint8_t entropy[PROVIDER_SEED_LENGTH];
+    uint8_t personalization[PROVIDER_SEED_LENGTH] = {0};
+    int result = 0;
+
+    if (strength > PROVIDER_STRENGTH || !provider_set_ctx_params(rand, params)) {
+        return 0;
+    }
+
+    if (pstr == NULL || pstr_len == 0) {
+        pstr = provider_personalization;
+        pstr_len = sizeof(provider_personalization);
+    }
+    provider_fold(personalization, pstr, pstr_len);
+
+    if (provider_entropy(rand, entropy, prediction_resistance)
+            && secure_rng_seed(&rand->ctx, entropy, personalization, sizeof(personalization)) == RNG_SUCCESS) {
+        // Seeding resets the policy and fork detection
+        secure_rng_set_policy(&rand->ctx, &rand->policy);
+        secure_rng_enable_fork_detection(&rand->ctx);
+        rand->state = EVP_RAND_STATE_READY;
+        result = 1;
+    }
+    else {
+        rand->state = EVP_RAND_STATE_ERROR;
+    }
+
+    secure_rng_wipe(entropy, sizeof(entropy));
+    secure_rng_wipe(personalization, sizeof(personalization));
+    return result;
+}
+
+static int provider_uninstantiate(void *vctx) {
+    struct provider_rand *rand = vctx;
+
+    secure_rng_wipe(&rand->ctx, sizeof(rand->ctx));
+    rand->state = EVP_RAND_STATE_UNINITIALISED;
+    return 1;
+}
+
+static int provider_generate(void *vctx, unsigned char *out, size_t outlen, unsigned int strength,
+                             int prediction_resistance, const unsigned char *addin, size_t addin_len) {
+    struct provider_rand *rand = vctx;
+
+    if (rand->state != EVP_RAND_STATE_READY || strength > PROVIDER_STRENGTH) {
+        return 0;
+    }
+
+    // The generator has no additional input on generate,
+    //  fold it into a reseed instead
+    if ((prediction_resistance || addin_len) && !provider_reseed_locked(rand, prediction_resistance, NULL, 0, addin, addin_len)) {
+        return 0;
+    }
+
+    while (outlen) {
+        size_t len = (outlen < PROVIDER_CHUNK) ? outlen : PROVIDER_CHUNK;
+        int result = secure_rng_bytes(&rand->ctx, out, len, 0);
+
+        // Policy limits and fork detection both end up here
+        if (result == RNG_NEED_RESEED) {
+            if (!provider_reseed_locked(rand, 0, NULL, 0, NULL, 0)) {
+                return 0;
+            }
+            continue;
+        }
+        if (result != RNG_SUCCESS) {
+            rand->state = EVP_RAND_STATE_ERROR;
+            return 0;
+        }
+
+        out += len;
+        outlen -= len;
+    }
+
+    return 1;
+}
+
+static int provider_reseed(void *vctx, int prediction_resistance, const unsigned char *ent, size_t ent_len,
+                           const unsigned char *addin, size_t addin_len) {
+    struct provider_rand *rand = vctx;
+
+    if (rand->state != EVP_RAND_STATE_READY) {
+        return 0;
+    }
+    return provider_reseed_locked(rand, prediction_resistance, ent, ent_len, addin, addin_len);
+}
+
+// Lets OpenSSL's own DRBGs use this one as a parent
+static size_t provider_get_seed(void *vctx, unsigned char **buffer, int entropy, size_t min_len, size_t max_len,
+                                int prediction_resistance, const unsigned char *addin, size_t addin_len) {
+    size_t len = ((size_t)entropy + 7) / 8;
+    unsigned char *seed;
+
+    if (len < min_len) len = min_len;
+    if (len > max_len) {
+        return 0;
+    }
+
+    seed = malloc(len);
+    if (seed == NULL) {
+        return 0;
+    }
+    if (!provider_generate(vctx, seed, len, 0, prediction_resistance, addin, addin_len)) {
+        free(seed);
+        return 0;
+    }
+
+    *buffer = seed;
+    return len;
+}
+
+static void provider_clear_seed(void *vctx, unsigned char *buffer, size_t b_len) {
+    (void)vctx;
+    if (buffer != NULL) {
+        secure_rng_wipe(buffer, b_len);
+        free(buffer);
+    }
+}
+
+static int provider_enable_locking(void *vctx) {
+    struct provider_rand *rand = vctx;
+
+    if (rand->lock == NULL) {
+        rand->lock = malloc(sizeof(pthread_mutex_t));
+        if (rand->lock == NULL || pthread_mutex_init(rand->lock, NULL) != 0) {
+            free(rand->lock);
+            rand->lock = NULL;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int provider_lock(void *vctx) {
+    struct provider_rand *rand = vctx;
+    return rand->lock == NULL || pthread_mutex_lock(rand->lock) == 0;
+}
+
+static void provider_unlock(void *vctx) {
+    struct provider_rand *rand = vctx;
+    if (rand->lock != NULL) {
+        pthread_mutex_unlock(rand->lock);
+    }
+}
+
+static int provider_get_ctx_params(void *vctx, OSSL_PARAM params[]) {
+    struct provider_rand *rand = vctx;
+    OSSL_PARAM *p;
+
+    if ((p = OSSL_PARAM_locate(params, OSSL_RAND_PARAM_STATE)) != NULL && !OSSL_PARAM_set_int(p, rand->state)) {
+        return 0;
+    }
+    if ((p = OSSL_PARAM_locate(params, OSSL_RAND_PARAM_STRENGTH)) != NULL && !OSSL_PARAM_set_uint(p, PROVIDER_STRENGTH)) {
+        return 0;
+    }
+    if ((p = OSSL_PARAM_locate(params, OSSL_RAND_PARAM_MAX_REQUEST)) != NULL && !OSSL_PARAM_set_size_t(p, PROVIDER_CHUNK)) {
+        return 0;
+    }
+    return 1;
+}
+
+static const OSSL_PARAM *provider_gettable_ctx_params(void *vctx, void *provctx) {
+    static const OSSL_PARAM params[] = {
+        OSSL_PARAM_int(OSSL_RAND_PARAM_STATE, NULL),
+        OSSL_PARAM_uint(OSSL_RAND_PARAM_STRENGTH, NULL),
+        OSSL_PARAM_size_t(OSSL_RAND_PARAM_MAX_REQUEST, NULL),
+        OSSL_PARAM_END
+    };
+    (void)vctx;
+    (void)provctx;
+    return params;
+}
+
+static const OSSL_PARAM *provider_settable_ctx_params(void *vctx, void *provctx) {
+    static const OSSL_PARAM params[] = {
+        OSSL_PARAM_uint(OSSL_DRBG_PARAM_RESEED_REQUESTS, NULL),
+        OSSL_PARAM_time_t(OSSL_DRBG_PARAM_RESEED_TIME_INTERVAL, NULL),
+        OSSL_PARAM_END
+    };
+    (void)vctx;
+    (void)provctx;
+    return params;
+}
+
+static int provider_verify_zeroization(void *vctx) {
+    struct provider_rand *rand = vctx;
+    static const uint8_t zero[32] = {0};
+    return rand->state == EVP_RAND_STATE_UNINITIALISED && !memcmp(rand->ctx.Key, zero, sizeof(zero));
+}
+
+static const OSSL_DISPATCH provider_rand_functions[] = {
+    { OSSL_FUNC_RAND_NEWCTX, (void (*)(void))provider_newctx },
+    { OSSL_FUNC_RAND_FREECTX, (void (*)(void))provider_freectx },
+    { OSSL_FUNC_RAND_INSTANTIATE, (void (*)(void))provider_instantiate },
+    { OSSL_FUNC_RAND_UNINSTANTIATE, (void (*)(void))provider_uninstantiate },
+    { OSSL_FUNC_RAND_GENERATE, (void (*)(void))provider_generate },
+    { OSSL_FUNC_RAND_RESEED, (void (*)(void))provider_reseed },
+    { OSSL_FUNC_RAND_GET_SEED, (void (*)(void))provider_get_seed },
+    { OSSL_FUNC_RAND_CLEAR_SEED, (void (*)(void))provider_clear_seed },
+    { OSSL_FUNC_RAND_ENABLE_LOCKING, (void (*)(void))provider_enable_locking },
+    { OSSL_FUNC_RAND_LOCK, (void (*)(void))provider_lock },
+    { OSSL_FUNC_RAND_UNLOCK, (void (*)(void))provider_unlock },
+    { OSSL_FUNC_RAND_GET_CTX_PARAMS, (void (*)(void))provider_get_ctx_params },
+    { OSSL_FUNC_RAND_GETTABLE_CTX_PARAMS, (void (*)(void))provider_gettable_ctx_params },
+    { OSSL_FUNC_RAND_SET_CTX_PARAMS, (void (*)(void))provider_set_ctx_params },
+    { OSSL_FUNC_RAND_SETTABLE_CTX_PARAMS, (void (*)(void))provider_settable_ctx_params },
+    { OSSL_FUNC_RAND_VERIFY_ZEROIZATION, (void (*)(void))provider_verify_zeroization },
+    { 0, NULL }
+};
+
+static const OSSL_ALGORITHM provider_rands[] = {
+    { "SECURE-RNG", "provider=securerng", provider_rand_functions, "AES-256 CTR_DRBG of secure-rng" },
+    { NULL, NULL, NULL, NULL }
+};
+
+static const OSSL_ALGORITHM *provider_query(void *provctx, int operation_id, int *no_cache) {
+    (void)provctx;
+    *no_cache = 0;
+    return (operation_id == OSSL_OP_RAND) ? provider_rands : NULL;
+}
+
+static int provider_get_params(void *provctx, OSSL_PARAM params[]) {
+    OSSL_PARAM *p;
+    (void)provctx;
+
+    if ((p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_NAME)) != NULL && !OSSL_PARAM_set_utf8_ptr(p, "secure-rng provider")) {
+        return 0;
+    }
+    if ((p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_VERSION)) != NULL && !OSSL_PARAM_set_utf8_ptr(p, SECURE_RNG_VERSION)) {
+        return 0;
+    }
+    if ((p = OSSL_PARAM_locate(params, OSSL_PROV_PARAM_STATUS)) != NULL && !OSSL_PARAM_set_int(p, 1)) {
+        return 0;
+    }
+    return 1;
+}
+
+static const OSSL_PARAM *provider_gettable_params(void *provctx) {
+    static const OSSL_PARAM params[] = {
+        OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_NAME, NULL, 0),
+        OSSL_PARAM_utf8_ptr(OSSL_PROV_PARAM_VERSION, NULL, 0),
+        OSSL_PARAM_int(OSSL_PROV_PARAM_STATUS, NULL),
+        OSSL_PARAM_END
+    };
+    (void)provctx;
+    return params;
+}
+
+static const OSSL_DISPATCH provider_functions[] = {
+    { OSSL_FUNC_PROVIDER_QUERY_OPERATION, (void (*)(void))provider_query },
+    { OSSL_FUNC_PROVIDER_GET_PARAMS, (void (*)(void))provider_get_params },
+    { OSSL_FUNC_PROVIDER_GETTABLE_PARAMS, (void (*)(void))provider_gettable_params },
+    { 0, NULL }
+};
+
+int OSSL_provider_init(const OSSL_CORE_HANDLE *handle, const OSSL_DISPATCH *in,
+                       const OSSL_DISPATCH **out, void **provctx) {
+    (void)handle;
+    (void)in;
+    *out = provider_functions;
+    *provctx = NULL;
+    return 1;
+}
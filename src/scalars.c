@@ -0,0 +1,122 @@
+#include <string.h>
+#include "secure-rng.h"
+
+#define EC_SCALAR_BYTES  32
+#define EC_BATCH         2040    // scalars per generator invocation
+
+// Group orders as big-endian 64-bit limbs, most significant first
+static const uint64_t ec_order_secp256k1[4] = {
+    UINT64_C(0xffffffffffffffff), UINT64_C(0xfffffffffffffffe),
+    UINT64_C(0xbaaedce6af48a03b), UINT64_C(0xbfd25e8cd0364141),
+};
+
+static const uint64_t ec_order_p256[4] = {
+    UINT64_C(0xffffffff00000000), UINT64_C(0xffffffffffffffff),
+    UINT64_C(0xbce6faada7179e84), UINT64_C(0xf3b9cac2fc632551),
+};
+
+static inline uint64_t ec_load_be64(const uint8_t *p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+// 1 if 0 < scalar < order, without branches on the scalar
+static inline uint64_t ec_in_range(const uint8_t *scalar, const uint64_t order[4]) {
+    uint64_t borrow = 0, nonzero = 0;
+
+    for (int i = 3; i >= 0; --i) {
+        uint64_t limb = ec_load_be64(scalar + 8 * i);
+        uint64_t difference = limb - order[i];
+        borrow = (uint64_t)(limb < order[i]) | (uint64_t)(difference < borrow);
+        nonzero |= limb;
+    }
+
+    return borrow & ((nonzero | (0 - nonzero)) >> 63);
+}
+
+// RFC 7748 clamping, the scalar is little-endian
+static inline void ec_clamp_x25519(uint8_t *scalar) {
+    scalar[0] &= 248;
+    scalar[31] &= 127;
+    scalar[31] |= 64;
+}
+
+// Candidates are generated straight into the output and compacted
+//  in place if any is rejected, rejected ones are overwritten
+//  by the next round
+static int ec_generate_ranged(struct secure_rng_ctx *ctx, const uint64_t order[4], uint8_t *out, size_t count) {
+    size_t done = 0;
+
+    while (done < count) {
+        size_t want = (count - done < EC_BATCH) ? count - done : EC_BATCH;
+        uint8_t *batch = out + done * EC_SCALAR_BYTES;
+        size_t kept = 0;
+        int result = secure_rng_bytes(ctx, batch, want * EC_SCALAR_BYTES, 0);
+
+        if (result != RNG_SUCCESS) {
+            memset(out, 0, count * EC_SCALAR_BYTES);
+            return result;
+        }
+
+        for (size_t i = 0; i < want; ++i) {
+            kept += ec_in_range(batch + i * EC_SCALAR_BYTES, order);
+        }
+
+        // Only whether a candidate was rejected is revealed, which
+        //  says nothing about the accepted ones
+        if (kept != want) {
+            kept = 0;
+            for (size_t i = 0; i < want; ++i) {
+                const uint8_t *candidate = batch + i * EC_SCALAR_BYTES;
+                uint64_t accept = ec_in_range(candidate, order);
+                if (kept != i) {
+                    memcpy(batch + kept * EC_SCALAR_BYTES, candidate, EC_SCALAR_BYTES);
+                }
+                kept += accept;
+            }
+        }
+
+        done += kept;
+    }
+
+    return RNG_SUCCESS;
+}
+
+int secure_rng_ec_scalars(struct secure_rng_ctx *ctx, int curve, uint8_t *out, size_t count) {
+    if (count > SIZE_MAX / EC_SCALAR_BYTES) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    switch (curve) {
+        case RNG_CURVE_SECP256K1:
+            return ec_generate_ranged(ctx, ec_order_secp256k1, out, count);
+
+        case RNG_CURVE_P256:
+            return ec_generate_ranged(ctx, ec_order_p256, out, count);
+
+        case RNG_CURVE_X25519:
+        case RNG_CURVE_ED25519:
+            for (size_t done = 0; done < count; ) {
+                size_t want = (count - done < EC_BATCH) ? count - done : EC_BATCH;
+                int result = secure_rng_bytes(ctx, out + done * EC_SCALAR_BYTES, want * EC_SCALAR_BYTES, 0);
+                if (result != RNG_SUCCESS) {
+                    memset(out, 0, count * EC_SCALAR_BYTES);
+                    return result;
+                }
+                if (curve == RNG_CURVE_X25519) {
+                    for (size_t i = done; i < done + want; ++i) {
+                        ec_clamp_x25519(out + i * EC_SCALAR_BYTES);
+                    }
+                }
+                done += want;
+            }
+            return RNG_SUCCESS;
+
+        default:
+            return RNG_NOT_SUPPORTED;
+    }
+}
@@ -1,10 +1,56 @@
 #include <string.h>
 #include <stddef.h>
+#include <time.h>
 #include "aes.h"
+#include "bits.h"
+#include "fork.h"
+#include "nontemporal.h"
+#include "stats.h"
 #include "secure-rng.h"
+#include "wipe.h"
 
 static const uint64_t kMaxReseedCount = UINT64_C(1) << 48;
 
+// Monotonic time in milliseconds, the coarse clock
+//  is good enough and doesn't cost a syscall
+inline static uint64_t drbg_now_ms(void) {
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// Reset reseed policy counters
+inline static void drbg_reset_counters(struct secure_rng_ctx *ctx) {
+    ctx->reseed_counter = 1;
+    ctx->reseed_bytes = 0;
+    ctx->reseed_time = drbg_now_ms();
+
+    // Bind the fresh state to the current process
+    if (ctx->fork_generation != 0) {
+        ctx->fork_generation = rng_fork_generation();
+    }
+}
+
+// Check whether any of the policy limits has been hit
+inline static int drbg_reseed_required(const struct secure_rng_ctx *ctx) {
+    // Counter limits are combined without short-circuiting
+    //  so that both of them cost a single branch
+    int required = (ctx->reseed_counter > ctx->policy.max_calls)
+                 | (ctx->reseed_bytes >= ctx->policy.max_bytes)
+                 | rng_forked(ctx->fork_generation);
+
+    // The clock is only read if the age limit is set
+    if (ctx->policy.max_age_ms != RNG_NO_LIMIT) {
+        required |= (drbg_now_ms() - ctx->reseed_time >= ctx->policy.max_age_ms);
+    }
+
+    return required;
+}
+
 // Increment V
 inline static void drbg_increment_v(struct secure_rng_ctx *ctx) {
     // Treat AES counter as a big-endian integer
@@ -18,15 +64,90 @@ inline static void drbg_increment_v(struct secure_rng_ctx *ctx) {
     }
 }
 
-inline static void drbg_run_one_round(uint8_t buffer[16], struct secure_rng_ctx *ctx) {
-    drbg_increment_v(ctx);
-    ctx->aesctr256 (buffer, ctx->Key, ctx->V, 16);
+inline static uint32_t drbg_load_be32(const uint8_t bytes[4]) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+}
+
+inline static void drbg_store_be32(uint8_t bytes[4], uint32_t value) {
+    bytes[0] = (uint8_t)(value >> 24);
+    bytes[1] = (uint8_t)(value >> 16);
+    bytes[2] = (uint8_t)(value >> 8);
+    bytes[3] = (uint8_t)value;
+}
+
+// Invoke the AES kernel, a pinned backend is called directly
+//  so that it may be inlined with link time optimization
+inline static void drbg_aesctr256(const struct secure_rng_ctx *ctx, uint8_t *buffer, const uint8_t counter[16], int bytes, int xor_out) {
+#ifdef STATIC_BACKEND
+    if (xor_out) {
+        STATIC_BACKEND_XOR (buffer, ctx->Key, counter, bytes);
+    } else {
+        STATIC_BACKEND (buffer, ctx->Key, counter, bytes);
+    }
+#else
+    if (xor_out) {
+        ctx->aesctr256_xor (buffer, ctx->Key, counter, bytes);
+    } else {
+        ctx->aesctr256 (buffer, ctx->Key, counter, bytes);
+    }
+#endif
+}
+
+// Encrypt consecutive counter blocks, V is left equal to the last
+//  counter value being used. The keystream is stored into the
+//  buffer or, if xor_out is set, XORed into its contents
+inline static void drbg_run_rounds_with(uint8_t *buffer, size_t bytes, struct secure_rng_ctx *ctx, int xor_out) {
+    uint8_t counter[16] __attribute__ ((aligned (16)));
+    size_t blocks;
+    uint32_t low;
+
+    while (bytes) {
+        drbg_increment_v(ctx);
+        memcpy(counter, ctx->V, 16);
+
+        // Kernels only carry within the low 32 bits of
+        //  the counter, so split where these bits wrap
+        low = drbg_load_be32(ctx->V + 12);
+        blocks = bytes / 16;
+        if (blocks - 1 > UINT32_MAX - low) {
+            blocks = (size_t)(UINT32_MAX - low) + 1;
+        }
+
+        drbg_aesctr256(ctx, buffer, counter, (int)(blocks * 16), xor_out);
+        drbg_store_be32(ctx->V + 12, low + (uint32_t)(blocks - 1));
+
+        buffer += blocks * 16;
+        bytes -= blocks * 16;
+    }
+}
+
+inline static void drbg_run_rounds(uint8_t *buffer, size_t bytes, struct secure_rng_ctx *ctx) {
+    drbg_run_rounds_with(buffer, bytes, ctx, 0);
+}
+
+// Staging tile for streaming output, small enough to stay in L1
+#define DRBG_TILE_BYTES 8192
+
+// Generate into a cache resident tile and stream it out,
+//  so that large outputs don't evict the caller's data
+static void drbg_run_rounds_nontemporal(uint8_t *buffer, size_t bytes, struct secure_rng_ctx *ctx) {
+    uint8_t tile[DRBG_TILE_BYTES] __attribute__ ((aligned (64)));
+    // The first tile is the longest one
+    size_t used = (bytes < DRBG_TILE_BYTES) ? bytes : DRBG_TILE_BYTES;
+
+    while (bytes) {
+        size_t tile_len = (bytes < DRBG_TILE_BYTES) ? bytes : DRBG_TILE_BYTES;
+        drbg_run_rounds(tile, tile_len, ctx);
+        rng_copy_nontemporal(buffer, tile, tile_len);
+        buffer += tile_len;
+        bytes -= tile_len;
+    }
+
+    rng_wipe(tile, used);
 }
 
 inline static void drbg_run_three_rounds(uint8_t buffer[48], struct secure_rng_ctx *ctx) {
-    drbg_run_one_round(buffer, ctx);
-    drbg_run_one_round(buffer + 16, ctx);
-    drbg_run_one_round(buffer + 32, ctx);
+    drbg_run_rounds(buffer, 48, ctx);
 }
 
 inline static void drbg_mix(uint8_t buffer[48], const uint8_t provided_data[48]) {
@@ -45,27 +166,56 @@ inline static void drbg_apply(const uint8_t buffer[48], struct secure_rng_ctx *c
 void secure_rng_set_seeder(struct secure_rng_ctx *ctx, void (*resistance_seeder_function)(uint8_t seed_out[48]), uint64_t reseed_interval) {
     if (resistance_seeder_function == NULL) {
         ctx->resistance_seeder = NULL;
-        ctx->reseed_interval = kMaxReseedCount;
+        ctx->policy.max_calls = kMaxReseedCount;
     }
     else {
         ctx->resistance_seeder = resistance_seeder_function;
-        ctx->reseed_interval = reseed_interval;
+        ctx->policy.max_calls = reseed_interval;
+    }
+}
+
+void secure_rng_set_policy(struct secure_rng_ctx *ctx, const struct secure_rng_policy *policy) {
+    ctx->policy = *policy;
+
+    // Without a seeder the invocations count
+    //  must not exceed the hard limit
+    if (ctx->resistance_seeder == NULL && ctx->policy.max_calls > kMaxReseedCount) {
+        ctx->policy.max_calls = kMaxReseedCount;
+    }
+}
+
+void secure_rng_set_nontemporal(struct secure_rng_ctx *ctx, uint64_t threshold) {
+    ctx->nontemporal_bytes = threshold;
+}
+
+int secure_rng_enable_fork_detection(struct secure_rng_ctx *ctx) {
+    ctx->fork_generation = rng_fork_generation();
+    return RNG_SUCCESS;
+}
+
+int secure_rng_forked(const struct secure_rng_ctx *ctx) {
+    return rng_forked(ctx->fork_generation);
+}
+
+int secure_rng_set_backend(struct secure_rng_ctx *ctx, int backend) {
+    // Hardware detection runs only once per process
+    aesctr256_fn function = aes_backend_function(backend);
+
+    if (function == NULL) {
+        return RNG_NOT_SUPPORTED;
     }
+
+    ctx->aesctr256 = function;
+    ctx->aesctr256_xor = aes_backend_xor_function(function);
+    return RNG_SUCCESS;
 }
 
 int secure_rng_seed(struct secure_rng_ctx *ctx, const uint8_t entropy_input[48], const uint8_t *personalization_string, size_t personalization_len) {
     uint8_t round_bytes[48] = {0};
     uint8_t seed_material[48] = {0};
 
-    // Init by software implementation
-    ctx->aesctr256 = &aesctr256_software;
-
-#ifdef HARDWARE_SUPPORT
-    // If hardware implementation is supported then use it
-    if (aes_hardware_supported()) {
-        ctx->aesctr256 = &aesctr256_hardware;
-    }
-#endif
+    // Use the best available implementation
+    secure_rng_set_backend(ctx, RNG_BACKEND_AUTO);
 
     // Check additional entropy buffer length
     if (personalization_len > 0) {
@@ -107,17 +257,27 @@ int secure_rng_seed(struct secure_rng_ctx *ctx, const uint8_t entropy_input[48],
     //  initialized by zeros
     drbg_apply(round_bytes, ctx);
 
+    // Fork detection, statistics, health tests and
+    //  streaming stores are disabled by default
+    ctx->fork_generation = 0;
+    ctx->stats = NULL;
+    ctx->health = NULL;
+    ctx->nontemporal_bytes = RNG_NO_LIMIT;
+    rng_bits_discard(ctx);
+
     // Run first three rounds to calculate
     //  AES key and init counter
     drbg_run_three_rounds(round_bytes, ctx);
     drbg_mix(round_bytes, seed_material);
     drbg_apply(round_bytes, ctx);
-    ctx->reseed_counter = 1;
+    drbg_reset_counters(ctx);
 
     // Prediction resistance is
     //   disabled by default
     ctx->resistance_seeder = NULL;
-    ctx->reseed_interval = kMaxReseedCount;
+    ctx->policy.max_calls = kMaxReseedCount;
+    ctx->policy.max_bytes = RNG_NO_LIMIT;
+    ctx->policy.max_age_ms = RNG_NO_LIMIT;
 
     return RNG_SUCCESS;
 }
@@ -146,22 +306,58 @@ int secure_rng_reseed(struct secure_rng_ctx *ctx, const uint8_t entropy[48], con
     }
 
     // Reset the RNG internal state
+    rng_bits_discard(ctx);
     drbg_run_three_rounds(round_bytes, ctx);
     drbg_mix(round_bytes, entropy_copy);
     drbg_apply(round_bytes, ctx);
-    ctx->reseed_counter = 1;
+    drbg_reset_counters(ctx);
+    rng_stats_reseed(ctx);
 
     return RNG_SUCCESS;
 }
 
-int secure_rng_bytes(struct secure_rng_ctx *ctx, uint8_t *x, size_t xlen, int resistance) {
-    // Buffer for generated block
-    uint8_t block[16] = {0};
+// Reseed with entropy of the seeder function, if there is one
+static int drbg_reseed_from_seeder(struct secure_rng_ctx *ctx) {
     uint8_t state_bytes[48] = {0};
-    const uint8_t *xend = x + xlen;
-    
-    // Remaining length
-    ptrdiff_t xrem = 0;
+
+    // If the prediction resistance is enabled then
+    //   query new entropy and use it to seed a generator
+    if (ctx->resistance_seeder != NULL) {
+        uint64_t seeder_start = rng_stats_now();
+        ctx->resistance_seeder(state_bytes);
+        rng_stats_seeder(ctx, seeder_start);
+
+        // Entropy which fails health tests is never used
+        if (ctx->health != NULL && secure_rng_health_test(ctx->health, state_bytes, sizeof(state_bytes)) != RNG_SUCCESS) {
+            rng_wipe(state_bytes, sizeof(state_bytes));
+            return RNG_HEALTH_FAILURE;
+        }
+
+        secure_rng_reseed(ctx, state_bytes, NULL, 0);
+        rng_wipe(state_bytes, sizeof(state_bytes));
+        return RNG_SUCCESS;
+    }
+
+    // Reseeding is required
+    rng_stats_need_reseed(ctx);
+    return RNG_NEED_RESEED;
+}
+
+// Produce output of secure_rng_bytes, or XOR it into the
+//  buffer, the state is updated the same way in both cases
+inline static int drbg_generate(struct secure_rng_ctx *ctx, uint8_t *x, size_t xlen, int resistance, int xor_out) {
+    // Buffer for generated blocks
+    //  and the state update
+    uint8_t round_bytes[64 + 48];
+
+    // Whole blocks of large requests are generated in place,
+    //  the rest goes along with the state update blocks
+    size_t direct_len = (xlen > 64) ? (xlen & ~(size_t)15) : 0;
+    size_t rest_len = xlen - direct_len;
+    size_t rest_blocks_len = (rest_len + 15) & ~(size_t)15;
+
+    // Statistics timestamp
+    uint64_t start = rng_stats_now();
 
     // Must provide non-NULL pointer and must not
     //  query more than MAX_GENERATE_LENGTH bytes
@@ -169,48 +365,203 @@ int secure_rng_bytes(struct secure_rng_ctx *ctx, uint8_t *x, size_t xlen, int re
         return RNG_BAD_MAXLEN;
     }
 
-    // Request reseeding if either entropy pool is
-    //   exhausted or the caller asked us to do so
-    if (resistance || ctx->reseed_counter > ctx->reseed_interval) {
-        // If the prediction resistance is enabled then
-        //   query new entropy and use it to seed a generator
-        if (ctx->resistance_seeder != NULL) {
-            ctx->resistance_seeder(state_bytes);
-            secure_rng_reseed(ctx, state_bytes, NULL, 0);
+    // Request reseeding if either one of the policy limits
+    //   is exhausted or the caller asked us to do so
+    if (resistance || drbg_reseed_required(ctx)) {
+        int result = drbg_reseed_from_seeder(ctx);
+        if (result != RNG_SUCCESS) {
+            return result;
         }
-        else {
-            // Reseeding is required
-            return RNG_NEED_RESEED;
+    }
+
+    // Counter blocks are consecutive, so each part is
+    //  a single kernel invocation with one key expansion
+    if (direct_len && !xor_out && xlen >= ctx->nontemporal_bytes) {
+        drbg_run_rounds_nontemporal(x, direct_len, ctx);
+    }
+    else if (direct_len) {
+        drbg_run_rounds_with(x, direct_len, ctx, xor_out);
+    }
+    drbg_run_rounds(round_bytes, rest_blocks_len + 48, ctx);
+    if (xor_out) {
+        for (size_t i = 0; i < rest_len; ++i) {
+            x[direct_len + i] ^= round_bytes[i];
         }
     }
+    else {
+        memcpy(x + direct_len, round_bytes, rest_len);
+    }
+
+    // Complete by applying three generation rounds
+    drbg_apply(round_bytes + rest_blocks_len, ctx);
+
+    // Increment reseed counters
+    ctx->reseed_counter++;
+    ctx->reseed_bytes += xlen;
+
+    rng_stats_generate(ctx, xlen, start);
+
+    return RNG_SUCCESS;
+}
+
+int secure_rng_bytes(struct secure_rng_ctx *ctx, uint8_t *x, size_t xlen, int resistance) {
+    return drbg_generate(ctx, x, xlen, resistance, 0);
+}
+
+int secure_rng_xor(struct secure_rng_ctx *ctx, uint8_t *inout, size_t len, int resistance) {
+    return drbg_generate(ctx, inout, len, resistance, 1);
+}
+
+void secure_rng_wipe(void *data, size_t len) {
+    rng_wipe(data, len);
+}
+
+// Fast key erasure: keystream is generated a batch at a time and its
+//  first 32 bytes replace the key right away, so that earlier output
+//  can't be recovered from the state. The rest is served to callers
+//  and wiped as it goes, in place of three extra blocks and a key
+//  expansion per call.
+
+// Largest keystream run generated straight into the output
+#define FKE_DIRECT_LENGTH (MAX_GENERATE_LENGTH & ~15)
+
+// Buffered keystream of the previous state must not outlive a reseed
+inline static void fke_discard(struct secure_rng_fke_ctx *fke) {
+    rng_wipe(fke->buffer + fke->position, RNG_FKE_BUFFER - fke->position);
+    fke->position = RNG_FKE_BUFFER;
+}
+
+static void fke_refill(struct secure_rng_fke_ctx *fke) {
+    drbg_run_rounds(fke->buffer, RNG_FKE_BUFFER, &fke->drbg);
+    memcpy(fke->drbg.Key, fke->buffer, 32);
+    rng_wipe(fke->buffer, 32);
+    fke->position = 32;
+}
+
+// Large requests skip the buffer, the key is replaced after each run
+static void fke_direct(struct secure_rng_fke_ctx *fke, uint8_t *x, size_t bytes) {
+    uint8_t key[32] __attribute__ ((aligned (16)));
+
+    drbg_run_rounds(x, bytes, &fke->drbg);
+    drbg_run_rounds(key, sizeof(key), &fke->drbg);
+    memcpy(fke->drbg.Key, key, sizeof(key));
+    rng_wipe(key, sizeof(key));
+}
+
+int secure_rng_fke_seed(struct secure_rng_fke_ctx *fke, const uint8_t entropy_input[48], const uint8_t *personalization_string, size_t personalization_len) {
+    fke->position = 0;
+    fke_discard(fke);
+    return secure_rng_seed(&fke->drbg, entropy_input, personalization_string, personalization_len);
+}
 
-    // Repeat while amount of remaining
-    //  bytes is greater than zero
-    while ( (xrem = xend - x) ) {
-        
-        if (xrem > 15) {
-            // Generate new block of pseudo random
-            // bytes directly into the result buffer
-            drbg_run_one_round(x, ctx);
-            // Increment x by block size
-            x += 16;
+int secure_rng_fke_reseed(struct secure_rng_fke_ctx *fke, const uint8_t entropy_input[48], const uint8_t *additional_data, size_t additional_data_len) {
+    fke_discard(fke);
+    return secure_rng_reseed(&fke->drbg, entropy_input, additional_data, additional_data_len);
+}
+
+int secure_rng_fke_bytes(struct secure_rng_fke_ctx *fke, uint8_t *x, size_t xlen, int resistance) {
+    struct secure_rng_ctx *ctx = &fke->drbg;
+    uint64_t start = rng_stats_now();
+    size_t total = xlen;
+
+    if (x == NULL) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    // Same policy as secure_rng_bytes
+    if (resistance || drbg_reseed_required(ctx)) {
+        int result = drbg_reseed_from_seeder(ctx);
+        fke_discard(fke);
+        if (result != RNG_SUCCESS) {
+            return result;
         }
-        else {
-            // Generate new block of pseudo random
-            // bytes and copy the requested amount
-            drbg_run_one_round(block, ctx);
-            memcpy(x, block, xrem);
-            // Increment x by xrem
-            x += xrem;
+    }
+
+    // Large requests skip the buffer, the buffered
+    //  keystream is kept for the following ones
+    while (xlen >= RNG_FKE_BUFFER) {
+        size_t len = (xlen < FKE_DIRECT_LENGTH) ? (xlen & ~(size_t)15) : FKE_DIRECT_LENGTH;
+        fke_direct(fke, x, len);
+        x += len;
+        xlen -= len;
+    }
+
+    while (xlen) {
+        if (fke->position == RNG_FKE_BUFFER) {
+            fke_refill(fke);
         }
+
+        size_t available = RNG_FKE_BUFFER - fke->position;
+        size_t part = (xlen < available) ? xlen : available;
+        memcpy(x, fke->buffer + fke->position, part);
+        rng_wipe(fke->buffer + fke->position, part);
+        fke->position += (uint32_t)part;
+        x += part;
+        xlen -= part;
     }
 
-    // Complete by running three generation rounds
-    drbg_run_three_rounds(state_bytes, ctx);
-    drbg_apply(state_bytes, ctx);
-    
-    // Increment reseed counter
     ctx->reseed_counter++;
+    ctx->reseed_bytes += total;
+
+    rng_stats_generate(ctx, total, start);
 
     return RNG_SUCCESS;
 }
+
+// Tiles are grouped into requests which are accounted for like
+//  secure_rng_bytes ones, each is followed by the state update
+inline static size_t drbg_stream_request(size_t tile_size) {
+    return ((MAX_GENERATE_LENGTH & ~15) / tile_size) * tile_size;
+}
+
+int secure_rng_stream(struct secure_rng_ctx *ctx, uint64_t total_len, size_t tile_size, secure_rng_consumer_fn consumer, void *userdata) {
+    uint8_t tile[RNG_STREAM_MAX_TILE] __attribute__ ((aligned (64)));
+    uint8_t round_bytes[48];
+    int result = RNG_SUCCESS, stop = 0;
+
+    if (tile_size == 0) {
+        tile_size = RNG_STREAM_TILE;
+    }
+    if (consumer == NULL || tile_size < 64 || tile_size > RNG_STREAM_MAX_TILE || tile_size % 16 != 0) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    // Output is the same as of secure_rng_bytes invocations of
+    //  request size, partial blocks are discarded the same way
+    while (total_len && !stop) {
+        size_t request = drbg_stream_request(tile_size);
+        uint64_t start = rng_stats_now();
+
+        if (request > total_len) {
+            request = (size_t)total_len;
+        }
+
+        if (drbg_reseed_required(ctx)) {
+            result = drbg_reseed_from_seeder(ctx);
+            if (result != RNG_SUCCESS) {
+                break;
+            }
+        }
+
+        for (size_t done = 0; done < request && !stop; done += tile_size) {
+            size_t len = (request - done < tile_size) ? request - done : tile_size;
+            drbg_run_rounds(tile, (len + 15) & ~(size_t)15, ctx);
+            stop = consumer(tile, len, userdata);
+        }
+
+        // The state is updated even if the consumer stopped early,
+        //  keystream it has seen can't be produced again
+        drbg_run_three_rounds(round_bytes, ctx);
+        drbg_apply(round_bytes, ctx);
+
+        ctx->reseed_counter++;
+        ctx->reseed_bytes += request;
+        total_len -= request;
+
+        rng_stats_generate(ctx, request, start);
+    }
+
+    rng_wipe(tile, sizeof(tile));
+    rng_wipe(round_bytes, sizeof(round_bytes));
+    return result;
+}
@@ -0,0 +1,182 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include "secure-rng.h"
+#include "wipe.h"
+
+#define SEED_FILE_SIZE 48
+
+// Collect fresh entropy without blocking, the seed file
+//  compensates for the weakness of early boot entropy
+static int seed_file_fresh_entropy(uint8_t entropy[48]) {
+    ssize_t result;
+
+    do {
+        result = getrandom(entropy, 48, GRND_NONBLOCK);
+    } while (result < 0 && errno == EINTR);
+
+#ifdef GRND_INSECURE
+    // Pool isn't initialized yet
+    if (result < 0 && errno == EAGAIN) {
+        result = getrandom(entropy, 48, GRND_INSECURE);
+    }
+#endif
+
+    if (result != 48) {
+        // Old kernels: urandom device never blocks
+        int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return RNG_IO_ERROR;
+        }
+        result = read(fd, entropy, 48);
+        close(fd);
+    }
+
+    return (result == 48) ? RNG_SUCCESS : RNG_IO_ERROR;
+}
+
+// Open and exclusively lock the seed file. The file is replaced
+//  by rename, so make sure that the locked inode is still there
+static int seed_file_lock(const char *path) {
+    struct stat locked, current;
+
+    for (;;) {
+        int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            return -1;
+        }
+
+        if (flock(fd, LOCK_EX) == 0 && fstat(fd, &locked) == 0 && stat(path, &current) == 0) {
+            if (locked.st_dev == current.st_dev && locked.st_ino == current.st_ino) {
+                return fd;
+            }
+        }
+        else if (errno != EINTR && errno != ENOENT) {
+            close(fd);
+            return -1;
+        }
+
+        // Lost the race with a writer, try again
+        close(fd);
+    }
+}
+
+// Atomically replace the seed file with fresh generator output,
+//  must be invoked while the seed file lock is held
+static int seed_file_replace(struct secure_rng_ctx *ctx, const char *path) {
+    uint8_t seed[SEED_FILE_SIZE];
+    char temp_path[4096];
+    char dir_path[4096];
+    const char *slash;
+    int result = RNG_IO_ERROR;
+    int fd, dir_fd;
+
+    if (snprintf(temp_path, sizeof(temp_path), "%s.tmp", path) >= (int)sizeof(temp_path)) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    result = secure_rng_bytes(ctx, seed, sizeof(seed), 0);
+    if (result != RNG_SUCCESS) {
+        return result;
+    }
+    result = RNG_IO_ERROR;
+
+    fd = open(temp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd >= 0) {
+        if (write(fd, seed, sizeof(seed)) == sizeof(seed) && fsync(fd) == 0) {
+            result = RNG_SUCCESS;
+        }
+        close(fd);
+    }
+    rng_wipe(seed, sizeof(seed));
+
+    if (result != RNG_SUCCESS || rename(temp_path, path) != 0) {
+        unlink(temp_path);
+        return RNG_IO_ERROR;
+    }
+
+    // Persist the rename itself
+    slash = strrchr(path, '/');
+    if (slash == NULL) {
+        strcpy(dir_path, ".");
+    }
+    else {
+        size_t dir_len = (slash == path) ? 1 : (size_t)(slash - path);
+        memcpy(dir_path, path, dir_len);
+        dir_path[dir_len] = '\0';
+    }
+
+    dir_fd = open(dir_path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd >= 0) {
+        fsync(dir_fd);
+        close(dir_fd);
+    }
+
+    return RNG_SUCCESS;
+}
+
+int secure_rng_seed_from_file(struct secure_rng_ctx *ctx, const char *path) {
+    uint8_t entropy[48];
+    uint8_t seed[SEED_FILE_SIZE];
+    ssize_t seed_len = 0;
+    int result;
+    int fd;
+
+    fd = seed_file_lock(path);
+    if (fd < 0) {
+        return RNG_IO_ERROR;
+    }
+
+    // Missing or truncated seed file is not an
+    //  error, there is none on the very first boot
+    while (seed_len < SEED_FILE_SIZE) {
+        ssize_t chunk = read(fd, seed + seed_len, SEED_FILE_SIZE - seed_len);
+        if (chunk < 0 && errno == EINTR) {
+            continue;
+        }
+        if (chunk <= 0) {
+            break;
+        }
+        seed_len += chunk;
+    }
+    if (seed_len != SEED_FILE_SIZE) {
+        seed_len = 0;
+    }
+
+    result = seed_file_fresh_entropy(entropy);
+    if (result == RNG_SUCCESS) {
+        // Seed file goes through personalization path
+        result = secure_rng_seed(ctx, entropy, seed, seed_len);
+    }
+
+    // Never let the same seed be used twice
+    if (result == RNG_SUCCESS) {
+        result = seed_file_replace(ctx, path);
+    }
+
+    rng_wipe(entropy, sizeof(entropy));
+    rng_wipe(seed, sizeof(seed));
+    close(fd);
+
+    return result;
+}
+
+int secure_rng_save_seed_file(struct secure_rng_ctx *ctx, const char *path) {
+    int result;
+    int fd;
+
+    fd = seed_file_lock(path);
+    if (fd < 0) {
+        return RNG_IO_ERROR;
+    }
+
+    result = seed_file_replace(ctx, path);
+    close(fd);
+
+    return result;
+}
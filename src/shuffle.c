@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <string.h>
+#include "secure-rng.h"
+#include "wipe.h"
+
+#define SHUFFLE_WORDS   1024    // 32-bit keystream words drawn at a time
+#define SHUFFLE_BATCH   32      // swaps whose targets are prefetched ahead
+#define SHUFFLE_EMPTY   SIZE_MAX
+
+// Bulk keystream for bounded draws, errors are
+//  sticky and checked once per batch
+struct shuffle_draws {
+    struct secure_rng_ctx *ctx;
+    uint32_t words[SHUFFLE_WORDS];
+    size_t position;
+    int result;
+};
+
+static void shuffle_refill(struct shuffle_draws *draws) {
+    int result = secure_rng_bytes(draws->ctx, (uint8_t *)draws->words, sizeof(draws->words), 0);
+    if (result != RNG_SUCCESS) {
+        // Keep going on zeroes, the caller discards the result
+        memset(draws->words, 0, sizeof(draws->words));
+        draws->result = result;
+    }
+    draws->position = 0;
+}
+
+static inline uint32_t shuffle_next32(struct shuffle_draws *draws) {
+    if (draws->position == SHUFFLE_WORDS) {
+        shuffle_refill(draws);
+    }
+    return draws->words[draws->position++];
+}
+
+static inline uint64_t shuffle_next64(struct shuffle_draws *draws) {
+    uint64_t high = shuffle_next32(draws);
+    return (high << 32) | shuffle_next32(draws);
+}
+
+// Lemire's nearly divisionless method, uniform in [0, range)
+static inline uint32_t shuffle_bounded32(struct shuffle_draws *draws, uint32_t range) {
+    uint64_t m = (uint64_t)shuffle_next32(draws) * range;
+    uint32_t low = (uint32_t)m;
+
+    if (low < range) {
+        uint32_t threshold = -range % range;
+        while (low < threshold) {
+            m = (uint64_t)shuffle_next32(draws) * range;
+            low = (uint32_t)m;
+        }
+    }
+
+    return (uint32_t)(m >> 32);
+}
+
+static inline uint64_t shuffle_bounded64(struct shuffle_draws *draws, uint64_t range) {
+    __uint128_t m = (__uint128_t)shuffle_next64(draws) * range;
+    uint64_t low = (uint64_t)m;
+
+    if (low < range) {
+        uint64_t threshold = -range % range;
+        while (low < threshold) {
+            m = (__uint128_t)shuffle_next64(draws) * range;
+            low = (uint64_t)m;
+        }
+    }
+
+    return (uint64_t)(m >> 64);
+}
+
+static inline size_t shuffle_bounded(struct shuffle_draws *draws, size_t range) {
+    return (range <= UINT32_MAX) ? shuffle_bounded32(draws, (uint32_t)range) : shuffle_bounded64(draws, range);
+}
+
+// Element size is a constant for the common sizes once inlined
+__attribute__ ((always_inline))
+static inline void shuffle_swap(uint8_t *a, uint8_t *b, size_t size) {
+    uint8_t tmp[64];
+
+    while (size > sizeof(tmp)) {
+        memcpy(tmp, a, sizeof(tmp));
+        memcpy(a, b, sizeof(tmp));
+        memcpy(b, tmp, sizeof(tmp));
+        a += sizeof(tmp);
+        b += sizeof(tmp);
+        size -= sizeof(tmp);
+    }
+
+    memcpy(tmp, a, size);
+    memcpy(a, b, size);
+    memcpy(b, tmp, size);
+}
+
+// Fisher-Yates from the top. Swap targets of a whole batch are drawn
+//  and prefetched first, so that their cache misses overlap instead
+//  of stalling each swap in turn.
+__attribute__ ((always_inline))
+static inline void shuffle_run(struct shuffle_draws *draws, uint8_t *base, size_t n, size_t size) {
+    size_t targets[SHUFFLE_BATCH];
+    size_t i = n;
+
+    while (i > 1 && draws->result == RNG_SUCCESS) {
+        size_t batch = (i - 1 < SHUFFLE_BATCH) ? i - 1 : SHUFFLE_BATCH;
+
+        for (size_t b = 0; b < batch; ++b) {
+            targets[b] = shuffle_bounded(draws, i - b);
+            __builtin_prefetch(base + targets[b] * size, 1);
+            if (size > 1) {
+                // Elements may straddle cache lines
+                __builtin_prefetch(base + targets[b] * size + size - 1, 1);
+            }
+        }
+
+        for (size_t b = 0; b < batch; ++b) {
+            size_t last = i - 1 - b;
+            if (targets[b] != last) {
+                shuffle_swap(base + last * size, base + targets[b] * size, size);
+            }
+        }
+
+        i -= batch;
+    }
+
+    rng_wipe(targets, sizeof(targets));
+}
+
+static void shuffle_any(struct shuffle_draws *draws, void *base, size_t n, size_t size) {
+    switch (size) {
+        case 1:  shuffle_run(draws, base, n, 1); break;
+        case 2:  shuffle_run(draws, base, n, 2); break;
+        case 4:  shuffle_run(draws, base, n, 4); break;
+        case 8:  shuffle_run(draws, base, n, 8); break;
+        case 16: shuffle_run(draws, base, n, 16); break;
+        default: shuffle_run(draws, base, n, size); break;
+    }
+}
+
+int secure_rng_shuffle(struct secure_rng_ctx *ctx, void *base, size_t n, size_t elem_size) {
+    struct shuffle_draws draws;
+
+    if (elem_size == 0 || n > SIZE_MAX / elem_size) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    draws.ctx = ctx;
+    draws.position = SHUFFLE_WORDS;
+    draws.result = RNG_SUCCESS;
+
+    shuffle_any(&draws, base, n, elem_size);
+
+    rng_wipe(draws.words, sizeof(draws.words));
+    return draws.result;
+}
+
+// Set of chosen indices: a bitmap if it's not much larger
+//  than a hash table for k entries would be
+struct sample_set {
+    uint64_t *bits;
+    size_t *slots;
+    size_t mask;
+};
+
+static int sample_set_init(struct sample_set *set, size_t n, size_t k) {
+    memset(set, 0, sizeof(*set));
+
+    if (n / 64 <= k) {
+        set->bits = calloc(n / 64 + 1, sizeof(uint64_t));
+        return set->bits != NULL;
+    }
+
+    // Load factor of at most one half
+    size_t capacity = 16;
+    while (capacity < 2 * k) {
+        capacity <<= 1;
+    }
+    set->slots = malloc(capacity * sizeof(size_t));
+    if (set->slots == NULL) {
+        return 0;
+    }
+    memset(set->slots, 0xff, capacity * sizeof(size_t));
+    set->mask = capacity - 1;
+    return 1;
+}
+
+// Returns 0 if the value is already in the set
+static int sample_set_insert(struct sample_set *set, size_t value) {
+    if (set->bits != NULL) {
+        uint64_t bit = UINT64_C(1) << (value % 64);
+        if (set->bits[value / 64] & bit) {
+            return 0;
+        }
+        set->bits[value / 64] |= bit;
+        return 1;
+    }
+
+    size_t slot = (size_t)(((uint64_t)value * UINT64_C(0x9e3779b97f4a7c15)) >> 32) & set->mask;
+    while (set->slots[slot] != SHUFFLE_EMPTY) {
+        if (set->slots[slot] == value) {
+            return 0;
+        }
+        slot = (slot + 1) & set->mask;
+    }
+    set->slots[slot] = value;
+    return 1;
+}
+
+static void sample_set_free(struct sample_set *set) {
+    free(set->bits);
+    free(set->slots);
+}
+
+int secure_rng_sample_indices(struct secure_rng_ctx *ctx, size_t n, size_t k, size_t *out) {
+    struct shuffle_draws draws;
+    struct sample_set set;
+
+    if (k > n) {
+        return RNG_BAD_MAXLEN;
+    }
+    if (k == 0) {
+        return RNG_SUCCESS;
+    }
+
+    // All of them, just in random order
+    if (k == n) {
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = i;
+        }
+        return secure_rng_shuffle(ctx, out, n, sizeof(size_t));
+    }
+
+    if (!sample_set_init(&set, n, k)) {
+        return RNG_IO_ERROR;
+    }
+
+    draws.ctx = ctx;
+    draws.position = SHUFFLE_WORDS;
+    draws.result = RNG_SUCCESS;
+
+    // Floyd's algorithm: k draws and no retries, each
+    //  k-subset of [0, n) is chosen with equal probability
+    for (size_t j = n - k, count = 0; j < n; ++j, ++count) {
+        size_t t = shuffle_bounded(&draws, j + 1);
+        if (!sample_set_insert(&set, t)) {
+            t = j;
+            sample_set_insert(&set, t);
+        }
+        out[count] = t;
+    }
+
+    // Order of Floyd's output isn't uniform, shuffle it too
+    shuffle_any(&draws, out, k, sizeof(size_t));
+
+    sample_set_free(&set);
+    rng_wipe(draws.words, sizeof(draws.words));
+    return draws.result;
+}
@@ -0,0 +1,134 @@
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aes.h"
+#include "stats.h"
+
+#ifdef SECURE_RNG_STATS
+
+// Per thread counters are linked together, counters
+//  of finished threads are folded into the retired ones
+struct stats_block {
+    struct secure_rng_stats stats;
+    struct stats_block *next;
+};
+
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t stats_once = PTHREAD_ONCE_INIT;
+static pthread_key_t stats_key;
+static struct stats_block *stats_blocks = NULL;
+static struct secure_rng_stats stats_retired;
+static __thread struct stats_block *stats_current = NULL;
+
+// Threads which failed to allocate a block count into their own
+//  unlinked one, so the counters stay usable but aren't reported
+static __thread struct stats_block stats_discard;
+
+static void stats_accumulate(struct secure_rng_stats *to, const struct secure_rng_stats *from) {
+    to->calls += __atomic_load_n(&from->calls, __ATOMIC_RELAXED);
+    to->bytes += __atomic_load_n(&from->bytes, __ATOMIC_RELAXED);
+    to->reseeds += __atomic_load_n(&from->reseeds, __ATOMIC_RELAXED);
+    to->need_reseed += __atomic_load_n(&from->need_reseed, __ATOMIC_RELAXED);
+    to->seeder_calls += __atomic_load_n(&from->seeder_calls, __ATOMIC_RELAXED);
+    for (int i = 0; i < RNG_STATS_BUCKETS; ++i) {
+        to->generate_ns[i] += __atomic_load_n(&from->generate_ns[i], __ATOMIC_RELAXED);
+        to->seeder_ns[i] += __atomic_load_n(&from->seeder_ns[i], __ATOMIC_RELAXED);
+    }
+}
+
+static void stats_thread_exit(void *data) {
+    struct stats_block *block = (struct stats_block *)data;
+    struct stats_block **link;
+
+    pthread_mutex_lock(&stats_lock);
+    for (link = &stats_blocks; *link != NULL; link = &(*link)->next) {
+        if (*link == block) {
+            *link = block->next;
+            break;
+        }
+    }
+    stats_accumulate(&stats_retired, &block->stats);
+    pthread_mutex_unlock(&stats_lock);
+
+    // Destructors which run later on this thread may still generate
+    stats_current = &stats_discard;
+    free(block);
+}
+
+static void stats_init(void) {
+    pthread_key_create(&stats_key, &stats_thread_exit);
+}
+
+struct secure_rng_stats *rng_stats_thread(void) {
+    struct stats_block *block = stats_current;
+
+    if (block != NULL) {
+        return &block->stats;
+    }
+
+    pthread_once(&stats_once, &stats_init);
+
+    block = (struct stats_block *)calloc(1, sizeof(*block));
+    if (block == NULL) {
+        stats_current = &stats_discard;
+        return &stats_discard.stats;
+    }
+
+    pthread_mutex_lock(&stats_lock);
+    block->next = stats_blocks;
+    stats_blocks = block;
+    pthread_mutex_unlock(&stats_lock);
+
+    pthread_setspecific(stats_key, block);
+    stats_current = block;
+
+    return &block->stats;
+}
+
+#endif
+
+int secure_rng_enable_stats(struct secure_rng_ctx *ctx, struct secure_rng_stats *stats) {
+#ifdef SECURE_RNG_STATS
+    if (stats != NULL) {
+        memset(stats, 0, sizeof(*stats));
+    }
+    ctx->stats = stats;
+    return RNG_SUCCESS;
+#else
+    (void)stats;
+    ctx->stats = NULL;
+    return RNG_NOT_SUPPORTED;
+#endif
+}
+
+int secure_rng_stats_snapshot(const struct secure_rng_ctx *ctx, struct secure_rng_stats *snapshot) {
+#ifdef SECURE_RNG_STATS
+    memset(snapshot, 0, sizeof(*snapshot));
+
+    if (ctx != NULL) {
+        if (ctx->stats == NULL) {
+            return RNG_NOT_SUPPORTED;
+        }
+        stats_accumulate(snapshot, ctx->stats);
+        snapshot->backend = aes_backend_id(ctx->aesctr256);
+        return RNG_SUCCESS;
+    }
+
+    pthread_once(&stats_once, &stats_init);
+
+    pthread_mutex_lock(&stats_lock);
+    stats_accumulate(snapshot, &stats_retired);
+    for (struct stats_block *block = stats_blocks; block != NULL; block = block->next) {
+        stats_accumulate(snapshot, &block->stats);
+    }
+    pthread_mutex_unlock(&stats_lock);
+
+    // Global backend is the automatically chosen one
+    snapshot->backend = aes_backend_id(aes_backend_function(RNG_BACKEND_AUTO));
+    return RNG_SUCCESS;
+#else
+    (void)ctx;
+    memset(snapshot, 0, sizeof(*snapshot));
+    return RNG_NOT_SUPPORTED;
+#endif
+}
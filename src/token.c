@@ -0,0 +1,313 @@
+#include <string.h>
+#include "secure-rng.h"
+#include "wipe.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#define TOKEN_BYTES     4080    // keystream bytes per generator invocation, 85 * 48
+#define UUID_BATCH      256     // UUIDs per generator invocation
+
+static const char token_hex[] = RNG_ALPHABET_HEX;
+static const char token_base64url[] = RNG_ALPHABET_BASE64URL;
+static const char token_base62[] = RNG_ALPHABET_BASE62;
+
+// Lowercase hex of 16 bytes, 32 characters
+static inline void token_hex16(char *out, const uint8_t *in) {
+#if defined(__SSE2__)
+    __m128i x = _mm_loadu_si128((const __m128i *)in);
+    __m128i low_nibbles = _mm_set1_epi8(0x0f);
+    __m128i high = _mm_and_si128(_mm_srli_epi16(x, 4), low_nibbles);
+    __m128i low = _mm_and_si128(x, low_nibbles);
+
+    // Digits above 9 are shifted from ':' to 'a'
+    __m128i nine = _mm_set1_epi8(9), zero = _mm_set1_epi8('0'), gap = _mm_set1_epi8('a' - '0' - 10);
+    high = _mm_add_epi8(_mm_add_epi8(high, zero), _mm_and_si128(_mm_cmpgt_epi8(high, nine), gap));
+    low = _mm_add_epi8(_mm_add_epi8(low, zero), _mm_and_si128(_mm_cmpgt_epi8(low, nine), gap));
+
+    _mm_storeu_si128((__m128i *)out, _mm_unpacklo_epi8(high, low));
+    _mm_storeu_si128((__m128i *)(out + 16), _mm_unpackhi_epi8(high, low));
+#elif defined(__ARM_NEON)
+    uint8x16_t table = vld1q_u8((const uint8_t *)token_hex);
+    uint8x16_t x = vld1q_u8(in);
+    uint8x16x2_t pairs = vzipq_u8(vqtbl1q_u8(table, vshrq_n_u8(x, 4)), vqtbl1q_u8(table, vandq_u8(x, vdupq_n_u8(0x0f))));
+    vst1q_u8((uint8_t *)out, pairs.val[0]);
+    vst1q_u8((uint8_t *)out + 16, pairs.val[1]);
+#else
+    for (int i = 0; i < 16; ++i) {
+        out[2 * i] = token_hex[in[i] >> 4];
+        out[2 * i + 1] = token_hex[in[i] & 0x0f];
+    }
+#endif
+}
+
+// Base64url of 48 bytes, 64 characters. Input is random, so 6-bit
+//  values are taken wherever it's cheapest instead of in RFC 4648
+//  order: the low 6 bits of each byte, then the top 2 bits of
+//  three bytes at a time
+static inline void token_base64url48(char *out, const uint8_t *in) {
+#if defined(__SSE2__)
+    __m128i v0 = _mm_loadu_si128((const __m128i *)in);
+    __m128i v1 = _mm_loadu_si128((const __m128i *)(in + 16));
+    __m128i v2 = _mm_loadu_si128((const __m128i *)(in + 32));
+    __m128i six = _mm_set1_epi8(0x3f), two = _mm_set1_epi8(0x03);
+    __m128i top = _mm_or_si128(_mm_and_si128(_mm_srli_epi16(v0, 6), two),
+                  _mm_or_si128(_mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v1, 6), two), 2),
+                               _mm_slli_epi16(_mm_and_si128(_mm_srli_epi16(v2, 6), two), 4)));
+    __m128i values[4] = { _mm_and_si128(v0, six), _mm_and_si128(v1, six), _mm_and_si128(v2, six), top };
+
+    // 'A' + v, then shifted for each of the following ranges
+    for (int k = 0; k < 4; ++k) {
+        __m128i v = values[k];
+        __m128i offset = _mm_set1_epi8('A');
+        offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(25)), _mm_set1_epi8('a' - 26 - 'A')));
+        offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(51)), _mm_set1_epi8('0' - 52 - ('a' - 26))));
+        offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(61)), _mm_set1_epi8('-' - 62 - ('0' - 52))));
+        offset = _mm_add_epi8(offset, _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(62)), _mm_set1_epi8('_' - 63 - ('-' - 62))));
+        _mm_storeu_si128((__m128i *)(out + 16 * k), _mm_add_epi8(v, offset));
+    }
+#elif defined(__ARM_NEON)
+    uint8x16x4_t table = vld1q_u8_x4((const uint8_t *)token_base64url);
+    uint8x16_t v0 = vld1q_u8(in), v1 = vld1q_u8(in + 16), v2 = vld1q_u8(in + 32);
+    uint8x16_t six = vdupq_n_u8(0x3f);
+    uint8x16_t top = vorrq_u8(vshrq_n_u8(v0, 6), vorrq_u8(vshlq_n_u8(vshrq_n_u8(v1, 6), 2), vshlq_n_u8(vshrq_n_u8(v2, 6), 4)));
+    vst1q_u8((uint8_t *)out, vqtbl4q_u8(table, vandq_u8(v0, six)));
+    vst1q_u8((uint8_t *)out + 16, vqtbl4q_u8(table, vandq_u8(v1, six)));
+    vst1q_u8((uint8_t *)out + 32, vqtbl4q_u8(table, vandq_u8(v2, six)));
+    vst1q_u8((uint8_t *)out + 48, vqtbl4q_u8(table, top));
+#else
+    for (int i = 0; i < 16; ++i) {
+        out[i] = token_base64url[in[i] & 0x3f];
+        out[16 + i] = token_base64url[in[16 + i] & 0x3f];
+        out[32 + i] = token_base64url[in[32 + i] & 0x3f];
+        out[48 + i] = token_base64url[(in[i] >> 6) | ((in[16 + i] >> 6) << 2) | ((in[32 + i] >> 6) << 4)];
+    }
+#endif
+}
+
+// Lemire's method on bytes: b * size is split into the index, its
+//  high byte, and the low byte, which must be at least 256 % size
+//  for the index to be uniform. Bit i of the result is set if byte
+//  i is accepted, indices of all 16 bytes are stored.
+static inline unsigned token_lemire16(const uint8_t *in, unsigned size, unsigned threshold, uint8_t index[16]) {
+#if defined(__SSE2__)
+    __m128i x = _mm_loadu_si128((const __m128i *)in);
+    __m128i zero = _mm_setzero_si128(), multiplier = _mm_set1_epi16((short)size);
+    __m128i low = _mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), multiplier);
+    __m128i high = _mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), multiplier);
+    __m128i bytes = _mm_set1_epi16(0xff), limit = _mm_set1_epi16((short)threshold - 1);
+    __m128i accept = _mm_packs_epi16(_mm_cmpgt_epi16(_mm_and_si128(low, bytes), limit),
+                                     _mm_cmpgt_epi16(_mm_and_si128(high, bytes), limit));
+    _mm_storeu_si128((__m128i *)index, _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+    return (unsigned)_mm_movemask_epi8(accept);
+#elif defined(__ARM_NEON)
+    static const uint8_t weights[16] = { 1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t x = vld1q_u8(in);
+    uint8x8_t multiplier = vdup_n_u8((uint8_t)size);
+    uint16x8_t low = vmull_u8(vget_low_u8(x), multiplier);
+    uint16x8_t high = vmull_u8(vget_high_u8(x), multiplier);
+    uint8x16_t accept = vcgeq_u8(vcombine_u8(vmovn_u16(low), vmovn_u16(high)), vdupq_n_u8((uint8_t)threshold));
+    vst1q_u8(index, vcombine_u8(vshrn_n_u16(low, 8), vshrn_n_u16(high, 8)));
+    uint8x16_t bits = vandq_u8(accept, vld1q_u8(weights));
+    return vaddv_u8(vget_low_u8(bits)) | ((unsigned)vaddv_u8(vget_high_u8(bits)) << 8);
+#else
+    unsigned mask = 0;
+    for (int i = 0; i < 16; ++i) {
+        unsigned m = in[i] * size;
+        index[i] = (uint8_t)(m >> 8);
+        mask |= (unsigned)((m & 0xff) >= threshold) << i;
+    }
+    return mask;
+#endif
+}
+
+static int token_hex_run(struct secure_rng_ctx *ctx, uint8_t *keystream, char *out, size_t len) {
+    while (len) {
+        size_t chars = (len < 2 * TOKEN_BYTES) ? len : 2 * TOKEN_BYTES;
+        size_t blocks = (chars + 31) / 32;
+        int result = secure_rng_bytes(ctx, keystream, blocks * 16, 0);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+
+        size_t whole = chars / 32;
+        for (size_t i = 0; i < whole; ++i) {
+            token_hex16(out + 32 * i, keystream + 16 * i);
+        }
+        if (whole < blocks) {
+            char tail[32];
+            token_hex16(tail, keystream + 16 * whole);
+            memcpy(out + 32 * whole, tail, chars - 32 * whole);
+            rng_wipe(tail, sizeof(tail));
+        }
+
+        rng_wipe(keystream, blocks * 16);
+        out += chars;
+        len -= chars;
+    }
+    return RNG_SUCCESS;
+}
+
+static int token_base64url_run(struct secure_rng_ctx *ctx, uint8_t *keystream, char *out, size_t len) {
+    while (len) {
+        size_t chars = (len < TOKEN_BYTES / 48 * 64) ? len : TOKEN_BYTES / 48 * 64;
+        size_t groups = (chars + 63) / 64;
+        int result = secure_rng_bytes(ctx, keystream, groups * 48, 0);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+
+        size_t whole = chars / 64;
+        for (size_t i = 0; i < whole; ++i) {
+            token_base64url48(out + 64 * i, keystream + 48 * i);
+        }
+        if (whole < groups) {
+            char tail[64];
+            token_base64url48(tail, keystream + 48 * whole);
+            memcpy(out + 64 * whole, tail, chars - 64 * whole);
+            rng_wipe(tail, sizeof(tail));
+        }
+
+        rng_wipe(keystream, groups * 48);
+        out += chars;
+        len -= chars;
+    }
+    return RNG_SUCCESS;
+}
+
+// Any other alphabet: one byte per character, with rejection.
+//  Accepted characters are compacted without branching on the mask.
+static int token_reject_run(struct secure_rng_ctx *ctx, uint8_t *keystream, const char *alphabet, unsigned size, char *out, size_t len) {
+    unsigned threshold = 256 % size;
+    uint8_t index[16];
+    char chars[16];
+    size_t done = 0;
+
+    while (done < len) {
+        // Expected need plus a margin, so that one round is usually enough
+        size_t want = (len - done) * 256 / (256 - threshold) + 16;
+        want = (want < TOKEN_BYTES) ? (want + 15) & ~(size_t)15 : TOKEN_BYTES;
+        int result = secure_rng_bytes(ctx, keystream, want, 0);
+        if (result != RNG_SUCCESS) {
+            return result;
+        }
+
+        for (size_t i = 0; i < want && done < len; i += 16) {
+            unsigned mask = token_lemire16(keystream + i, size, threshold, index);
+            size_t accepted = 0;
+
+            for (int j = 0; j < 16; ++j) {
+                chars[accepted] = alphabet[index[j]];
+                accepted += (mask >> j) & 1;
+            }
+
+            if (accepted > len - done) {
+                accepted = len - done;
+            }
+            memcpy(out + done, chars, accepted);
+            done += accepted;
+        }
+
+        rng_wipe(keystream, want);
+    }
+
+    rng_wipe(index, sizeof(index));
+    rng_wipe(chars, sizeof(chars));
+    return RNG_SUCCESS;
+}
+
+// Characters must be distinct, or some would be more likely
+static int token_alphabet_valid(const char *alphabet, size_t size) {
+    uint8_t seen[32] = {0};
+
+    if (size < 2) {
+        return 0;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        uint8_t c = (uint8_t)alphabet[i];
+        if (seen[c / 8] & (1 << (c % 8))) {
+            return 0;
+        }
+        seen[c / 8] |= 1 << (c % 8);
+    }
+    return 1;
+}
+
+int secure_rng_token(struct secure_rng_ctx *ctx, const char *alphabet, char *out, size_t len) {
+    uint8_t keystream[TOKEN_BYTES] __attribute__ ((aligned (16)));
+    size_t size;
+    int result;
+
+    if (alphabet == NULL || out == NULL) {
+        return RNG_BAD_MAXLEN;
+    }
+
+    if (!strcmp(alphabet, token_hex)) {
+        result = token_hex_run(ctx, keystream, out, len);
+    }
+    else if (!strcmp(alphabet, token_base64url)) {
+        result = token_base64url_run(ctx, keystream, out, len);
+    }
+    else if (!strcmp(alphabet, token_base62)) {
+        result = token_reject_run(ctx, keystream, alphabet, sizeof(token_base62) - 1, out, len);
+    }
+    else if (token_alphabet_valid(alphabet, size = strlen(alphabet))) {
+        result = token_reject_run(ctx, keystream, alphabet, (unsigned)size, out, len);
+    }
+    else {
+        return RNG_BAD_MAXLEN;
+    }
+
+    if (result != RNG_SUCCESS) {
+        memset(out, 0, len + 1);
+        return result;
+    }
+
+    out[len] = '\0';
+    return RNG_SUCCESS;
+}
+
+int secure_rng_uuid4_batch(struct secure_rng_ctx *ctx, char *out, size_t n) {
+    uint8_t keystream[UUID_BATCH * 16] __attribute__ ((aligned (16)));
+    char hex[32];
+
+    for (size_t done = 0; done < n; ) {
+        size_t batch = (n - done < UUID_BATCH) ? n - done : UUID_BATCH;
+        int result = secure_rng_bytes(ctx, keystream, batch * 16, 0);
+        if (result != RNG_SUCCESS) {
+            rng_wipe(hex, sizeof(hex));
+            memset(out, 0, n * RNG_UUID_STRLEN);
+            return result;
+        }
+
+        for (size_t i = 0; i < batch; ++i) {
+            uint8_t *uuid = keystream + 16 * i;
+            char *text = out + (done + i) * RNG_UUID_STRLEN;
+
+            // Version 4, variant 10 of RFC 9562
+            uuid[6] = (uuid[6] & 0x0f) | 0x40;
+            uuid[8] = (uuid[8] & 0x3f) | 0x80;
+            token_hex16(hex, uuid);
+
+            memcpy(text, hex, 8);
+            text[8] = '-';
+            memcpy(text + 9, hex + 8, 4);
+            text[13] = '-';
+            memcpy(text + 14, hex + 12, 4);
+            text[18] = '-';
+            memcpy(text + 19, hex + 16, 4);
+            text[23] = '-';
+            memcpy(text + 24, hex + 20, 12);
+            text[36] = '\0';
+        }
+
+        rng_wipe(keystream, batch * 16);
+        done += batch;
+    }
+
+    rng_wipe(hex, sizeof(hex));
+    return RNG_SUCCESS;
+}
@@ -61,7 +61,13 @@ static __m128i increment_be (__m128i x) {
     return x;
 }
 
-static void aesctr256_direct_x4 (uint8_t *out, const __m128i *rkeys, const void *counter, size_t bytes) {
+// Keystream is either stored or XORed into the output, xor_out
+//  is a constant in each caller so the branch is folded away
+#define STORE_BLOCK(p, s) \
+    _mm_storeu_si128 ((p), xor_out ? _mm_xor_si128 (_mm_loadu_si128 (p), (s)) : (s))
+
+static inline __attribute__ ((always_inline))
+void aesctr256_direct_x4 (uint8_t *out, const __m128i *rkeys, const void *counter, size_t bytes, int xor_out) {
     __m128i s1, s2, s3, s4;
     __m128i ctr, *bo;
     /* bytes will always be a multiple of 16 */
@@ -140,10 +146,10 @@ static void aesctr256_direct_x4 (uint8_t *out, const __m128i *rkeys, const void
         s3 = _mm_aesenclast_si128 (s3, rkeys[14]);
         s4 = _mm_aesenclast_si128 (s4, rkeys[14]);
 
-        _mm_storeu_si128 (bo + i, s1);
-        _mm_storeu_si128 (bo + i + 1, s2);
-        _mm_storeu_si128 (bo + i + 2, s3);
-        _mm_storeu_si128 (bo + i + 3, s4);
+        STORE_BLOCK (bo + i, s1);
+        STORE_BLOCK (bo + i + 1, s2);
+        STORE_BLOCK (bo + i + 2, s3);
+        STORE_BLOCK (bo + i + 3, s4);
     }
     for (i = 0; i < blocks_left; i++) {
         s1 = _mm_xor_si128 (ctr, rkeys[0]);
@@ -162,7 +168,7 @@ static void aesctr256_direct_x4 (uint8_t *out, const __m128i *rkeys, const void
         s1 = _mm_aesenc_si128 (s1, rkeys[12]);
         s1 = _mm_aesenc_si128 (s1, rkeys[13]);
         s1 = _mm_aesenclast_si128 (s1, rkeys[14]);
-        _mm_storeu_si128 (bo + blocks_parallel + i, s1);
+        STORE_BLOCK (bo + blocks_parallel + i, s1);
     }
 }
 
@@ -171,11 +177,23 @@ void aesctr256_zeroiv_hardware (uint8_t *out, const uint8_t *sk, int bytes) {
     aesctr256_hardware(out, sk, counter, bytes);
 }
 
-void aesctr256_hardware (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+AES_KERNEL void aesctr256_hardware (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+    __m128i rkeys[15];
+    expand256 (rkeys, (__m128i *)k);
+    aesctr256_direct_x4 (out, rkeys, counter, bytes, 0);
+}
+
+AES_KERNEL void aesctr256_xor_hardware (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
     __m128i rkeys[15];
     expand256 (rkeys, (__m128i *)k);
-    aesctr256_direct_x4 (out, rkeys, counter, bytes);
+    aesctr256_direct_x4 (out, rkeys, counter, bytes, 1);
+}
+
+#ifdef HARDWARE_VAES
+AES_KERNEL void aes256_expand_hardware (void *rkeys, const uint8_t *k) {
+    expand256 ((__m128i *)rkeys, (const __m128i *)k);
 }
+#endif
 
 #ifdef TRY_COMPILE
 int main() {
@@ -1,17 +1,98 @@
-#ifdef __linux
-// Include HWCAP related headers on linux and android
-#include <sys/auxv.h>
-#include <asm/hwcap.h>
-#endif
+#include <stdint.h>
+#include <cpuid.h>
+#include "aes.h"
+
+// Marks cached detection result
+#define FEATURES_DETECTED (1u << 31)
+
+// CPUID.1:ECX
+#define CPUID_SSSE3     (1u << 9)
+#define CPUID_AES       (1u << 25)
+#define CPUID_OSXSAVE   (1u << 27)
+#define CPUID_AVX       (1u << 28)
+
+// CPUID.7.0:EBX
+#define CPUID_AVX2      (1u << 5)
+#define CPUID_AVX512F   (1u << 16)
+#define CPUID_AVX512BW  (1u << 30)
+
+// CPUID.7.0:ECX
+#define CPUID_VAES      (1u << 9)
+#define CPUID_VPCLMUL   (1u << 10)
+
+// XCR0 state components enabled by OS
+#define XCR0_AVX        0x06    // XMM and YMM
+#define XCR0_AVX512     0xe6    // XMM, YMM, opmask and ZMM
+
+// Read XCR0 without requiring XSAVE support from the compiler
+static uint64_t xgetbv0() {
+    uint32_t eax, edx;
+    __asm__ volatile ("xgetbv" : "=a" (eax), "=d" (edx) : "c" (0));
+    return ((uint64_t)edx << 32) | eax;
+}
+
+static unsigned detect_features() {
+    unsigned eax, ebx, ecx, edx;
+    unsigned leaf1_ecx, leaf7_ebx = 0, leaf7_ecx = 0;
+    unsigned features = 0;
+    uint64_t xcr0 = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    leaf1_ecx = ecx;
+
+    if (__get_cpuid_max(0, 0) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        leaf7_ebx = ebx;
+        leaf7_ecx = ecx;
+    }
+
+    if ((leaf1_ecx & CPUID_OSXSAVE)) {
+        xcr0 = xgetbv0();
+    }
+
+    // AES-NI kernel also relies on SSSE3 byte shuffles
+    if ((leaf1_ecx & CPUID_AES) && (leaf1_ecx & CPUID_SSSE3)) {
+        features |= AES_FEATURE_AES;
+    }
+
+    // Wide registers are only usable if OS saves them
+    if ((leaf1_ecx & CPUID_AVX) && (xcr0 & XCR0_AVX) == XCR0_AVX) {
+        if (leaf7_ebx & CPUID_AVX2) {
+            features |= AES_FEATURE_AVX2;
+        }
+        if (leaf7_ecx & CPUID_VAES) {
+            features |= AES_FEATURE_VAES;
+        }
+        if (leaf7_ecx & CPUID_VPCLMUL) {
+            features |= AES_FEATURE_VPCLMUL;
+        }
+        // Wide kernels shuffle bytes, which is in AVX512BW
+        if ((leaf7_ebx & CPUID_AVX512F) && (leaf7_ebx & CPUID_AVX512BW) && (xcr0 & XCR0_AVX512) == XCR0_AVX512) {
+            features |= AES_FEATURE_AVX512;
+        }
+    }
+
+    return features;
+}
 
 extern "C" {
 
+unsigned aes_cpu_features() {
+    // CPUID is serializing and slow, run it only once, racing threads
+    //  would store the same value anyway
+    static unsigned cache = 0;
+    unsigned features = __atomic_load_n(&cache, __ATOMIC_RELAXED);
+    if (features == 0) {
+        features = detect_features() | FEATURES_DETECTED;
+        __atomic_store_n(&cache, features, __ATOMIC_RELAXED);
+    }
+    return features & ~FEATURES_DETECTED;
+}
+
 int aes_hardware_supported() {
-#ifdef __linux
-    return getauxval(AT_HWCAP) & HWCAP_AES; // Use HWCAP on linux
-#else
-    return true; // No detection for now
-#endif
+    return (aes_cpu_features() & AES_FEATURE_AES) != 0;
 }
 
 }
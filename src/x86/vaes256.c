@@ -0,0 +1,112 @@
+/*
+ * AES-256 CTR kernel on VAES with 256-bit registers,
+ *  each register holds two consecutive counter blocks
+ */
+
+#include <immintrin.h>
+#include "aes.h"
+
+#define AES_ROUND(i) \
+    s1 = _mm256_aesenc_epi128 (s1, rkeys[i]); \
+    s2 = _mm256_aesenc_epi128 (s2, rkeys[i]); \
+    s3 = _mm256_aesenc_epi128 (s3, rkeys[i]); \
+    s4 = _mm256_aesenc_epi128 (s4, rkeys[i]);
+
+// Reverse bytes within each 128-bit lane
+static inline __m256i byteswap (__m256i x) {
+    const __m256i swap = _mm256_setr_epi8 (15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                           15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+    return _mm256_shuffle_epi8 (x, swap);
+}
+
+static inline __m256i encrypt_pair (__m256i s, const __m256i *rkeys) {
+    s = _mm256_xor_si256 (s, rkeys[0]);
+    for (int i = 1; i < 14; ++i) {
+        s = _mm256_aesenc_epi128 (s, rkeys[i]);
+    }
+    return _mm256_aesenclast_epi128 (s, rkeys[14]);
+}
+
+// Keystream is either stored or XORed into the output, xor_out
+//  is a constant in each caller so the branch is folded away
+#define STORE_PAIR(p, s) \
+    _mm256_storeu_si256 ((__m256i *)(p), xor_out ? _mm256_xor_si256 (_mm256_loadu_si256 ((const __m256i *)(p)), (s)) : (s))
+
+static inline __attribute__ ((always_inline))
+void aesctr256_vaes256_x8 (uint8_t *out, const uint8_t *k, const void *counter, int bytes, int xor_out) {
+    __m128i rkeys128[15];
+    __m256i rkeys[15];
+    __m256i ctr, s1, s2, s3, s4;
+    __m128i last;
+    /* bytes will always be a multiple of 16 */
+    int blocks = bytes / 16;
+    int i = 0;
+
+    // Counters are kept byte-swapped, so that the low
+    //  32 bits of each block are in the first dword
+    const __m256i two = _mm256_set_epi32 (0, 0, 0, 2, 0, 0, 0, 2);
+    const __m256i four = _mm256_set_epi32 (0, 0, 0, 4, 0, 0, 0, 4);
+    const __m256i eight = _mm256_set_epi32 (0, 0, 0, 8, 0, 0, 0, 8);
+
+    aes256_expand_hardware (rkeys128, k);
+    for (int r = 0; r < 15; ++r) {
+        rkeys[r] = _mm256_broadcastsi128_si256 (rkeys128[r]);
+    }
+
+    ctr = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((const __m128i *)counter));
+    ctr = _mm256_add_epi32 (byteswap (ctr), _mm256_set_epi32 (0, 0, 0, 1, 0, 0, 0, 0));
+
+    for (; i + 8 <= blocks; i += 8) {
+        s1 = _mm256_xor_si256 (byteswap (ctr), rkeys[0]);
+        s2 = _mm256_xor_si256 (byteswap (_mm256_add_epi32 (ctr, two)), rkeys[0]);
+        s3 = _mm256_xor_si256 (byteswap (_mm256_add_epi32 (ctr, four)), rkeys[0]);
+        s4 = _mm256_xor_si256 (byteswap (_mm256_add_epi32 (ctr, _mm256_add_epi32 (two, four))), rkeys[0]);
+        ctr = _mm256_add_epi32 (ctr, eight);
+
+        AES_ROUND(1)
+        AES_ROUND(2)
+        AES_ROUND(3)
+        AES_ROUND(4)
+        AES_ROUND(5)
+        AES_ROUND(6)
+        AES_ROUND(7)
+        AES_ROUND(8)
+        AES_ROUND(9)
+        AES_ROUND(10)
+        AES_ROUND(11)
+        AES_ROUND(12)
+        AES_ROUND(13)
+        s1 = _mm256_aesenclast_epi128 (s1, rkeys[14]);
+        s2 = _mm256_aesenclast_epi128 (s2, rkeys[14]);
+        s3 = _mm256_aesenclast_epi128 (s3, rkeys[14]);
+        s4 = _mm256_aesenclast_epi128 (s4, rkeys[14]);
+
+        STORE_PAIR (out + 16 * i, s1);
+        STORE_PAIR (out + 16 * i + 32, s2);
+        STORE_PAIR (out + 16 * i + 64, s3);
+        STORE_PAIR (out + 16 * i + 96, s4);
+    }
+
+    for (; i + 2 <= blocks; i += 2) {
+        s1 = encrypt_pair (byteswap (ctr), rkeys);
+        ctr = _mm256_add_epi32 (ctr, two);
+        STORE_PAIR (out + 16 * i, s1);
+    }
+
+    if (i < blocks) {
+        s1 = encrypt_pair (byteswap (ctr), rkeys);
+        last = _mm256_castsi256_si128 (s1);
+        if (xor_out) {
+            last = _mm_xor_si128 (_mm_loadu_si128 ((const __m128i *)(out + 16 * i)), last);
+        }
+        _mm_storeu_si128 ((__m128i *)(out + 16 * i), last);
+    }
+}
+
+AES_KERNEL void aesctr256_vaes256 (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+    aesctr256_vaes256_x8 (out, k, counter, bytes, 0);
+}
+
+AES_KERNEL void aesctr256_xor_vaes256 (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+    aesctr256_vaes256_x8 (out, k, counter, bytes, 1);
+}
@@ -0,0 +1,113 @@
+/*
+ * AES-256 CTR kernel on VAES with 512-bit registers,
+ *  each register holds four consecutive counter blocks
+ */
+
+#include <immintrin.h>
+#include "aes.h"
+
+#define AES_ROUND(i) \
+    s1 = _mm512_aesenc_epi128 (s1, rkeys[i]); \
+    s2 = _mm512_aesenc_epi128 (s2, rkeys[i]); \
+    s3 = _mm512_aesenc_epi128 (s3, rkeys[i]); \
+    s4 = _mm512_aesenc_epi128 (s4, rkeys[i]);
+
+// Reverse bytes within each 128-bit lane
+static inline __m512i byteswap (__m512i x) {
+    const __m512i swap = _mm512_broadcast_i32x4 (
+        _mm_setr_epi8 (15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+    return _mm512_shuffle_epi8 (x, swap);
+}
+
+static inline __m512i encrypt_quad (__m512i s, const __m512i *rkeys) {
+    s = _mm512_xor_si512 (s, rkeys[0]);
+    for (int i = 1; i < 14; ++i) {
+        s = _mm512_aesenc_epi128 (s, rkeys[i]);
+    }
+    return _mm512_aesenclast_epi128 (s, rkeys[14]);
+}
+
+// Keystream is either stored or XORed into the output, xor_out
+//  is a constant in each caller so the branch is folded away
+#define STORE_QUAD(p, s) \
+    _mm512_storeu_si512 ((void *)(p), xor_out ? _mm512_xor_si512 (_mm512_loadu_si512 ((const void *)(p)), (s)) : (s))
+
+static inline __attribute__ ((always_inline))
+void aesctr256_vaes512_x16 (uint8_t *out, const uint8_t *k, const void *counter, int bytes, int xor_out) {
+    __m128i rkeys128[15];
+    __m512i rkeys[15];
+    __m512i ctr, s1, s2, s3, s4;
+    /* bytes will always be a multiple of 16 */
+    int blocks = bytes / 16;
+    int i = 0;
+
+    // Counters are kept byte-swapped, so that the low
+    //  32 bits of each block are in the first dword
+    const __m512i four = _mm512_set_epi32 (0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4, 0, 0, 0, 4);
+    const __m512i eight = _mm512_add_epi32 (four, four);
+    const __m512i twelve = _mm512_add_epi32 (eight, four);
+    const __m512i sixteen = _mm512_add_epi32 (eight, eight);
+
+    aes256_expand_hardware (rkeys128, k);
+    for (int r = 0; r < 15; ++r) {
+        rkeys[r] = _mm512_broadcast_i32x4 (rkeys128[r]);
+    }
+
+    ctr = _mm512_broadcast_i32x4 (_mm_loadu_si128 ((const __m128i *)counter));
+    ctr = _mm512_add_epi32 (byteswap (ctr), _mm512_set_epi32 (0, 0, 0, 3, 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0));
+
+    for (; i + 16 <= blocks; i += 16) {
+        s1 = _mm512_xor_si512 (byteswap (ctr), rkeys[0]);
+        s2 = _mm512_xor_si512 (byteswap (_mm512_add_epi32 (ctr, four)), rkeys[0]);
+        s3 = _mm512_xor_si512 (byteswap (_mm512_add_epi32 (ctr, eight)), rkeys[0]);
+        s4 = _mm512_xor_si512 (byteswap (_mm512_add_epi32 (ctr, twelve)), rkeys[0]);
+        ctr = _mm512_add_epi32 (ctr, sixteen);
+
+        AES_ROUND(1)
+        AES_ROUND(2)
+        AES_ROUND(3)
+        AES_ROUND(4)
+        AES_ROUND(5)
+        AES_ROUND(6)
+        AES_ROUND(7)
+        AES_ROUND(8)
+        AES_ROUND(9)
+        AES_ROUND(10)
+        AES_ROUND(11)
+        AES_ROUND(12)
+        AES_ROUND(13)
+        s1 = _mm512_aesenclast_epi128 (s1, rkeys[14]);
+        s2 = _mm512_aesenclast_epi128 (s2, rkeys[14]);
+        s3 = _mm512_aesenclast_epi128 (s3, rkeys[14]);
+        s4 = _mm512_aesenclast_epi128 (s4, rkeys[14]);
+
+        STORE_QUAD (out + 16 * i, s1);
+        STORE_QUAD (out + 16 * i + 64, s2);
+        STORE_QUAD (out + 16 * i + 128, s3);
+        STORE_QUAD (out + 16 * i + 192, s4);
+    }
+
+    for (; i + 4 <= blocks; i += 4) {
+        s1 = encrypt_quad (byteswap (ctr), rkeys);
+        ctr = _mm512_add_epi32 (ctr, four);
+        STORE_QUAD (out + 16 * i, s1);
+    }
+
+    if (i < blocks) {
+        // Store the remaining 1 to 3 blocks, two qwords per block
+        __mmask8 mask = (__mmask8)((1u << (2 * (blocks - i))) - 1);
+        s1 = encrypt_quad (byteswap (ctr), rkeys);
+        if (xor_out) {
+            s1 = _mm512_xor_si512 (_mm512_maskz_loadu_epi64 (mask, (const void *)(out + 16 * i)), s1);
+        }
+        _mm512_mask_storeu_epi64 ((void *)(out + 16 * i), mask, s1);
+    }
+}
+
+AES_KERNEL void aesctr256_vaes512 (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+    aesctr256_vaes512_x16 (out, k, counter, bytes, 0);
+}
+
+AES_KERNEL void aesctr256_xor_vaes512 (uint8_t *out, const uint8_t *k, const void *counter, int bytes) {
+    aesctr256_vaes512_x16 (out, k, counter, bytes, 1);
+}
@@ -0,0 +1,408 @@
+/*
+ * Write a stream of random bytes to stdout
+ */
+
+#define _GNU_SOURCE
+#include "secure-rng.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define MAX_THREADS      64
+#define REQUEST_LENGTH   65520     // whole blocks, served by the bulk path
+#define DEFAULT_CHUNK    (1 << 20)
+#define PIPE_SIZE        (1 << 20)
+#define RESEED_INTERVAL  (UINT64_C(1) << 20)
+
+// Chunks are produced by workers and consumed by the writer, both in
+//  ring order. Pages given away by vmsplice() stay referenced by the pipe,
+//  so a slot is only released once more than the pipe capacity has been
+//  written after it, which means that the reader has consumed it.
+
+#define SLOT_EMPTY   0
+#define SLOT_FILLING 1
+#define SLOT_FULL    2
+
+struct slot {
+    uint8_t *data;
+    size_t length;
+    int state;
+};
+
+struct options {
+    uint64_t total;          // UINT64_MAX for endless output
+    size_t chunk;
+    int threads;
+    int backend;
+    int quiet;
+};
+
+static struct options options = { UINT64_MAX, DEFAULT_CHUNK, 1, RNG_BACKEND_AUTO, 0 };
+
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t ring_filled = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t ring_emptied = PTHREAD_COND_INITIALIZER;
+static struct slot *ring;
+static size_t ring_size;
+static size_t ring_fill_next = 0;
+static uint64_t ring_assigned = 0;
+static int ring_stop = 0;
+static int worker_error = 0;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int fresh_entropy(uint8_t entropy[48]) {
+    size_t done = 0;
+
+    while (done < 48) {
+        ssize_t result = getrandom(entropy + done, 48 - done, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += (size_t)result;
+    }
+
+    return 0;
+}
+
+static void reseed_entropy(uint8_t entropy[48]) {
+    if (fresh_entropy(entropy) != 0) {
+        abort();
+    }
+}
+
+static int fill(struct secure_rng_ctx *ctx, uint8_t *data, size_t length) {
+    for (size_t offset = 0; offset < length; offset += REQUEST_LENGTH) {
+        size_t len = length - offset;
+        if (len > REQUEST_LENGTH) len = REQUEST_LENGTH;
+        if (RNG_SUCCESS != secure_rng_bytes(ctx, data + offset, len, 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void *worker(void *arg) {
+    struct secure_rng_ctx ctx;
+    uint8_t entropy[48];
+    int seeded;
+
+    (void)arg;
+
+    seeded = fresh_entropy(entropy) == 0 && RNG_SUCCESS == secure_rng_seed(&ctx, entropy, NULL, 0);
+    secure_rng_wipe(entropy, sizeof(entropy));
+    if (!seeded) {
+        pthread_mutex_lock(&ring_lock);
+        worker_error = 1;
+        pthread_cond_broadcast(&ring_filled);
+        pthread_mutex_unlock(&ring_lock);
+        return NULL;
+    }
+
+    // Backend has been validated by the main thread
+    secure_rng_set_backend(&ctx, options.backend);
+    secure_rng_set_seeder(&ctx, &reseed_entropy, RESEED_INTERVAL);
+
+    pthread_mutex_lock(&ring_lock);
+    for (;;) {
+        struct slot *slot = &ring[ring_fill_next];
+
+        while (!ring_stop && slot->state != SLOT_EMPTY) {
+            pthread_cond_wait(&ring_emptied, &ring_lock);
+            slot = &ring[ring_fill_next];
+        }
+        if (ring_stop || ring_assigned == options.total) {
+            break;
+        }
+
+        // Claim the slot and its share of the output
+        slot->length = options.chunk;
+        if (options.total - ring_assigned < slot->length) {
+            slot->length = (size_t)(options.total - ring_assigned);
+        }
+        ring_assigned += slot->length;
+        slot->state = SLOT_FILLING;
+        ring_fill_next = (ring_fill_next + 1) % ring_size;
+        pthread_mutex_unlock(&ring_lock);
+
+        int failed = fill(&ctx, slot->data, slot->length);
+
+        pthread_mutex_lock(&ring_lock);
+        if (failed) {
+            worker_error = 1;
+            ring_stop = 1;
+        }
+        else {
+            slot->state = SLOT_FULL;
+        }
+        pthread_cond_broadcast(&ring_filled);
+    }
+    pthread_mutex_unlock(&ring_lock);
+
+    secure_rng_wipe(&ctx, sizeof(ctx));
+    return NULL;
+}
+
+// Hand the pages over to the pipe, falls back to write() if the
+//  kernel refuses. Returns -1 on errors, EPIPE is left in errno.
+static int output(const uint8_t *data, size_t length, int *use_splice) {
+    while (length) {
+        ssize_t result;
+
+        if (*use_splice) {
+            struct iovec iov = { (void *)data, length };
+            result = vmsplice(STDOUT_FILENO, &iov, 1, 0);
+            if (result < 0 && (errno == EINVAL || errno == ENOSYS)) {
+                *use_splice = 0;
+                continue;
+            }
+        }
+        else {
+            result = write(STDOUT_FILENO, data, length);
+        }
+
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+
+        data += result;
+        length -= (size_t)result;
+    }
+
+    return 0;
+}
+
+static int parse_size(const char *text, uint64_t *value) {
+    char *end;
+    unsigned long long number = strtoull(text, &end, 10);
+    unsigned shift = 0;
+
+    switch (*end) {
+        case 'k': case 'K': shift = 10; ++end; break;
+        case 'm': case 'M': shift = 20; ++end; break;
+        case 'g': case 'G': shift = 30; ++end; break;
+        case 't': case 'T': shift = 40; ++end; break;
+    }
+
+    if (end == text || *end != '\0' || (shift && number > (UINT64_MAX >> shift))) {
+        return -1;
+    }
+
+    *value = (uint64_t)number << shift;
+    return 0;
+}
+
+static int parse_backend(const char *name, int *backend) {
+    static const struct { const char *name; int id; } backends[] = {
+        { "auto", RNG_BACKEND_AUTO },
+        { "software", RNG_BACKEND_SOFTWARE },
+        { "hardware", RNG_BACKEND_HARDWARE },
+        { "vaes256", RNG_BACKEND_VAES256 },
+        { "vaes512", RNG_BACKEND_VAES512 },
+        { "tuned", RNG_BACKEND_TUNED },
+    };
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        if (!strcmp(name, backends[i].name)) {
+            *backend = backends[i].id;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Write random bytes to standard output.\n"
+            "  -n SIZE      output SIZE bytes (K, M, G and T suffixes), endless by default\n"
+            "  -t THREADS   generator threads (default %d, at most %d)\n"
+            "  -b BACKEND   auto, software, hardware, vaes256, vaes512 or tuned\n"
+            "  -c SIZE      chunk size (default %d)\n"
+            "  -q           don't report throughput\n",
+            program, options.threads, MAX_THREADS, DEFAULT_CHUNK);
+}
+
+int main(int argc, char **argv) {
+    pthread_t threads[MAX_THREADS];
+    struct stat st;
+    uint64_t written = 0, written_slots = 0, chunk;
+    uint64_t start;
+    size_t write_next = 0;
+    size_t release_lag = 0;
+    int use_splice = 0;
+    int status = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:t:b:c:q")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (parse_size(optarg, &options.total) != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 't':
+                options.threads = atoi(optarg);
+                break;
+            case 'b':
+                if (parse_backend(optarg, &options.backend) != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'c':
+                if (parse_size(optarg, &chunk) != 0 || chunk < 4096 || chunk > (1u << 30)) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                options.chunk = (size_t)chunk;
+                break;
+            case 'q':
+                options.quiet = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind != argc || options.threads < 1 || options.threads > MAX_THREADS) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    // Check the backend before starting any thread
+    if (options.backend != RNG_BACKEND_AUTO) {
+        struct secure_rng_ctx probe;
+        uint8_t entropy[48] = {0};
+
+        if (options.backend == RNG_BACKEND_TUNED) {
+            secure_rng_autotune(NULL);
+        }
+        secure_rng_seed(&probe, entropy, NULL, 0);
+        if (RNG_SUCCESS != secure_rng_set_backend(&probe, options.backend)) {
+            fprintf(stderr, "%s: backend is not supported on this CPU\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Pipes take pages by reference, bigger pipes need fewer syscalls
+    if (fstat(STDOUT_FILENO, &st) == 0 && S_ISFIFO(st.st_mode)) {
+        int pipe_size = fcntl(STDOUT_FILENO, F_SETPIPE_SZ, PIPE_SIZE);
+        if (pipe_size < 0) {
+            pipe_size = fcntl(STDOUT_FILENO, F_GETPIPE_SZ);
+        }
+        use_splice = 1;
+        release_lag = (pipe_size > 0 ? (size_t)pipe_size : PIPE_SIZE) / options.chunk + 1;
+    }
+    ring_size = release_lag + 2 * (size_t)options.threads + 1;
+
+    ring = calloc(ring_size, sizeof(struct slot));
+    if (ring == NULL) {
+        fprintf(stderr, "%s: out of memory\n", argv[0]);
+        return 1;
+    }
+    for (size_t i = 0; i < ring_size; ++i) {
+        if (posix_memalign((void **)&ring[i].data, 4096, options.chunk) != 0) {
+            fprintf(stderr, "%s: out of memory\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Closed reader is reported as EPIPE instead
+    signal(SIGPIPE, SIG_IGN);
+
+    start = now_ns();
+    for (int i = 0; i < options.threads; ++i) {
+        if (pthread_create(&threads[i], NULL, &worker, NULL) != 0) {
+            fprintf(stderr, "%s: can't create thread\n", argv[0]);
+            return 1;
+        }
+    }
+
+    while (written < options.total) {
+        struct slot *slot = &ring[write_next];
+
+        pthread_mutex_lock(&ring_lock);
+        while (slot->state != SLOT_FULL && !worker_error) {
+            pthread_cond_wait(&ring_filled, &ring_lock);
+        }
+        pthread_mutex_unlock(&ring_lock);
+
+        // Output of a failed generator must not be used
+
+        if (worker_error) {
+            fprintf(stderr, "%s: generator failure\n", argv[0]);
+            status = 1;
+            break;
+        }
+
+        if (output(slot->data, slot->length, &use_splice) != 0) {
+            if (errno != EPIPE) {
+                fprintf(stderr, "%s: write error: %s\n", argv[0], strerror(errno));
+                status = 1;
+            }
+            break;
+        }
+        written += slot->length;
+        write_next = (write_next + 1) % ring_size;
+
+        // Slots are released in order, lagging behind the writer
+        //  while the pipe may still hold references to them
+        if (++written_slots > release_lag) {
+            pthread_mutex_lock(&ring_lock);
+            ring[(write_next + ring_size - 1 - release_lag) % ring_size].state = SLOT_EMPTY;
+            pthread_cond_broadcast(&ring_emptied);
+            pthread_mutex_unlock(&ring_lock);
+        }
+    }
+
+    pthread_mutex_lock(&ring_lock);
+    ring_stop = 1;
+    pthread_cond_broadcast(&ring_emptied);
+    pthread_mutex_unlock(&ring_lock);
+
+    for (int i = 0; i < options.threads; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    if (!options.quiet) {
+        double seconds = (double)(now_ns() - start) / 1e9;
+        fprintf(stderr, "%llu bytes in %.3f s, %.3f GB/s%s\n", (unsigned long long)written, seconds,
+                seconds > 0 ? written / seconds / 1e9 : 0, use_splice ? " (vmsplice)" : "");
+    }
+
+    // The pipe may still reference the last chunks, wiping them would
+    //  change output which hasn't been read yet, so leave them alone
+    if (!use_splice) {
+        for (size_t i = 0; i < ring_size; ++i) {
+            memset(ring[i].data, 0, options.chunk);
+            free(ring[i].data);
+        }
+        free(ring);
+    }
+
+    return status;
+}
@@ -0,0 +1,422 @@
+/*
+ * Serve random bytes to local clients through shared memory rings
+ */
+
+#define _GNU_SOURCE
+#include "secure-rng.h"
+#include "secure-rng-client.h"
+#include "ring.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#define MAX_THREADS      64
+#define MAX_EVENTS       64
+#define REQUEST_LENGTH   65520     // whole blocks, served by the bulk path
+#define DEFAULT_RING     (256 << 10)
+#define INITIAL_FILL     4096
+#define RESEED_INTERVAL  (UINT64_C(1) << 20)
+
+struct options {
+    const char *socket_path;
+    size_t ring_size;
+    int threads;
+    int backend;
+    int verbose;
+};
+
+static struct options options = { SECURE_RNG_DEFAULT_SOCKET, DEFAULT_RING, 1, RNG_BACKEND_AUTO, 0 };
+
+// Shared memory is writable by the client, so the daemon
+//  keeps its own copy of the producer position
+struct client {
+    int fd;
+    struct rng_ring *ring;
+    size_t map_size;
+    uint64_t head;
+};
+
+// Each thread owns a context and the clients it has accepted
+struct server {
+    pthread_t thread;
+    int epoll_fd;
+    struct secure_rng_ctx ctx;
+    uint64_t clients;
+    uint64_t bytes;
+};
+
+static int listen_fd = -1;
+static volatile sig_atomic_t stopping = 0;
+
+static void reseed_entropy(uint8_t entropy[48]) {
+    while (getrandom(entropy, 48, 0) != 48) {
+        if (errno != EINTR) {
+            abort();
+        }
+    }
+}
+
+// Generate into the free part of the ring, directly in shared memory,
+//  up to limit bytes ahead of the consumer
+static int ring_fill(struct server *server, struct client *client, size_t limit) {
+    struct rng_ring *ring = client->ring;
+    const size_t size = options.ring_size;
+    uint64_t head = client->head;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+    // Consumer position comes from the client, don't trust it
+    if (tail > head || head - tail > size) {
+        return -1;
+    }
+
+    while (head - tail < limit) {
+        size_t offset = (size_t)(head & (size - 1));
+        size_t len = limit - (size_t)(head - tail);
+        if (len > size - offset) len = size - offset;
+        if (len > REQUEST_LENGTH) len = REQUEST_LENGTH;
+
+        if (RNG_SUCCESS != secure_rng_bytes(&server->ctx, ring->data + offset, len, 0)) {
+            return -1;
+        }
+        head += len;
+        server->bytes += len;
+
+        // Publish each part, so that a waiting client may start early
+        client->head = head;
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+
+    __atomic_store_n(&ring->refill_pending, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void client_close(struct server *server, struct client *client) {
+    epoll_ctl(server->epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    if (client->ring != NULL) {
+        munmap(client->ring, client->map_size);
+    }
+    free(client);
+}
+
+// Create the ring in an anonymous memory file and pass it to the client
+static int client_setup(struct server *server, struct client *client) {
+    struct {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t map_size;
+    } hello;
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = { &hello, sizeof(hello) };
+    struct msghdr message;
+    struct cmsghdr *cmsg;
+    int memory_fd;
+
+    client->map_size = sizeof(struct rng_ring) + options.ring_size;
+    memory_fd = memfd_create("secure-rng-ring", MFD_CLOEXEC);
+    if (memory_fd < 0) {
+        return -1;
+    }
+    if (ftruncate(memory_fd, (off_t)client->map_size) != 0) {
+        close(memory_fd);
+        return -1;
+    }
+
+    client->ring = mmap(NULL, client->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, memory_fd, 0);
+    if (client->ring == MAP_FAILED) {
+        client->ring = NULL;
+        close(memory_fd);
+        return -1;
+    }
+
+    client->ring->magic = RING_MAGIC;
+    client->ring->version = RING_VERSION;
+    client->ring->size = options.ring_size;
+    // Short lived clients only need a few bytes, they
+    //  ask for the rest once they have consumed these
+    if (ring_fill(server, client, INITIAL_FILL) != 0) {
+        close(memory_fd);
+        return -1;
+    }
+
+    hello.magic = RING_MAGIC;
+    hello.version = RING_VERSION;
+    hello.map_size = client->map_size;
+
+    memset(&message, 0, sizeof(message));
+    memset(control, 0, sizeof(control));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+    cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &memory_fd, sizeof(int));
+
+    ssize_t result = sendmsg(client->fd, &message, MSG_NOSIGNAL);
+    close(memory_fd);
+    return (result == (ssize_t)sizeof(hello)) ? 0 : -1;
+}
+
+static void client_accept(struct server *server) {
+    struct epoll_event event;
+    struct client *client;
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+
+    // Another thread may have taken it
+    if (fd < 0) {
+        return;
+    }
+
+    client = calloc(1, sizeof(struct client));
+    if (client == NULL) {
+        close(fd);
+        return;
+    }
+    client->fd = fd;
+
+    event.events = EPOLLIN | EPOLLRDHUP;
+    event.data.ptr = client;
+    if (epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0 || client_setup(server, client) != 0) {
+        client_close(server, client);
+        return;
+    }
+    server->clients++;
+}
+
+static void client_serve(struct server *server, struct client *client, uint32_t events) {
+    char requests[64];
+    ssize_t count;
+    int wait = 0;
+
+    do {
+        count = recv(client->fd, requests, sizeof(requests), 0);
+        for (ssize_t i = 0; i < count; ++i) {
+            wait |= (requests[i] == RING_WAIT);
+        }
+    } while (count == (ssize_t)sizeof(requests));
+
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK) || (events & (EPOLLHUP | EPOLLERR))) {
+        client_close(server, client);
+        return;
+    }
+
+    if (ring_fill(server, client, options.ring_size) != 0) {
+        client_close(server, client);
+        return;
+    }
+
+    if (wait) {
+        char ready = RING_READY;
+        if (send(client->fd, &ready, 1, MSG_NOSIGNAL) != 1) {
+            client_close(server, client);
+        }
+    }
+}
+
+static void *server_run(void *arg) {
+    struct server *server = arg;
+    struct epoll_event events[MAX_EVENTS];
+
+    while (!stopping) {
+        int count = epoll_wait(server->epoll_fd, events, MAX_EVENTS, 1000);
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.ptr == NULL) {
+                client_accept(server);
+            }
+            else {
+                client_serve(server, events[i].data.ptr, events[i].events);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static int server_init(struct server *server) {
+    struct epoll_event event;
+    uint8_t entropy[48];
+    int result;
+
+    reseed_entropy(entropy);
+    result = secure_rng_seed(&server->ctx, entropy, NULL, 0);
+    secure_rng_wipe(entropy, sizeof(entropy));
+    if (RNG_SUCCESS != result) {
+        return -1;
+    }
+    if (RNG_SUCCESS != secure_rng_set_backend(&server->ctx, options.backend)) {
+        return -1;
+    }
+    secure_rng_set_seeder(&server->ctx, &reseed_entropy, RESEED_INTERVAL);
+
+    server->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (server->epoll_fd < 0) {
+        return -1;
+    }
+
+    // Every thread waits for connections, only one of them is woken up
+    event.events = EPOLLIN | EPOLLEXCLUSIVE;
+    event.data.ptr = NULL;
+    return epoll_ctl(server->epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+}
+
+static int listen_socket(const char *path) {
+    struct sockaddr_un address;
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // A stale socket of a previous instance
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) != 0 || chmod(path, 0666) != 0 || listen(fd, SOMAXCONN) != 0) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void stop(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+static int parse_backend(const char *name, int *backend) {
+    static const struct { const char *name; int id; } backends[] = {
+        { "auto", RNG_BACKEND_AUTO },
+        { "software", RNG_BACKEND_SOFTWARE },
+        { "hardware", RNG_BACKEND_HARDWARE },
+        { "vaes256", RNG_BACKEND_VAES256 },
+        { "vaes512", RNG_BACKEND_VAES512 },
+        { "tuned", RNG_BACKEND_TUNED },
+    };
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        if (!strcmp(name, backends[i].name)) {
+            *backend = backends[i].id;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Serve random bytes to local clients.\n"
+            "  -s PATH      socket path (default %s)\n"
+            "  -r KB        ring size per client, a power of two (default %d)\n"
+            "  -t THREADS   server threads, each with its own context (default %d, at most %d)\n"
+            "  -b BACKEND   auto, software, hardware, vaes256, vaes512 or tuned\n"
+            "  -v           report statistics on exit\n",
+            program, options.socket_path, DEFAULT_RING >> 10, options.threads, MAX_THREADS);
+}
+
+int main(int argc, char **argv) {
+    static struct server servers[MAX_THREADS];
+    struct sigaction action;
+    uint64_t clients = 0, bytes = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "s:r:t:b:v")) != -1) {
+        switch (opt) {
+            case 's':
+                options.socket_path = optarg;
+                break;
+            case 'r':
+                options.ring_size = (size_t)atol(optarg) << 10;
+                break;
+            case 't':
+                options.threads = atoi(optarg);
+                break;
+            case 'b':
+                if (parse_backend(optarg, &options.backend) != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'v':
+                options.verbose = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind != argc || options.threads < 1 || options.threads > MAX_THREADS
+            || options.ring_size < 4096 || (options.ring_size & (options.ring_size - 1)) != 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (options.backend == RNG_BACKEND_TUNED) {
+        secure_rng_autotune(NULL);
+    }
+
+    listen_fd = listen_socket(options.socket_path);
+    if (listen_fd < 0) {
+        fprintf(stderr, "%s: can't listen on %s: %s\n", argv[0], options.socket_path, strerror(errno));
+        return 1;
+    }
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < options.threads; ++i) {
+        if (server_init(&servers[i]) != 0) {
+            fprintf(stderr, "%s: can't initialize server: %s\n", argv[0], strerror(errno));
+            return 1;
+        }
+    }
+    for (int i = 0; i < options.threads; ++i) {
+        if (pthread_create(&servers[i].thread, NULL, &server_run, &servers[i]) != 0) {
+            fprintf(stderr, "%s: can't create thread\n", argv[0]);
+            return 1;
+        }
+    }
+
+    for (int i = 0; i < options.threads; ++i) {
+        pthread_join(servers[i].thread, NULL);
+        clients += servers[i].clients;
+        bytes += servers[i].bytes;
+    }
+
+    unlink(options.socket_path);
+
+    if (options.verbose) {
+        fprintf(stderr, "%llu clients served, %llu bytes generated\n", (unsigned long long)clients, (unsigned long long)bytes);
+    }
+
+    return 0;
+}
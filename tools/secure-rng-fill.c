@@ -0,0 +1,327 @@
+/*
+ * Fill a file or a block device with random bytes
+ */
+
+#define _GNU_SOURCE
+#include "secure-rng.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/random.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#define MAX_THREADS      64
+#define DEFAULT_CHUNK    (1 << 20)
+#define DEFAULT_DEPTH    8
+#define RESEED_INTERVAL  (UINT64_C(1) << 20)
+
+struct options {
+    uint64_t total;          // UINT64_MAX for the whole device or file
+    uint64_t offset;
+    struct secure_rng_fill_options fill;
+    int threads;
+    int backend;
+    int direct;
+    int quiet;
+};
+
+static struct options options = { UINT64_MAX, 0, { DEFAULT_DEPTH, DEFAULT_CHUNK, 0 }, 1, RNG_BACKEND_AUTO, 1, 0 };
+
+// Each thread fills its own contiguous part of the range
+struct region {
+    pthread_t thread;
+    int fd;
+    uint64_t offset;
+    uint64_t length;
+    int result;
+};
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int fresh_entropy(uint8_t entropy[48]) {
+    size_t done = 0;
+
+    while (done < 48) {
+        ssize_t result = getrandom(entropy + done, 48 - done, 0);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        done += (size_t)result;
+    }
+
+    return 0;
+}
+
+static void reseed_entropy(uint8_t entropy[48]) {
+    if (fresh_entropy(entropy) != 0) {
+        abort();
+    }
+}
+
+static int fill_region(struct region *region) {
+    struct secure_rng_ctx ctx;
+    uint8_t entropy[48];
+    int result;
+
+    result = (fresh_entropy(entropy) == 0) ? secure_rng_seed(&ctx, entropy, NULL, 0) : RNG_IO_ERROR;
+    secure_rng_wipe(entropy, sizeof(entropy));
+    if (result != RNG_SUCCESS) {
+        return RNG_IO_ERROR;
+    }
+
+    // Backend has been validated by the main thread
+    secure_rng_set_backend(&ctx, options.backend);
+    secure_rng_set_seeder(&ctx, &reseed_entropy, RESEED_INTERVAL);
+
+    result = secure_rng_fill_fd_ex(&ctx, region->fd, region->offset, region->length, &options.fill);
+    secure_rng_wipe(&ctx, sizeof(ctx));
+    return result;
+}
+
+static void *worker(void *arg) {
+    struct region *region = arg;
+    region->result = fill_region(region);
+    return NULL;
+}
+
+static int parse_size(const char *text, uint64_t *value) {
+    char *end;
+    unsigned long long number = strtoull(text, &end, 10);
+    unsigned shift = 0;
+
+    switch (*end) {
+        case 'k': case 'K': shift = 10; ++end; break;
+        case 'm': case 'M': shift = 20; ++end; break;
+        case 'g': case 'G': shift = 30; ++end; break;
+        case 't': case 'T': shift = 40; ++end; break;
+    }
+
+    if (end == text || *end != '\0' || (shift && number > (UINT64_MAX >> shift))) {
+        return -1;
+    }
+
+    *value = (uint64_t)number << shift;
+    return 0;
+}
+
+static int parse_backend(const char *name, int *backend) {
+    static const struct { const char *name; int id; } backends[] = {
+        { "auto", RNG_BACKEND_AUTO },
+        { "software", RNG_BACKEND_SOFTWARE },
+        { "hardware", RNG_BACKEND_HARDWARE },
+        { "vaes256", RNG_BACKEND_VAES256 },
+        { "vaes512", RNG_BACKEND_VAES512 },
+        { "tuned", RNG_BACKEND_TUNED },
+    };
+
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); ++i) {
+        if (!strcmp(name, backends[i].name)) {
+            *backend = backends[i].id;
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static void usage(const char *program) {
+    fprintf(stderr,
+            "Usage: %s [options] FILE\n"
+            "Fill a file or a block device with random bytes.\n"
+            "  -n SIZE      write SIZE bytes (K, M, G and T suffixes), the whole device or file by default\n"
+            "  -o OFFSET    start at OFFSET bytes\n"
+            "  -t THREADS   generator threads (default %d, at most %d)\n"
+            "  -d DEPTH     writes in flight per thread (default %d, at most 256)\n"
+            "  -c SIZE      bytes per write, a multiple of %d (default %d)\n"
+            "  -b BACKEND   auto, software, hardware, vaes256, vaes512 or tuned\n"
+            "  -B           buffered writes instead of O_DIRECT\n"
+            "  -p           pwrite instead of io_uring\n"
+            "  -q           don't report throughput\n",
+            program, options.threads, MAX_THREADS, DEFAULT_DEPTH, RNG_FILL_ALIGN, DEFAULT_CHUNK);
+}
+
+int main(int argc, char **argv) {
+    struct region regions[MAX_THREADS];
+    struct region tail = { .fd = -1 };
+    struct stat st;
+    uint64_t value, aligned, share, start;
+    const char *path;
+    int fd, opt;
+    int status = 0;
+
+    while ((opt = getopt(argc, argv, "n:o:t:d:c:b:Bpq")) != -1) {
+        switch (opt) {
+            case 'n':
+                if (parse_size(optarg, &options.total) != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'o':
+                if (parse_size(optarg, &options.offset) != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 't':
+                options.threads = atoi(optarg);
+                break;
+            case 'd':
+                if (parse_size(optarg, &value) != 0 || value < 1 || value > 256) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                options.fill.queue_depth = (uint32_t)value;
+                break;
+            case 'c':
+                if (parse_size(optarg, &value) != 0 || value < RNG_FILL_ALIGN || value > (1u << 30) || value % RNG_FILL_ALIGN) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                options.fill.buffer_size = (uint32_t)value;
+                break;
+            case 'b':
+                if (parse_backend(optarg, &options.backend) != 0) {
+                    usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case 'B':
+                options.direct = 0;
+                break;
+            case 'p':
+                options.fill.flags |= RNG_FILL_PWRITE;
+                break;
+            case 'q':
+                options.quiet = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind + 1 != argc || options.threads < 1 || options.threads > MAX_THREADS) {
+        usage(argv[0]);
+        return 2;
+    }
+    path = argv[optind];
+
+    // Check the backend before starting any thread
+    if (options.backend != RNG_BACKEND_AUTO) {
+        struct secure_rng_ctx probe;
+        uint8_t entropy[48] = {0};
+
+        if (options.backend == RNG_BACKEND_TUNED) {
+            secure_rng_autotune(NULL);
+        }
+        secure_rng_seed(&probe, entropy, NULL, 0);
+        if (RNG_SUCCESS != secure_rng_set_backend(&probe, options.backend)) {
+            fprintf(stderr, "%s: backend is not supported on this CPU\n", argv[0]);
+            return 1;
+        }
+    }
+
+    // Some file systems (tmpfs) refuse O_DIRECT
+    fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (options.direct ? O_DIRECT : 0), 0644);
+    if (fd < 0 && options.direct && errno == EINVAL) {
+        options.direct = 0;
+        fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    }
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], path, strerror(errno));
+        return 1;
+    }
+
+    if (options.total == UINT64_MAX) {
+        uint64_t size = (uint64_t)st.st_size;
+        if (S_ISBLK(st.st_mode) && ioctl(fd, BLKGETSIZE64, &size) != 0) {
+            fprintf(stderr, "%s: %s: %s\n", argv[0], path, strerror(errno));
+            return 1;
+        }
+        if (size <= options.offset) {
+            fprintf(stderr, "%s: %s: nothing to fill, use -n to set the size\n", argv[0], path);
+            return 2;
+        }
+        options.total = size - options.offset;
+    }
+
+    if (options.direct && options.offset % RNG_FILL_ALIGN) {
+        fprintf(stderr, "%s: offset must be a multiple of %d for direct I/O\n", argv[0], RNG_FILL_ALIGN);
+        return 2;
+    }
+
+    // Shares are whole writes, the unaligned end of a direct fill
+    //  goes through a separate buffered descriptor
+    aligned = options.direct ? options.total - options.total % RNG_FILL_ALIGN : options.total;
+    share = (aligned / (uint64_t)options.threads + options.fill.buffer_size - 1) / options.fill.buffer_size * options.fill.buffer_size;
+
+    start = now_ns();
+    int started = 0;
+    for (uint64_t offset = 0; offset < aligned; offset += share) {
+        struct region *region = &regions[started];
+        region->fd = fd;
+        region->offset = options.offset + offset;
+        region->length = (aligned - offset < share) ? aligned - offset : share;
+        if (pthread_create(&region->thread, NULL, &worker, region) != 0) {
+            fprintf(stderr, "%s: can't create thread\n", argv[0]);
+            return 1;
+        }
+        ++started;
+    }
+
+    if (aligned < options.total) {
+        tail.fd = open(path, O_WRONLY | O_CLOEXEC);
+        tail.offset = options.offset + aligned;
+        tail.length = options.total - aligned;
+        tail.result = (tail.fd < 0) ? RNG_IO_ERROR : fill_region(&tail);
+    }
+
+    for (int i = 0; i < started; ++i) {
+        pthread_join(regions[i].thread, NULL);
+        if (regions[i].result != RNG_SUCCESS) {
+            status = regions[i].result;
+        }
+    }
+    if (tail.result != RNG_SUCCESS) {
+        status = tail.result;
+    }
+
+    // Buffered data only counts once it's on the disk
+    if (status == RNG_SUCCESS && (fsync(fd) != 0 || (tail.fd >= 0 && fsync(tail.fd) != 0))) {
+        status = RNG_IO_ERROR;
+    }
+
+    if (status != RNG_SUCCESS) {
+        fprintf(stderr, "%s: %s: %s\n", argv[0], path, (status == RNG_IO_ERROR) ? "write error" : "generator failure");
+        return 1;
+    }
+
+    if (!options.quiet) {
+        double seconds = (double)(now_ns() - start) / 1e9;
+        fprintf(stderr, "%llu bytes in %.3f s, %.3f GB/s (%s, %s)\n", (unsigned long long)options.total, seconds,
+                seconds > 0 ? options.total / seconds / 1e9 : 0,
+                (options.fill.flags & RNG_FILL_PWRITE) ? "pwrite" : "io_uring", options.direct ? "O_DIRECT" : "buffered");
+    }
+
+    if (tail.fd >= 0) {
+        close(tail.fd);
+    }
+    close(fd);
+    return 0;
+}